@@ -0,0 +1,247 @@
+#include <scenefx/render/fx_renderer/fx_renderer.h>
+#include <scenefx/types/wlr_scene.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <wayland-server-core.h>
+#include <wlr/backend.h>
+#include <wlr/backend/headless.h>
+#include <wlr/render/allocator.h>
+#include <wlr/render/wlr_renderer.h>
+#include <wlr/types/wlr_output.h>
+#include <wlr/util/log.h>
+
+/* Counts the heap allocations made while building the frames of a scene whose
+ * structure doesn't change, on a headless output.
+ *
+ * The whole output is damaged every frame by a translucent rect on top of the
+ * scene. The frame is first rendered with nothing below that rect, which
+ * gives the allocations of the output and the render pass themselves, and
+ * then with a grid of overlapping windows below it. Every window has a shadow,
+ * a blurred backdrop and rounded content, every other window is opaque and
+ * partly covers its neighbours.
+ *
+ * The windows must not add more than allocations_per_window allocations per
+ * window to a frame, otherwise this exits with a failure. Those are the region
+ * operations left on the drawing path of such a window, each of which
+ * allocates at most once:
+ *  - rounded_box_split() splitting the corners off the content and the blur:
+ *    5 per draw, 10
+ *  - the copies of the clip region by the shadow, blur and rect draws: 3
+ *  - apply_blur_region() expanding the damage around the blur: 4
+ *  - scene_blur_cache_covers() checking the blur cache: 1
+ *  - scene_entry_render_region() on the multi-rect visible regions of the
+ *    partly covered windows: 2 per draw, 6
+ *
+ * Allocations are counted through the glibc __libc_* allocator entry points. */
+
+static const int output_width = 1280;
+static const int output_height = 720;
+static const int window_cols = 10;
+static const int window_rows = 5;
+static const int window_width = 150;
+static const int window_height = 160;
+// Smaller than the windows, so that they overlap
+static const int window_step_x = 120;
+static const int window_step_y = 130;
+static const int corner_radius = 12;
+static const int shadow_sigma = 10;
+static const int allocations_per_window = 24;
+static const int warmup_frames = 30;
+static const int measured_frames = 100;
+
+void *__libc_malloc(size_t size);
+void *__libc_calloc(size_t nmemb, size_t size);
+void *__libc_realloc(void *ptr, size_t size);
+
+static bool count_allocations = false;
+static uint64_t allocations = 0;
+
+void *malloc(size_t size) {
+	if (count_allocations) {
+		allocations++;
+	}
+	return __libc_malloc(size);
+}
+
+void *calloc(size_t nmemb, size_t size) {
+	if (count_allocations) {
+		allocations++;
+	}
+	return __libc_calloc(nmemb, size);
+}
+
+void *realloc(void *ptr, size_t size) {
+	if (count_allocations) {
+		allocations++;
+	}
+	return __libc_realloc(ptr, size);
+}
+
+struct server {
+	struct wl_display *display;
+	struct wlr_backend *backend;
+	struct wlr_renderer *renderer;
+	struct wlr_allocator *allocator;
+	struct wlr_scene *scene;
+	struct wlr_scene_output *scene_output;
+
+	struct wlr_scene_tree *windows;
+	struct wlr_scene_rect *overlay;
+
+	bool has_windows;
+	int frame; // Frames rendered with the current scene
+	uint64_t empty_allocations;
+	uint64_t windows_allocations;
+	bool failed;
+
+	struct wl_listener frame_listener;
+};
+
+static void add_window(struct wlr_scene_tree *parent, int x, int y,
+		float shade, bool opaque) {
+	struct wlr_scene_tree *tree = wlr_scene_tree_create(parent);
+	wlr_scene_node_set_position(&tree->node, x, y);
+
+	struct wlr_scene_shadow *shadow = wlr_scene_shadow_create(tree,
+		window_width + 2 * shadow_sigma, window_height + 2 * shadow_sigma,
+		corner_radius, shadow_sigma, (float[4]){ 0, 0, 0, 0.5f });
+	wlr_scene_node_set_position(&shadow->node, -shadow_sigma, -shadow_sigma);
+
+	struct wlr_scene_blur *blur =
+		wlr_scene_blur_create(tree, window_width, window_height);
+	wlr_scene_blur_set_corner_radius(blur, corner_radius);
+
+	float alpha = opaque ? 1 : 0.7f;
+	struct wlr_scene_rect *content = wlr_scene_rect_create(tree,
+		window_width, window_height, (float[4]){ shade, 0.5f, 1 - shade, alpha });
+	wlr_scene_rect_set_corner_radius(content, corner_radius);
+}
+
+static void add_windows(struct server *server) {
+	for (int row = 0; row < window_rows; row++) {
+		for (int col = 0; col < window_cols; col++) {
+			float shade = (float)(row * window_cols + col) /
+				(window_rows * window_cols);
+			add_window(server->windows, col * window_step_x,
+				row * window_step_y, shade, (row + col) % 2 == 0);
+		}
+	}
+}
+
+static void output_handle_frame(struct wl_listener *listener, void *data) {
+	struct server *server = wl_container_of(listener, server, frame_listener);
+
+	// Damages the whole output without changing the structure of the scene
+	float alpha = server->frame % 2 == 0 ? 0.1f : 0.2f;
+	wlr_scene_rect_set_color(server->overlay, (float[4]){ 0, 0, 0, alpha });
+
+	struct wlr_output_state state;
+	wlr_output_state_init(&state);
+	count_allocations = server->frame >= warmup_frames;
+	bool ok = wlr_scene_output_build_state(server->scene_output, &state, NULL);
+	count_allocations = false;
+	ok = ok && wlr_output_commit_state(server->scene_output->output, &state);
+	wlr_output_state_finish(&state);
+	if (!ok) {
+		wlr_log(WLR_ERROR, "Failed to render a frame");
+		server->failed = true;
+		wl_display_terminate(server->display);
+		return;
+	}
+
+	if (++server->frame < warmup_frames + measured_frames) {
+		return;
+	}
+
+	if (!server->has_windows) {
+		server->empty_allocations = allocations;
+		allocations = 0;
+		add_windows(server);
+		server->has_windows = true;
+		server->frame = 0;
+	} else {
+		server->windows_allocations = allocations;
+		wl_display_terminate(server->display);
+	}
+}
+
+int main(void) {
+	wlr_log_init(WLR_ERROR, NULL);
+
+	int status = EXIT_FAILURE;
+	struct server server = {0};
+	server.display = wl_display_create();
+	server.backend = wlr_headless_backend_create(wl_display_get_event_loop(server.display));
+	if (server.backend == NULL) {
+		goto error_display;
+	}
+
+	server.renderer = fx_renderer_create(server.backend);
+	if (server.renderer == NULL) {
+		goto error_backend;
+	}
+	server.allocator = wlr_allocator_autocreate(server.backend, server.renderer);
+	if (server.allocator == NULL) {
+		goto error_renderer;
+	}
+	server.scene = wlr_scene_create();
+
+	if (!wlr_backend_start(server.backend)) {
+		goto error_scene;
+	}
+
+	struct wlr_output *output =
+		wlr_headless_add_output(server.backend, output_width, output_height);
+	wlr_output_init_render(output, server.allocator, server.renderer);
+	server.scene_output = wlr_scene_output_create(server.scene, output);
+
+	struct wlr_output_state state;
+	wlr_output_state_init(&state);
+	wlr_output_state_set_enabled(&state, true);
+	bool enabled = wlr_output_commit_state(output, &state);
+	wlr_output_state_finish(&state);
+	if (!enabled) {
+		goto error_scene;
+	}
+
+	server.windows = wlr_scene_tree_create(&server.scene->tree);
+	server.overlay = wlr_scene_rect_create(&server.scene->tree,
+		output_width, output_height, (float[4]){ 0, 0, 0, 0.1f });
+
+	server.frame_listener.notify = output_handle_frame;
+	wl_signal_add(&output->events.frame, &server.frame_listener);
+	wlr_output_schedule_frame(output);
+
+	wl_display_run(server.display);
+	wl_list_remove(&server.frame_listener.link);
+
+	if (!server.failed) {
+		int windows = window_cols * window_rows;
+		double empty_per_frame = (double)server.empty_allocations / measured_frames;
+		double windows_per_frame = (double)server.windows_allocations / measured_frames;
+		double added_per_window = (windows_per_frame - empty_per_frame) / windows;
+		printf("allocations per frame: %.2f empty, %.2f with %d windows\n",
+			empty_per_frame, windows_per_frame, windows);
+		printf("the windows add %.2f allocations per window and frame, "
+			"at most %d expected\n", added_per_window, allocations_per_window);
+
+		uint64_t bound = server.empty_allocations +
+			(uint64_t)allocations_per_window * windows * measured_frames;
+		if (server.windows_allocations <= bound) {
+			status = EXIT_SUCCESS;
+		}
+	}
+
+error_scene:
+	wlr_scene_node_destroy(&server.scene->tree.node);
+	wlr_allocator_destroy(server.allocator);
+error_renderer:
+	wlr_renderer_destroy(server.renderer);
+error_backend:
+	wlr_backend_destroy(server.backend);
+error_display:
+	wl_display_destroy(server.display);
+	return status;
+}
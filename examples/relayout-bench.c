@@ -0,0 +1,164 @@
+#include <scenefx/render/fx_renderer/fx_renderer.h>
+#include <scenefx/types/wlr_scene.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <wayland-server-core.h>
+#include <wlr/backend.h>
+#include <wlr/backend/headless.h>
+#include <wlr/render/allocator.h>
+#include <wlr/render/wlr_renderer.h>
+#include <wlr/types/wlr_output.h>
+#include <wlr/util/log.h>
+
+/* Measures the cost of relayouts of a scene shown on a headless output, with
+ * and without wlr_scene_transaction_begin() and wlr_scene_transaction_commit().
+ *
+ * The scene is a grid of small windows. Every relayout moves windows with the
+ * same number of wlr_scene_node_set_position() calls, spread over a square
+ * block of windows of growing size. Without a transaction every call updates
+ * the visibility of the scene and damages the output on its own, so the cost
+ * follows the number of calls. Within a transaction the calls are applied by
+ * a single update, whose cost follows the area which changed. */
+
+static const int output_width = 1280;
+static const int output_height = 720;
+static const int cell_size = 32;
+static const int window_margin = 2;
+static const int calls_per_relayout = 256;
+static const int relayouts = 200;
+static const int block_sizes[] = { 1, 2, 4, 8, 16 };
+
+struct bench {
+	struct wlr_scene *scene;
+	struct wlr_scene_rect **windows;
+	int cols, rows;
+};
+
+static void window_set_position(struct bench *bench, int col, int row, int offset) {
+	struct wlr_scene_rect *window = bench->windows[row * bench->cols + col];
+	wlr_scene_node_set_position(&window->node,
+		col * cell_size + window_margin + offset,
+		row * cell_size + window_margin + offset);
+}
+
+static void relayout(struct bench *bench, int block, int round) {
+	int count = block * block;
+	for (int i = 0; i < calls_per_relayout; i++) {
+		int window = i % count;
+		// Windows go back and forth by a pixel, so every call moves one
+		int offset = (i / count + round) % 2;
+		window_set_position(bench, window % block, window / block, offset);
+	}
+}
+
+struct bench_result {
+	double usec; // Per relayout
+	uint64_t nodes_visited; // Per relayout
+};
+
+static struct bench_result bench_run(struct bench *bench, int block, bool transaction) {
+	struct wlr_scene_visibility_stats before, after;
+	wlr_scene_get_visibility_stats(bench->scene, &before);
+
+	struct timespec start, end;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (int round = 0; round < relayouts; round++) {
+		if (transaction) {
+			wlr_scene_transaction_begin(bench->scene);
+		}
+		relayout(bench, block, round);
+		if (transaction) {
+			wlr_scene_transaction_commit(bench->scene);
+		}
+	}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	wlr_scene_get_visibility_stats(bench->scene, &after);
+
+	double usec = (end.tv_sec - start.tv_sec) * 1e6 +
+		(end.tv_nsec - start.tv_nsec) / 1e3;
+	return (struct bench_result){
+		.usec = usec / relayouts,
+		.nodes_visited = (after.nodes_visited - before.nodes_visited) / relayouts,
+	};
+}
+
+int main(void) {
+	wlr_log_init(WLR_ERROR, NULL);
+
+	struct wl_display *display = wl_display_create();
+	struct wlr_backend *backend =
+		wlr_headless_backend_create(wl_display_get_event_loop(display));
+	if (backend == NULL) {
+		wl_display_destroy(display);
+		return EXIT_FAILURE;
+	}
+
+	struct wlr_renderer *renderer = fx_renderer_create(backend);
+	if (renderer == NULL) {
+		wlr_backend_destroy(backend);
+		wl_display_destroy(display);
+		return EXIT_FAILURE;
+	}
+	struct wlr_allocator *allocator = wlr_allocator_autocreate(backend, renderer);
+
+	if (!wlr_backend_start(backend)) {
+		wlr_allocator_destroy(allocator);
+		wlr_renderer_destroy(renderer);
+		wlr_backend_destroy(backend);
+		wl_display_destroy(display);
+		return EXIT_FAILURE;
+	}
+
+	struct wlr_output *output =
+		wlr_headless_add_output(backend, output_width, output_height);
+	wlr_output_init_render(output, allocator, renderer);
+
+	struct wlr_output_state state;
+	wlr_output_state_init(&state);
+	wlr_output_state_set_enabled(&state, true);
+	wlr_output_commit_state(output, &state);
+	wlr_output_state_finish(&state);
+
+	struct bench bench = {
+		.scene = wlr_scene_create(),
+		.cols = output_width / cell_size,
+		.rows = output_height / cell_size,
+	};
+	wlr_scene_output_create(bench.scene, output);
+
+	bench.windows = calloc(bench.cols * bench.rows, sizeof(*bench.windows));
+	for (int row = 0; row < bench.rows; row++) {
+		for (int col = 0; col < bench.cols; col++) {
+			int size = cell_size - 2 * window_margin;
+			bench.windows[row * bench.cols + col] = wlr_scene_rect_create(
+				&bench.scene->tree, size, size, (float[4]){ 0.5f, 0.5f, 0.5f, 1 });
+			window_set_position(&bench, col, row, 0);
+		}
+	}
+
+	printf("%d windows, %d position changes per relayout\n\n",
+		bench.cols * bench.rows, calls_per_relayout);
+	printf("%8s %12s | %12s %10s | %12s %10s\n", "windows", "changed px",
+		"direct us", "visited", "batched us", "visited");
+	for (size_t i = 0; i < sizeof(block_sizes) / sizeof(block_sizes[0]); i++) {
+		int block = block_sizes[i];
+		struct bench_result direct = bench_run(&bench, block, false);
+		struct bench_result batched = bench_run(&bench, block, true);
+		printf("%8d %12d | %12.1f %10" PRIu64 " | %12.1f %10" PRIu64 "\n",
+			block * block, block * cell_size * block * cell_size,
+			direct.usec, direct.nodes_visited,
+			batched.usec, batched.nodes_visited);
+	}
+
+	wlr_scene_node_destroy(&bench.scene->tree.node);
+	free(bench.windows);
+	wlr_allocator_destroy(allocator);
+	wlr_renderer_destroy(renderer);
+	wlr_backend_destroy(backend);
+	wl_display_destroy(display);
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,183 @@
+#include <scenefx/render/fx_renderer/fx_renderer.h>
+#include <scenefx/types/wlr_scene.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <wayland-server-core.h>
+#include <wlr/backend.h>
+#include <wlr/backend/headless.h>
+#include <wlr/render/allocator.h>
+#include <wlr/render/wlr_renderer.h>
+#include <wlr/types/wlr_output.h>
+#include <wlr/util/log.h>
+
+/* Renders a static scene of 50 windows on a headless output and reports the
+ * GL calls the FX renderer saved per frame, using its counters of skipped
+ * uniform uploads and state changes.
+ *
+ * Every window has a shadow, a rounded border and rounded content. The whole
+ * output is redrawn every frame by a translucent rect on top of the scene,
+ * the windows themselves don't change. */
+
+static const int output_width = 1280;
+static const int output_height = 720;
+static const int window_cols = 10;
+static const int window_rows = 5;
+static const int window_width = 96;
+static const int window_height = 108;
+static const int border_width = 3;
+static const int corner_radius = 8;
+static const int shadow_sigma = 10;
+static const int warmup_frames = 10;
+static const int measured_frames = 100;
+
+struct server {
+	struct wl_display *display;
+	struct wlr_renderer *renderer;
+	struct wlr_scene_output *scene_output;
+	struct wlr_scene_rect *overlay;
+
+	int frame;
+	struct fx_renderer_stats start_stats;
+	bool failed;
+
+	struct wl_listener frame_listener;
+};
+
+static void add_window(struct wlr_scene_tree *parent, int x, int y, float shade) {
+	struct wlr_scene_tree *tree = wlr_scene_tree_create(parent);
+	wlr_scene_node_set_position(&tree->node, x, y);
+
+	int outer_width = window_width + 2 * border_width;
+	int outer_height = window_height + 2 * border_width;
+	struct wlr_scene_shadow *shadow = wlr_scene_shadow_create(tree,
+		outer_width + 2 * shadow_sigma, outer_height + 2 * shadow_sigma,
+		corner_radius + border_width, shadow_sigma, (float[4]){ 0, 0, 0, 0.5f });
+	wlr_scene_node_set_position(&shadow->node, -shadow_sigma, -shadow_sigma);
+
+	struct wlr_scene_rect *border = wlr_scene_rect_create(tree,
+		outer_width, outer_height, (float[4]){ 0.5f, 0.5f, 0.5f, 1 });
+	wlr_scene_rect_set_corner_radius(border, corner_radius + border_width);
+
+	struct wlr_scene_rect *content = wlr_scene_rect_create(tree,
+		window_width, window_height, (float[4]){ shade, 0.5f, 1 - shade, 1 });
+	wlr_scene_rect_set_corner_radius(content, corner_radius);
+	wlr_scene_node_set_position(&content->node, border_width, border_width);
+}
+
+static void output_handle_frame(struct wl_listener *listener, void *data) {
+	struct server *server = wl_container_of(listener, server, frame_listener);
+
+	if (server->frame == warmup_frames) {
+		fx_renderer_get_stats(server->renderer, &server->start_stats);
+	}
+
+	// Damages the whole output without changing the windows
+	float alpha = server->frame % 2 == 0 ? 0.1f : 0.2f;
+	wlr_scene_rect_set_color(server->overlay, (float[4]){ 0, 0, 0, alpha });
+
+	if (!wlr_scene_output_commit(server->scene_output, NULL)) {
+		wlr_log(WLR_ERROR, "Failed to render a frame");
+		server->failed = true;
+		wl_display_terminate(server->display);
+		return;
+	}
+
+	if (++server->frame == warmup_frames + measured_frames) {
+		wl_display_terminate(server->display);
+	}
+}
+
+int main(void) {
+	wlr_log_init(WLR_ERROR, NULL);
+
+	int status = EXIT_FAILURE;
+	struct server server = {0};
+	server.display = wl_display_create();
+	struct wlr_backend *backend =
+		wlr_headless_backend_create(wl_display_get_event_loop(server.display));
+	if (backend == NULL) {
+		goto error_display;
+	}
+
+	server.renderer = fx_renderer_create(backend);
+	if (server.renderer == NULL) {
+		goto error_backend;
+	}
+	struct wlr_allocator *allocator = wlr_allocator_autocreate(backend, server.renderer);
+	if (allocator == NULL) {
+		goto error_renderer;
+	}
+	struct wlr_scene *scene = wlr_scene_create();
+
+	if (!wlr_backend_start(backend)) {
+		goto error_scene;
+	}
+
+	struct wlr_output *output =
+		wlr_headless_add_output(backend, output_width, output_height);
+	wlr_output_init_render(output, allocator, server.renderer);
+	server.scene_output = wlr_scene_output_create(scene, output);
+
+	struct wlr_output_state state;
+	wlr_output_state_init(&state);
+	wlr_output_state_set_enabled(&state, true);
+	bool enabled = wlr_output_commit_state(output, &state);
+	wlr_output_state_finish(&state);
+	if (!enabled) {
+		goto error_scene;
+	}
+
+	int cell_width = output_width / window_cols;
+	int cell_height = output_height / window_rows;
+	for (int row = 0; row < window_rows; row++) {
+		for (int col = 0; col < window_cols; col++) {
+			float shade = (float)(row * window_cols + col) /
+				(window_rows * window_cols);
+			add_window(&scene->tree,
+				col * cell_width + (cell_width - window_width) / 2,
+				row * cell_height + (cell_height - window_height) / 2, shade);
+		}
+	}
+	server.overlay = wlr_scene_rect_create(&scene->tree,
+		output_width, output_height, (float[4]){ 0, 0, 0, 0.1f });
+
+	server.frame_listener.notify = output_handle_frame;
+	wl_signal_add(&output->events.frame, &server.frame_listener);
+	wlr_output_schedule_frame(output);
+
+	wl_display_run(server.display);
+	wl_list_remove(&server.frame_listener.link);
+
+	if (!server.failed) {
+		struct fx_renderer_stats stats;
+		fx_renderer_get_stats(server.renderer, &stats);
+		const struct fx_renderer_stats *start = &server.start_stats;
+		double draw_calls =
+			(double)(stats.draw_calls - start->draw_calls) / measured_frames;
+		double uniform_calls_skipped = (double)(stats.uniform_calls_skipped -
+			start->uniform_calls_skipped) / measured_frames;
+		double state_calls_skipped = (double)(stats.state_calls_skipped -
+			start->state_calls_skipped) / measured_frames;
+
+		printf("%d windows, per frame over %d frames:\n",
+			window_cols * window_rows, measured_frames);
+		printf("  draw calls:               %8.1f\n", draw_calls);
+		printf("  uniform uploads skipped:  %8.1f\n", uniform_calls_skipped);
+		printf("  state changes skipped:    %8.1f\n", state_calls_skipped);
+		printf("  GL calls saved:           %8.1f\n",
+			uniform_calls_skipped + state_calls_skipped);
+		status = EXIT_SUCCESS;
+	}
+
+error_scene:
+	wlr_scene_node_destroy(&scene->tree.node);
+	wlr_allocator_destroy(allocator);
+error_renderer:
+	wlr_renderer_destroy(server.renderer);
+error_backend:
+	wlr_backend_destroy(backend);
+error_display:
+	wl_display_destroy(server.display);
+	return status;
+}
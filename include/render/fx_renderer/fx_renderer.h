@@ -7,6 +7,7 @@
 #include <time.h>
 #include <wlr/render/egl.h>
 #include <wlr/render/interface.h>
+#include <wlr/render/pass.h>
 #include <wlr/render/swapchain.h>
 #include <wlr/render/wlr_texture.h>
 #include <wlr/util/addon.h>
@@ -16,6 +17,16 @@
 #include "render/tracy.h"
 
 struct fx_framebuffer;
+struct fx_gles_render_pass;
+
+enum fx_batch_type {
+	// Solid rects, GLfloat x, y, r, g, b, a per vertex
+	FX_BATCH_RECTS,
+	// Instances of the quad_round_instanced program, struct fx_batch_instance
+	FX_BATCH_ROUNDED_RECTS,
+	// Instances of the box_shadow_instanced program, struct fx_batch_instance
+	FX_BATCH_BOX_SHADOWS,
+};
 
 struct fx_pixel_format {
 	uint32_t drm_format;
@@ -46,17 +57,24 @@ struct fx_framebuffer {
 	GLuint fbo;
 	GLuint tex;
 	GLuint sb; // Stencil
+	// Set for buffers which are never stencil tested, see
+	// fx_framebuffer_get_or_create_custom
+	bool no_stencil;
+
+	// Filter last set on tex, shared by all textures imported from the buffer
+	GLint tex_filter;
 
 	struct wlr_addon addon;
 };
 
 /**
- * Should only be used with custom fbs.
+ * Should only be used with custom fbs. Buffers which are only ever drawn to
+ * with the stencil test disabled can skip the stencil attachment.
  * Note: Does not bind back to the default Framebuffer!
  */
 void fx_framebuffer_get_or_create_custom(struct fx_renderer *fx_renderer,
 		struct wlr_allocator *allocator, int width, int height, bool has_alpha,
-		struct fx_framebuffer **fx_buffer, bool *failed);
+		bool stencil, struct fx_framebuffer **fx_buffer, bool *failed);
 
 struct fx_framebuffer *fx_framebuffer_get_or_create(struct fx_renderer *renderer,
 		struct wlr_buffer *wlr_buffer);
@@ -85,6 +103,8 @@ struct fx_texture {
 	// case.
 	GLuint tex;
 	GLuint fbo;
+	// Filter last set on tex if owned, 0 if unknown. See fx_gl_texture_filter
+	GLint filter;
 
 	bool has_alpha;
 
@@ -114,6 +134,275 @@ void push_fx_debug_(struct fx_renderer *renderer, const char *file, const char *
 
 void pop_fx_debug(struct fx_renderer *renderer);
 
+/**
+ * Links the given groups of programs (a bitmask of enum fx_renderer_programs)
+ * if they aren't linked yet. Returns false if any of them failed to link,
+ * failed groups aren't retried.
+ */
+bool fx_renderer_link_programs(struct fx_renderer *renderer, uint32_t programs);
+
+/**
+ * Get the program for the given variant, linking it on first use. If the
+ * variant fails to link, the full variant is returned instead, or NULL if
+ * that can't be linked either. The full variant is also returned while the
+ * variant is still compiling in the background, if it is already linked.
+ *
+ * The variant of the returned program is stored in picked. It may evaluate
+ * features which weren't asked for, callers must set neutral uniforms for
+ * those (zero radii, no discard).
+ */
+struct tex_shader *fx_renderer_tex_shader(struct fx_renderer *renderer,
+	enum fx_tex_shader_source source, const struct shader_variant *variant,
+	struct shader_variant *picked);
+
+struct quad_round_shader *fx_renderer_quad_round_shader(struct fx_renderer *renderer,
+	const struct shader_variant *variant, struct shader_variant *picked);
+
+struct box_shadow_shader *fx_renderer_box_shadow_shader(struct fx_renderer *renderer,
+	const struct shader_variant *variant, struct shader_variant *picked);
+
+/**
+ * Get the instanced programs, linking them on first use. Returns NULL if
+ * instancing isn't supported or the program fails to link.
+ */
+struct instanced_shader *fx_renderer_quad_round_instanced_shader(
+	struct fx_renderer *renderer);
+
+struct instanced_shader *fx_renderer_box_shadow_instanced_shader(
+	struct fx_renderer *renderer);
+
+///
+/// fx_offscreen_buffers
+///
+
+struct fx_offscreen_buffers;
+
+/**
+ * Imports the offscreen buffers which don't have an up to date texture yet,
+ * i.e. after they were created or resized. Returns false on failure.
+ */
+bool fx_offscreen_buffers_update_textures(struct fx_offscreen_buffers *fbos);
+
+/**
+ * Returns the texture of one of the offscreen buffers. The texture is owned by
+ * the fx_offscreen_buffers and must not be destroyed.
+ */
+struct wlr_texture *fx_offscreen_buffers_get_texture(
+		struct fx_offscreen_buffers *fbos, struct fx_framebuffer *buffer);
+
+///
+/// fx_vertex_ring
+///
+
+/**
+ * A streaming vertex buffer shared by all draws of the renderer. Vertices are
+ * generated into a reused staging array and appended to the buffer object.
+ * Once the buffer is full its storage is orphaned, so that uploads never have
+ * to wait for queued draws still reading older vertices.
+ */
+struct fx_vertex_ring {
+	GLuint vbo;
+	GLsizeiptr size; // in bytes
+	GLintptr offset; // in bytes
+
+	GLfloat *staging;
+	size_t staging_len, staging_cap; // in floats
+};
+
+bool fx_vertex_ring_init(struct fx_vertex_ring *ring);
+
+void fx_vertex_ring_finish(struct fx_vertex_ring *ring);
+
+/**
+ * Returns storage for len floats of vertex data, or NULL on failure. The
+ * storage is only valid until the next call on the ring.
+ */
+GLfloat *fx_vertex_ring_reserve(struct fx_vertex_ring *ring, size_t len);
+
+/**
+ * Uploads the reserved vertex data and leaves the vertex buffer bound to
+ * GL_ARRAY_BUFFER. Returns the offset of the data in the buffer.
+ */
+GLintptr fx_vertex_ring_upload(struct fx_vertex_ring *ring);
+
+///
+/// fx_program_cache
+///
+
+/**
+ * An on-disk cache of linked program binaries, using GL_OES_get_program_binary.
+ * Binaries are stored per shader source under $XDG_CACHE_HOME/scenefx/programs
+ * and tagged with the driver and scenefx version which produced them, stale
+ * binaries are ignored and overwritten.
+ *
+ * Disabled if the extension is missing, no cache directory is available or
+ * WLR_RENDERER_DISABLE_PROGRAM_CACHE is set.
+ *
+ * Also holds the programs started in the background, which are picked up by
+ * link_program_with_vert once the same sources are linked for real.
+ */
+struct fx_program_cache {
+	bool enabled;
+	char *dir;
+	uint64_t driver_hash;
+
+	// Set while programs are only started, see fx_renderer_prewarm_programs
+	bool background;
+	struct wl_array pending; // struct pending_program
+	// Set while a draw has another program to fall back to. Pending programs
+	// which are still compiling are then left pending instead of waited for,
+	// and busy is set.
+	bool poll, busy;
+
+	// Counters, logged once the shaders are linked. Misses are also counted
+	// while the cache is disabled.
+	int hits, misses, stores;
+
+	struct {
+		PFNGLGETPROGRAMBINARYOESPROC glGetProgramBinaryOES;
+		PFNGLPROGRAMBINARYOESPROC glProgramBinaryOES;
+	} procs;
+};
+
+void fx_program_cache_init(struct fx_program_cache *cache, const char *exts_str);
+
+void fx_program_cache_finish(struct fx_program_cache *cache);
+
+/**
+ * Returns a program linked from the cached binary for the sources, or 0 if
+ * there is no usable binary.
+ */
+GLuint fx_program_cache_load(struct fx_program_cache *cache,
+	const GLchar *vert_src, const GLchar *frag_src);
+
+/**
+ * Stores the binary of the program linked from the sources.
+ */
+void fx_program_cache_store(struct fx_program_cache *cache, GLuint prog,
+	const GLchar *vert_src, const GLchar *frag_src);
+
+void fx_program_cache_add_pending(struct fx_program_cache *cache, GLuint prog,
+	const GLchar *vert_src, const GLchar *frag_src, bool from_binary);
+
+/**
+ * Removes and returns the program started in the background for the sources,
+ * or 0 if there is none. The link status of the program is still unchecked.
+ *
+ * While polling, returns 0 and sets busy if the program is still compiling.
+ */
+GLuint fx_program_cache_take_pending(struct fx_program_cache *cache,
+	const GLchar *vert_src, const GLchar *frag_src, bool *from_binary);
+
+///
+/// fx_gradient_luts
+///
+
+#define FX_GRADIENT_LUT_WIDTH 256
+#define FX_GRADIENT_LUT_CACHE_SIZE 32
+
+struct fx_gradient_lut {
+	GLuint tex; // 0 if unused
+	uint64_t hash;
+	uint64_t last_used;
+	// What the texture was baked from, compared on a hash match
+	float *colors;
+	int count;
+	bool blend;
+};
+
+/**
+ * Gradients baked into FX_GRADIENT_LUT_WIDTH x 1 textures, which the gradient
+ * shaders sample instead of walking the colors per fragment. The textures are
+ * looked up by a hash of the colors and matched against a copy of them, the
+ * least recently used one is replaced once the cache is full.
+ */
+struct fx_gradient_luts {
+	struct fx_gradient_lut entries[FX_GRADIENT_LUT_CACHE_SIZE];
+	uint64_t clock;
+};
+
+struct fx_gradient;
+
+/**
+ * Returns the lookup texture of the gradient, creating it if needed. Changes
+ * the texture bound to the active unit. Returns 0 on failure.
+ */
+GLuint fx_gradient_lut_get(struct fx_renderer *renderer,
+	const struct fx_gradient *gradient);
+
+void fx_gradient_luts_finish(struct fx_renderer *renderer);
+
+///
+/// fx_gl_state
+///
+
+#define FX_GL_STATE_TEXTURE_UNITS 4
+
+/**
+ * A shadow copy of the GL state changed by the renderer, used to skip calls
+ * which would not change anything. All state changes of the renderer have to
+ * go through the fx_gl_* functions below for the copy to stay accurate.
+ *
+ * Unknown values are all bits set, see fx_gl_state_invalidate.
+ */
+struct fx_gl_state {
+	GLuint program;
+	GLuint framebuffer;
+
+	GLuint blend; // GL_TRUE or GL_FALSE
+	GLenum blend_src, blend_dst;
+
+	GLuint stencil_test; // GL_TRUE or GL_FALSE
+	GLenum stencil_func;
+	GLint stencil_ref;
+	GLuint stencil_mask;
+	GLenum stencil_fail, stencil_zfail, stencil_zpass;
+
+	GLenum active_texture;
+	// Bound to GL_TEXTURE_2D and GL_TEXTURE_EXTERNAL_OES, per unit
+	GLuint textures[FX_GL_STATE_TEXTURE_UNITS][2];
+};
+
+/**
+ * Forgets all of the tracked state, e.g. when something outside of the
+ * renderer may have changed it.
+ */
+void fx_gl_state_invalidate(struct fx_gl_state *state);
+
+void fx_gl_use_program(struct fx_renderer *renderer, GLuint program);
+
+void fx_gl_bind_framebuffer(struct fx_renderer *renderer, GLuint fbo);
+
+void fx_gl_set_blend(struct fx_renderer *renderer, bool enabled);
+
+void fx_gl_blend_func(struct fx_renderer *renderer, GLenum src, GLenum dst);
+
+void fx_gl_set_stencil_test(struct fx_renderer *renderer, bool enabled);
+
+void fx_gl_stencil_func(struct fx_renderer *renderer, GLenum func, GLint ref,
+	GLuint mask);
+
+void fx_gl_stencil_op(struct fx_renderer *renderer, GLenum fail, GLenum zfail,
+	GLenum zpass);
+
+void fx_gl_active_texture(struct fx_renderer *renderer, GLenum unit);
+
+void fx_gl_bind_texture(struct fx_renderer *renderer, GLenum target, GLuint tex);
+
+/**
+ * Sets both the min and mag filter of the texture, which has to be bound to
+ * the active texture unit.
+ */
+void fx_gl_texture_filter(struct fx_renderer *renderer,
+	struct fx_texture *texture, GLint filter);
+
+/**
+ * Must be called before deleting a texture or framebuffer, as GL silently
+ * unbinds them and their names may be reused afterwards.
+ */
+void fx_gl_forget_texture(struct fx_renderer *renderer, GLuint tex);
+void fx_gl_forget_framebuffer(struct fx_renderer *renderer, GLuint fbo);
+
 ///
 /// Render Timer
 ///
@@ -164,6 +453,9 @@ struct fx_renderer {
 		bool OES_texture_half_float_linear;
 		bool EXT_texture_norm16;
 		bool EXT_disjoint_timer_query;
+		// GLES 3.0 or GL_EXT_instanced_arrays
+		bool instanced_arrays;
+		bool KHR_parallel_shader_compile;
 	} exts;
 
 	struct {
@@ -180,6 +472,9 @@ struct fx_renderer {
 		PFNGLGETQUERYOBJECTIVEXTPROC glGetQueryObjectivEXT;
 		PFNGLGETQUERYOBJECTUI64VEXTPROC glGetQueryObjectui64vEXT;
 		PFNGLGETINTEGER64VEXTPROC glGetInteger64vEXT;
+		PFNGLDRAWARRAYSINSTANCEDEXTPROC glDrawArraysInstanced;
+		PFNGLVERTEXATTRIBDIVISOREXTPROC glVertexAttribDivisor;
+		PFNGLMAXSHADERCOMPILERTHREADSKHRPROC glMaxShaderCompilerThreadsKHR;
 		TRACY_FN(
 			PFNGLGETQUERYIVEXTPROC glGetQueryivEXT;
 		)
@@ -188,23 +483,51 @@ struct fx_renderer {
 	struct {
 		struct quad_shader quad;
 		struct quad_shader quad_clip;
+		struct quad_batch_shader quad_batch;
 		struct quad_grad_shader quad_grad;
-		struct quad_round_shader quad_round;
 		struct quad_grad_round_shader quad_grad_round;
 
-		struct tex_shader tex_rgba;
-		struct tex_shader tex_rgbx;
-		struct tex_shader tex_ext;
-		struct tex_shader tex_effects_rgba;
-		struct tex_shader tex_effects_rgbx;
-		struct tex_shader tex_effects_ext;
+		// Specialised variants, indexed by shader_variant_index() and linked
+		// on first use. Only the full variants are linked up front. The tex
+		// shaders are additionally indexed by enum fx_tex_shader_source - 1.
+		struct quad_round_shader quad_round[SHADER_VARIANTS];
+		struct tex_shader tex[3][SHADER_VARIANTS];
+		struct box_shadow_shader box_shadow[SHADER_VARIANTS];
 
-		struct box_shadow_shader box_shadow;
+		// Only linked if instanced_arrays is supported
+		struct instanced_shader quad_round_instanced;
+		struct instanced_shader box_shadow_instanced;
 		struct blur_shader blur1;
 		struct blur_shader blur2;
+		struct blur_shader blur2_effects;
 		struct blur_effects_shader blur_effects;
 	} shaders;
 
+	// Bitmasks of enum fx_renderer_programs
+	struct {
+		uint32_t linked;
+		uint32_t failed;
+		// Compiling in the background, but not linked yet
+		uint32_t started;
+	} programs;
+
+	struct fx_program_cache program_cache;
+	struct fx_gradient_luts gradient_luts;
+	struct fx_vertex_ring vertex_ring;
+	struct fx_gl_state gl_state;
+
+	// Primitives of a single type waiting to be drawn with a single draw
+	// call. Flushed before anything else is drawn, so that painter's order
+	// is kept.
+	struct {
+		struct fx_gles_render_pass *pass; // NULL if empty
+		enum fx_batch_type type;
+		enum wlr_render_blend_mode blend_mode;
+		struct wl_array data;
+	} batch;
+
+	struct fx_renderer_stats stats;
+
 	struct wl_list buffers; // fx_framebuffer.link
 	struct wl_list textures; // fx_texture.link
 	struct wl_list offscreen_buffers; // fx_offscreen_buffers.link
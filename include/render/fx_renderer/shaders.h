@@ -3,14 +3,18 @@
 
 #include <GLES2/gl2.h>
 #include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
 #include <scenefx/types/fx/clipped_region.h>
 #include "types/fx/clipped_region.h"
 
 struct fx_renderer;
+struct fx_program_cache;
 
-GLuint compile_shader(GLuint type, const GLchar *src);
+GLuint link_program(struct fx_program_cache *cache, const GLchar *frag_src);
 
-GLuint link_program(const GLchar *frag_src);
+GLuint link_program_with_vert(struct fx_program_cache *cache,
+		const GLchar *vert_src, const GLchar *frag_src);
 
 bool check_gl_ext(const char *exts, const char *ext);
 
@@ -22,6 +26,30 @@ enum fx_tex_shader_source {
 	SHADER_SOURCE_TEXTURE_EXTERNAL = 3,
 };
 
+enum shader_corners {
+	SHADER_CORNERS_NONE = 0,
+	// All four corners share the top left radius
+	SHADER_CORNERS_UNIFORM = 1,
+	SHADER_CORNERS_PER_CORNER = 2,
+};
+
+/**
+ * The features compiled into a specialised program. Programs only evaluate
+ * what their variant enables, so draws should use the smallest variant
+ * covering their options. See tex.frag, quad_round.frag and box_shadow.frag.
+ */
+struct shader_variant {
+	enum shader_corners corners;
+	// Cut out the rounded clipped region
+	bool clip;
+	// Support the discard_transparent uniform
+	bool discard_transparent;
+};
+
+#define SHADER_VARIANTS 12
+
+size_t shader_variant_index(const struct shader_variant *variant);
+
 struct shader_corner_radii {
 	GLint top_left;
 	GLint top_right;
@@ -29,16 +57,52 @@ struct shader_corner_radii {
 	GLint bottom_right;
 };
 
-void uniform_corner_radii_set(const struct shader_corner_radii *uniform,
+#define SHADER_UNIFORM_CACHE_LEN 64
+
+/**
+ * The values last uploaded to the uniforms of a program, so that uploading
+ * the same value again can be skipped. Values are cached by location. Arrays
+ * and locations past SHADER_UNIFORM_CACHE_LEN are always uploaded.
+ *
+ * The uniform_*_set functions must be called with the program in use.
+ */
+struct shader_uniform_cache {
+	GLfloat values[SHADER_UNIFORM_CACHE_LEN][4];
+	uint64_t valid; // one bit per location
+
+	// mat3 uniforms, i.e. proj and tex_proj
+	struct {
+		GLint loc;
+		GLfloat value[9];
+	} matrices[2];
+	size_t matrices_len;
+};
+
+void shader_uniform_cache_reset(struct shader_uniform_cache *cache);
+
+void uniform_1f_set(struct fx_renderer *renderer, struct shader_uniform_cache *cache,
+		GLint loc, GLfloat x);
+void uniform_2f_set(struct fx_renderer *renderer, struct shader_uniform_cache *cache,
+		GLint loc, GLfloat x, GLfloat y);
+void uniform_4f_set(struct fx_renderer *renderer, struct shader_uniform_cache *cache,
+		GLint loc, GLfloat x, GLfloat y, GLfloat z, GLfloat w);
+void uniform_1i_set(struct fx_renderer *renderer, struct shader_uniform_cache *cache,
+		GLint loc, GLint x);
+void uniform_matrix3_set(struct fx_renderer *renderer,
+		struct shader_uniform_cache *cache, GLint loc, const GLfloat value[static 9]);
+
+void uniform_corner_radii_set(struct fx_renderer *renderer,
+		struct shader_uniform_cache *cache, const struct shader_corner_radii *uniform,
 		const struct fx_corner_fradii *corners);
 
 struct quad_shader {
 	GLuint program;
+	struct shader_uniform_cache uniforms;
 	GLint proj;
 	GLint color;
 	GLint pos_attrib;
 
-	// Only used for the effects shader
+	// Only located for variants with corners or clip
 	struct {
 		GLint clip_size;
 		GLint clip_position;
@@ -46,28 +110,45 @@ struct quad_shader {
 	} effects;
 };
 
-bool link_quad_program(struct quad_shader *shader, bool clip);
+bool link_quad_program(struct fx_program_cache *cache,
+		struct quad_shader *shader, bool clip);
 
-struct quad_grad_shader {
-	int max_len;
+/**
+ * Draws solid quads with a per-vertex color, with vertices in buffer
+ * coordinates. Used to draw many rects at once.
+ */
+struct quad_batch_shader {
+	GLuint program;
+	struct shader_uniform_cache uniforms;
+	GLint proj;
+	GLint pos_attrib;
+	GLint color_attrib;
+};
 
+bool link_quad_batch_program(struct fx_program_cache *cache,
+		struct quad_batch_shader *shader);
+
+struct quad_grad_shader {
 	GLuint program;
+	struct shader_uniform_cache uniforms;
 	GLint proj;
-	GLint colors;
+	GLint lut;
 	GLint size;
-	GLint degree;
+	GLint rotation;
 	GLint grad_box;
 	GLint pos_attrib;
 	GLint linear;
 	GLint origin;
-	GLint count;
-	GLint blend;
 };
 
-bool link_quad_grad_program(struct quad_grad_shader *shader, int max_len);
+bool link_quad_grad_program(struct fx_program_cache *cache,
+		struct quad_grad_shader *shader);
 
 struct quad_round_shader {
 	GLuint program;
+	// Set if this variant failed to link
+	bool link_failed;
+	struct shader_uniform_cache uniforms;
 	GLint proj;
 	GLint color;
 	GLint pos_attrib;
@@ -81,34 +162,36 @@ struct quad_round_shader {
 	struct shader_corner_radii clip_radius;
 };
 
-bool link_quad_round_program(struct quad_round_shader *shader);
+bool link_quad_round_program(struct fx_program_cache *cache,
+		struct quad_round_shader *shader, const struct shader_variant *variant);
 
 struct quad_grad_round_shader {
 	GLuint program;
+	struct shader_uniform_cache uniforms;
 	GLint proj;
 	GLint color;
 	GLint pos_attrib;
 	GLint size;
 	GLint position;
 
-	GLint colors;
+	GLint lut;
 	GLint grad_size;
-	GLint degree;
+	GLint rotation;
 	GLint grad_box;
 	GLint linear;
 	GLint origin;
-	GLint count;
-	GLint blend;
 
 	struct shader_corner_radii radius;
-
-	int max_len;
 };
 
-bool link_quad_grad_round_program(struct quad_grad_round_shader *shader, int max_len);
+bool link_quad_grad_round_program(struct fx_program_cache *cache,
+		struct quad_grad_round_shader *shader);
 
 struct tex_shader {
 	GLuint program;
+	// Set if this variant failed to link
+	bool link_failed;
+	struct shader_uniform_cache uniforms;
 	GLint proj;
 	GLint tex_proj;
 	GLint tex;
@@ -117,7 +200,7 @@ struct tex_shader {
 
 	GLint discard_transparent;
 
-	// Only used for the effects shader
+	// Only located for variants with corners or clip
 	struct {
 		GLint size;
 		GLint position;
@@ -129,11 +212,15 @@ struct tex_shader {
 	} effects;
 };
 
-bool link_tex_program(struct tex_shader *shader, enum fx_tex_shader_source source,
-		bool effects);
+bool link_tex_program(struct fx_program_cache *cache,
+		struct tex_shader *shader, enum fx_tex_shader_source source,
+		const struct shader_variant *variant);
 
 struct box_shadow_shader {
 	GLuint program;
+	// Set if this variant failed to link
+	bool link_failed;
+	struct shader_uniform_cache uniforms;
 	GLint proj;
 	GLint color;
 	GLint pos_attrib;
@@ -147,33 +234,72 @@ struct box_shadow_shader {
 	struct shader_corner_radii clip_radius;
 };
 
-bool link_box_shadow_program(struct box_shadow_shader *shader);
+bool link_box_shadow_program(struct fx_program_cache *cache,
+		struct box_shadow_shader *shader, const struct shader_variant *variant);
+
+/**
+ * Instanced variant of the quad_round and box_shadow programs. The
+ * parameters of each primitive are passed as per-instance attributes instead
+ * of uniforms, so that many primitives can be drawn with a single call.
+ */
+struct instanced_shader {
+	GLuint program;
+	// Set if the program failed to link
+	bool link_failed;
+	struct shader_uniform_cache uniforms;
+	GLint proj;
+	GLint pos_attrib;
+
+	GLint draw_box_attrib;
+	GLint color_attrib;
+	GLint box_attrib;
+	GLint radius_attrib;
+	GLint clip_box_attrib;
+	GLint clip_radius_attrib;
+};
+
+bool link_quad_round_instanced_program(struct fx_program_cache *cache,
+		struct instanced_shader *shader);
+bool link_box_shadow_instanced_program(struct fx_program_cache *cache,
+		struct instanced_shader *shader);
 
 struct blur_shader {
 	GLuint program;
+	struct shader_uniform_cache uniforms;
 	GLint proj;
 	GLint tex_proj;
 	GLint tex;
 	GLint pos_attrib;
 	GLint radius;
 	GLint halfpixel;
+
+	// Only in the blur2 variant applying the blur effects
+	GLint noise;
+	GLint brightness;
+	GLint contrast;
+	GLint saturation;
 };
 
-bool link_blur1_program(struct blur_shader *shader);
-bool link_blur2_program(struct blur_shader *shader);
+bool link_blur1_program(struct fx_program_cache *cache,
+		struct blur_shader *shader);
+bool link_blur2_program(struct fx_program_cache *cache,
+		struct blur_shader *shader, bool effects);
 
 struct blur_effects_shader {
 	GLuint program;
+	struct shader_uniform_cache uniforms;
 	GLint proj;
 	GLint tex_proj;
 	GLint tex;
 	GLint pos_attrib;
+	GLint alpha;
 	GLfloat noise;
 	GLfloat brightness;
 	GLfloat contrast;
 	GLfloat saturation;
 };
 
-bool link_blur_effects_program(struct blur_effects_shader *shader);
+bool link_blur_effects_program(struct fx_program_cache *cache,
+		struct blur_effects_shader *shader);
 
 #endif
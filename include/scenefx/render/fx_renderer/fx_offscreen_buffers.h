@@ -4,6 +4,9 @@
 #include <wlr/types/wlr_output.h>
 #include <wlr/util/addon.h>
 
+// Maximum number of blur passes, deeper blurs are clamped
+#define FX_OFFSCREEN_BLUR_LEVELS 8
+
 /**
  * Used to add effect framebuffers per output instead of every output sharing
  * them.
@@ -11,19 +14,49 @@
 struct fx_offscreen_buffers {
 	struct wl_list link; // fx_renderer.offscreen_buffers
 	struct wlr_addon addon;
+	struct wlr_output *output;
 
-	// Contains the blurred background for tiled windows
+	// Contains the blurred background for tiled windows, the blur of the
+	// optimized blur lands here directly. NULL until an optimized blur is
+	// rendered.
 	struct fx_framebuffer *optimized_blur_buffer;
 	// Contains the non-blurred background for tiled windows. Used for blurring
 	// optimized surfaces with an alpha. Just as inefficient as the regular blur.
+	// NULL until an optimized blur is rendered.
 	struct fx_framebuffer *optimized_no_blur_buffer;
 	// Contains the original pixels to draw over the areas where artifact are visible
 	struct fx_framebuffer *blur_saved_pixels_buffer;
-	// Blur swaps between the two effects buffers every time it scales the image
-	// Buffer used for effects
+	// Buffer used for effects, the other blurs land here with their effects
+	// applied. NULL until such a blur is drawn.
 	struct fx_framebuffer *effects_buffer;
-	// Swap buffer used for effects
-	struct fx_framebuffer *effects_buffer_swapped;
+	// Downsampled levels of the blur, level i is 1/2^(i+1) of the output size.
+	// Blur passes go down and back up these before landing in effects_buffer
+	// or optimized_blur_buffer.
+	// Only the levels used by the configured number of passes exist.
+	struct fx_framebuffer *blur_levels[FX_OFFSCREEN_BLUR_LEVELS];
+	// Level i holds the optimized blur backdrop blurred with i+1 passes and
+	// without the blur effects, at the size of blur_levels[0]. Lower blur
+	// strengths of the optimized blur blend between these. They're built
+	// when first needed after a re-render of the optimized blur, and dropped
+	// if no lower strength was drawn until the next one.
+	struct fx_framebuffer *optimized_blur_levels[FX_OFFSCREEN_BLUR_LEVELS];
+	// The passes and radius optimized_blur_levels were last rendered with,
+	// no passes if they aren't usable
+	int optimized_blur_passes;
+	float optimized_blur_radius;
+	// The passes of the top level if the last re-render kept it, 0 otherwise
+	int optimized_blur_top_passes;
+	// Whether a lower strength was drawn since the last re-render
+	bool optimized_blur_levels_used;
+
+	// Textures of the buffers above, kept for as long as their buffer instead
+	// of being imported for every draw
+	struct wlr_texture *optimized_blur_texture;
+	struct wlr_texture *optimized_no_blur_texture;
+	struct wlr_texture *blur_saved_pixels_texture;
+	struct wlr_texture *effects_texture;
+	struct wlr_texture *blur_level_textures[FX_OFFSCREEN_BLUR_LEVELS];
+	struct wlr_texture *optimized_blur_level_textures[FX_OFFSCREEN_BLUR_LEVELS];
 };
 
 void fx_offscreen_buffers_destroy(struct fx_offscreen_buffers *fbos);
@@ -3,12 +3,47 @@
 
 #include <GLES2/gl2.h>
 #include <GLES2/gl2ext.h>
+#include <stdint.h>
 #include <wlr/backend.h>
 #include <wlr/render/interface.h>
 #include <wlr/types/wlr_buffer.h>
 
 struct fx_renderer;
 
+/** Counters of the GL work done by the FX renderer */
+struct fx_renderer_stats {
+	// Draw calls issued since the renderer was created
+	uint64_t draw_calls;
+	// Draw calls issued by the last submitted render pass
+	uint32_t last_pass_draw_calls;
+	// GL state changes skipped because they would not have changed anything
+	uint64_t state_calls_skipped;
+	// State changes skipped by the last submitted render pass
+	uint32_t last_pass_state_calls_skipped;
+	// Uniform uploads skipped because the program already had the value
+	uint64_t uniform_calls_skipped;
+	// Uniform uploads skipped by the last submitted render pass
+	uint32_t last_pass_uniform_calls_skipped;
+	// Texture objects created, including imports of buffers
+	uint64_t textures_created;
+	// Texture objects created by the last submitted render pass
+	uint32_t last_pass_textures_created;
+};
+
+/**
+ * Groups of effect programs. These are only linked once the renderer first
+ * draws something needing them, see fx_renderer_prewarm_programs.
+ */
+enum fx_renderer_programs {
+	// Rounded corners and clipping of textures and rects
+	FX_RENDERER_PROGRAMS_ROUNDED = 1 << 0,
+	FX_RENDERER_PROGRAMS_GRADIENTS = 1 << 1,
+	FX_RENDERER_PROGRAMS_SHADOWS = 1 << 2,
+	FX_RENDERER_PROGRAMS_BLUR = 1 << 3,
+
+	FX_RENDERER_PROGRAMS_ALL = (1 << 4) - 1,
+};
+
 struct wlr_renderer *fx_renderer_create_with_drm_fd(int drm_fd);
 struct wlr_renderer *fx_renderer_create(struct wlr_backend *backend);
 
@@ -17,6 +52,18 @@ struct fx_renderer *fx_get_renderer(struct wlr_renderer *wlr_renderer);
 bool fx_renderer_check_ext(struct wlr_renderer *renderer, const char *ext);
 GLuint fx_renderer_get_buffer_fbo(struct wlr_renderer *renderer, struct wlr_buffer *buffer);
 
+void fx_renderer_get_stats(struct wlr_renderer *renderer, struct fx_renderer_stats *stats);
+
+/**
+ * Prepares the given programs (a bitmask of enum fx_renderer_programs) ahead
+ * of their first use, so that the first frame using them doesn't stall on
+ * shader compilation. This includes the specialised variants most draws
+ * pick. With GL_KHR_parallel_shader_compile the programs are compiled in the
+ * background, and draws fall back to an already linked variant while theirs
+ * is still compiling. Otherwise they are linked before returning.
+ */
+void fx_renderer_prewarm_programs(struct wlr_renderer *renderer, uint32_t programs);
+
 //
 // fx_texture
 //
@@ -2,6 +2,7 @@
 #define SCENE_FX_RENDER_PASS_H
 
 #include <stdbool.h>
+#include <wlr/render/allocator.h>
 #include <wlr/render/pass.h>
 #include <wlr/render/interface.h>
 #include <wlr/render/swapchain.h>
@@ -17,6 +18,14 @@ struct fx_gles_render_pass {
 	struct fx_render_timer *timer;
 	struct wlr_drm_syncobj_timeline *signal_timeline;
 	uint64_t signal_point;
+	// fx_renderer_stats.draw_calls when the pass began
+	uint64_t draw_calls_start;
+	// fx_renderer_stats.state_calls_skipped when the pass began
+	uint64_t state_calls_skipped_start;
+	// fx_renderer_stats.uniform_calls_skipped when the pass began
+	uint64_t uniform_calls_skipped_start;
+	// fx_renderer_stats.textures_created when the pass began
+	uint64_t textures_created_start;
 
 	// The region where there's blur
 	pixman_region32_t blur_padding_region;
@@ -82,9 +91,25 @@ struct fx_render_box_shadow_options {
 	struct wlr_render_color color;
 };
 
+/**
+ * A blurred backdrop kept across frames, covering box of the pass buffer.
+ * Filled by fx_render_pass_save_blur.
+ */
+struct fx_blur_cache {
+	struct fx_framebuffer *buffer;
+	struct wlr_texture *texture;
+	struct wlr_box box;
+};
+
 struct fx_render_blur_pass_options {
 	struct fx_render_texture_options tex_options;
 	struct fx_framebuffer *current_buffer;
+	// The backdrop already blurred by fx_render_pass_blur_backdrop. Drawn
+	// instead of blurring the backdrop again if set.
+	struct fx_framebuffer *blurred_buffer;
+	// Drawn instead of blurring the backdrop again if set, takes precedence
+	// over blurred_buffer
+	const struct fx_blur_cache *blur_cache;
 	struct blur_data *blur_data;
 	bool use_optimized_blur;
 	bool ignore_transparent;
@@ -144,6 +169,28 @@ void fx_render_pass_add_box_shadow(struct fx_gles_render_pass *pass,
 void fx_render_pass_add_blur(struct fx_gles_render_pass *pass,
 		struct fx_render_blur_pass_options *fx_options);
 
+/**
+ * Blurs the backdrop within the clip of the options once, so that several
+ * blurs over the same backdrop can be drawn by passing the result as their
+ * blurred_buffer. Returns NULL if there is nothing to blur.
+ */
+struct fx_framebuffer *fx_render_pass_blur_backdrop(struct fx_gles_render_pass *pass,
+		struct fx_render_blur_pass_options *fx_options);
+
+/**
+ * Copies the region of the blurred backdrop into the cache, reallocating it
+ * if box changed size. Returns false if the cache couldn't be filled.
+ */
+bool fx_render_pass_save_blur(struct fx_gles_render_pass *pass,
+		struct wlr_allocator *allocator, struct fx_blur_cache *cache,
+		const struct wlr_box *box, struct fx_framebuffer *blurred,
+		const pixman_region32_t *region);
+
+/**
+ * Releases the buffer of the cache.
+ */
+void fx_blur_cache_finish(struct fx_blur_cache *cache);
+
 /**
  * Render optimized blur.
  */
@@ -43,6 +43,7 @@ struct wlr_surface;
 struct wlr_scene_node;
 struct wlr_scene_buffer;
 struct wlr_scene_output_layout;
+struct scene_spatial_index;
 
 struct wlr_presentation;
 struct wlr_linux_dmabuf_v1;
@@ -85,9 +86,62 @@ struct wlr_scene_node {
 
 	struct {
 		pixman_region32_t visible;
+
+		// Opaque region of this node, relative to the node. Lazily rebuilt
+		// when opaque_dirty is set.
+		pixman_region32_t opaque;
+		bool opaque_dirty;
+
+		// The scene this node belongs to
+		struct wlr_scene *scene;
+
+		// Layout coordinates of this node and whether it and all of its
+		// ancestors are enabled, see wlr_scene_node_coords(). Lazily
+		// recomputed when coords_dirty is set.
+		int layout_x, layout_y;
+		bool layout_enabled;
+		bool coords_dirty;
+
+		// Box this node is stored with in the scene's spatial index, in
+		// layout coordinates. Only valid if indexed is set.
+		struct wlr_box index_box;
+		bool indexed;
+		// Set to the query mark of the spatial index if this node or one of
+		// its descendants is part of the current query result
+		uint32_t index_mark;
+
+		// Whether the node is part of the nodes of a pending or committing
+		// transaction, see wlr_scene_transaction_begin()
+		bool transaction_pending;
 	} WLR_PRIVATE;
 };
 
+/** Counters of the visibility updates of a scene */
+struct wlr_scene_visibility_stats {
+	// Totals since the scene was created
+	uint64_t updates;
+	uint64_t nodes_visited;
+	uint64_t nodes_changed;
+
+	// Nodes intersecting the region of the most recent update
+	uint32_t last_nodes_visited;
+	// Nodes whose visible region changed in the most recent update, only
+	// those had their outputs re-evaluated
+	uint32_t last_nodes_changed;
+};
+
+/** Counters of the node allocations of a scene */
+struct wlr_scene_allocation_stats {
+	// Nodes allocated from the heap
+	uint64_t node_allocs;
+	// Nodes created by reusing a previously destroyed node
+	uint64_t node_reuses;
+	// Nodes released to the heap
+	uint64_t node_frees;
+	// Destroyed nodes currently kept around for reuse
+	size_t node_pooled;
+};
+
 enum wlr_scene_debug_damage_option {
 	WLR_SCENE_DEBUG_DAMAGE_NONE,
 	WLR_SCENE_DEBUG_DAMAGE_RERENDER,
@@ -99,6 +153,13 @@ struct wlr_scene_tree {
 	struct wlr_scene_node node;
 
 	struct wl_list children; // wlr_scene_node.link
+
+	struct {
+		// Bounding box of all enabled descendants, relative to this tree.
+		// Lazily recomputed when bounds_dirty is set.
+		struct wlr_box bounds;
+		bool bounds_dirty;
+	} WLR_PRIVATE;
 };
 
 /** The root scene-graph node. */
@@ -125,6 +186,34 @@ struct wlr_scene {
 		bool calculate_visibility;
 		bool highlight_transparent_region;
 
+		// May be NULL if disabled
+		struct scene_spatial_index *spatial_index;
+
+		// Incremented whenever nodes are added, removed, moved, restacked,
+		// enabled or disabled. Render lists built for an older generation
+		// must be rebuilt from scratch.
+		uint64_t structure_generation;
+
+		struct wlr_scene_visibility_stats visibility_stats;
+
+		// Destroyed nodes kept for reuse, indexed by node type. Pooling is
+		// disabled if node_pool_max_size is 0.
+		size_t node_pool_max_size;
+		struct wl_list node_pools[WLR_SCENE_NODE_BLUR + 1]; // wlr_scene_node.link
+		size_t node_pool_sizes[WLR_SCENE_NODE_BLUR + 1];
+		struct wlr_scene_allocation_stats allocation_stats;
+
+		// See wlr_scene_transaction_begin()
+		int transaction_depth;
+		pixman_region32_t transaction_update_region;
+		// Visible regions of the updated nodes before the transaction
+		pixman_region32_t transaction_damage;
+		// Updated nodes, damaged with their visible region once the
+		// transaction is committed
+		struct wl_array transaction_nodes; // struct wlr_scene_node *
+		// Innermost transaction being committed, may be NULL
+		struct scene_transaction_commit *transaction_commit;
+
 		struct blur_data blur_data;
 	} WLR_PRIVATE;
 };
@@ -316,6 +405,28 @@ struct wlr_scene_output {
 		struct wl_list damage_highlight_regions;
 
 		struct wl_array render_list;
+		// The structure generation, output box and fractional scale state
+		// the render list was built for
+		uint64_t render_list_generation;
+		struct wlr_box render_list_box;
+		bool render_list_fractional_scale;
+		// Nodes whose render list membership needs to be re-evaluated
+		struct wl_array render_list_dirty; // struct wlr_scene_node *
+
+		// Blurred backdrops of blur nodes kept across frames
+		struct wl_list blur_caches; // scene_blur_cache.link
+		// Damage since the last render, with the buffer nodes it came from
+		struct wl_array blur_damage; // struct scene_blur_damage
+
+		// Regions rebuilt by every frame. They are kept across frames so
+		// that their storage is reused by frames like the previous one.
+		struct {
+			pixman_region32_t damage;
+			pixman_region32_t original_damage, blur_padding;
+			pixman_region32_t background[2];
+			pixman_region32_t visible, render_region;
+			pixman_region32_t node_opaque, opaque;
+		} scratch;
 
 		struct wlr_drm_syncobj_timeline *in_timeline;
 		uint64_t in_point;
@@ -457,6 +568,37 @@ void wlr_scene_set_gamma_control_manager_v1(struct wlr_scene *scene,
  */
 void wlr_scene_set_color_manager_v1(struct wlr_scene *scene, struct wlr_color_manager_v1 *manager);
 
+/**
+ * Get the visibility update counters of the scene.
+ */
+void wlr_scene_get_visibility_stats(struct wlr_scene *scene,
+	struct wlr_scene_visibility_stats *stats);
+
+/**
+ * Get the node allocation counters of the scene.
+ */
+void wlr_scene_get_allocation_stats(struct wlr_scene *scene,
+	struct wlr_scene_allocation_stats *stats);
+
+/**
+ * Start a transaction on the scene. Until the matching
+ * wlr_scene_transaction_commit(), visibility updates and output damage caused
+ * by changes to nodes (moving, resizing, restacking, enabling, ...) are
+ * accumulated instead of being applied immediately.
+ *
+ * Transactions can be nested, only the outermost commit applies the changes.
+ * The scene must not be rendered while a transaction is pending.
+ */
+void wlr_scene_transaction_begin(struct wlr_scene *scene);
+
+/**
+ * Commit a transaction started with wlr_scene_transaction_begin(), updating
+ * the visibility of all affected nodes in a single pass and damaging the
+ * outputs once, where the changed nodes were visible before the transaction
+ * and where they are visible after it.
+ */
+void wlr_scene_transaction_commit(struct wlr_scene *scene);
+
 /**
  * Add a node displaying nothing but its children.
  */
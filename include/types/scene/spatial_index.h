@@ -0,0 +1,57 @@
+#ifndef TYPES_SCENE_SPATIAL_INDEX_H
+#define TYPES_SCENE_SPATIAL_INDEX_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <wayland-util.h>
+#include <wlr/util/box.h>
+
+#include "scenefx/types/wlr_scene.h"
+
+#define SPATIAL_INDEX_BUCKETS 256
+
+/**
+ * A uniform grid over layout coordinates, holding the enabled leaf nodes of a
+ * scene. Grid cells are hashed into a fixed number of buckets. Nodes spanning
+ * too many cells (e.g. wallpapers) are kept in a separate list which is
+ * checked on every query instead.
+ *
+ * Each indexed node keeps the box it was inserted with in its index_box, so
+ * it can be removed again without knowing its previous geometry.
+ */
+struct scene_spatial_index {
+	struct wl_array buckets[SPATIAL_INDEX_BUCKETS]; // struct spatial_index_entry
+	struct wl_array large; // struct wlr_scene_node *
+
+	// Incremented for every query, see wlr_scene_node.index_mark
+	uint32_t query_mark;
+	// Set while the results of a query are being walked
+	bool querying;
+};
+
+typedef void (*spatial_index_iterator_func_t)(struct wlr_scene_node *node,
+	void *data);
+
+struct scene_spatial_index *spatial_index_create(void);
+
+void spatial_index_destroy(struct scene_spatial_index *index);
+
+/**
+ * Insert the node into the index, or move it if it was already indexed. An
+ * empty box removes the node from the index.
+ */
+void spatial_index_update(struct scene_spatial_index *index,
+	struct wlr_scene_node *node, const struct wlr_box *box);
+
+void spatial_index_remove(struct scene_spatial_index *index,
+	struct wlr_scene_node *node);
+
+/**
+ * Call the iterator for every indexed node intersecting the box. A node may
+ * be reported more than once and nodes are reported in no particular order.
+ */
+void spatial_index_query(struct scene_spatial_index *index,
+	const struct wlr_box *box, spatial_index_iterator_func_t iterator,
+	void *data);
+
+#endif
@@ -39,24 +39,27 @@ GLuint fx_framebuffer_get_fbo(struct fx_framebuffer *buffer) {
 	}
 
 	glGenFramebuffers(1, &buffer->fbo);
-	glBindFramebuffer(GL_FRAMEBUFFER, buffer->fbo);
+	fx_gl_bind_framebuffer(buffer->renderer, buffer->fbo);
 	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
 			GL_RENDERBUFFER, buffer->rbo);
 	GLenum fb_status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
 
 	// Init stencil buffer
-	glGenRenderbuffers(1, &buffer->sb);
-	glBindRenderbuffer(GL_RENDERBUFFER, buffer->sb);
-	glRenderbufferStorage(GL_RENDERBUFFER, GL_STENCIL_INDEX8,
-			buffer->buffer->width, buffer->buffer->height);
-	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_STENCIL_ATTACHMENT,
-			GL_RENDERBUFFER, buffer->sb);
-	fb_status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+	if (!buffer->no_stencil) {
+		glGenRenderbuffers(1, &buffer->sb);
+		glBindRenderbuffer(GL_RENDERBUFFER, buffer->sb);
+		glRenderbufferStorage(GL_RENDERBUFFER, GL_STENCIL_INDEX8,
+				buffer->buffer->width, buffer->buffer->height);
+		glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_STENCIL_ATTACHMENT,
+				GL_RENDERBUFFER, buffer->sb);
+		fb_status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+	}
 
-	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	fx_gl_bind_framebuffer(buffer->renderer, 0);
 
 	if (fb_status != GL_FRAMEBUFFER_COMPLETE) {
 		wlr_log(WLR_ERROR, "Failed to create FBO");
+		fx_gl_forget_framebuffer(buffer->renderer, buffer->fbo);
 		glDeleteFramebuffers(1, &buffer->fbo);
 		buffer->fbo = 0;
 	}
@@ -68,7 +71,7 @@ GLuint fx_framebuffer_get_fbo(struct fx_framebuffer *buffer) {
 
 void fx_framebuffer_get_or_create_custom(struct fx_renderer *renderer,
 		struct wlr_allocator *allocator, int width, int height, bool has_alpha,
-		struct fx_framebuffer **fx_framebuffer, bool *failed) {
+		bool stencil, struct fx_framebuffer **fx_framebuffer, bool *failed) {
 	if (*failed) {
 		return;
 	}
@@ -114,6 +117,7 @@ void fx_framebuffer_get_or_create_custom(struct fx_renderer *renderer,
 		*failed = true;
 		return;
 	}
+	(*fx_framebuffer)->no_stencil = !stencil;
 	fx_framebuffer_get_fbo(*fx_framebuffer);
 }
 
@@ -161,7 +165,7 @@ error_buffer:
 }
 
 void fx_framebuffer_bind(struct fx_framebuffer *fx_buffer) {
-	glBindFramebuffer(GL_FRAMEBUFFER, fx_framebuffer_get_fbo(fx_buffer));
+	fx_gl_bind_framebuffer(fx_buffer->renderer, fx_framebuffer_get_fbo(fx_buffer));
 }
 
 void fx_framebuffer_destroy(struct fx_framebuffer *fx_buffer) {
@@ -177,10 +181,12 @@ void fx_framebuffer_destroy(struct fx_framebuffer *fx_buffer) {
 	struct wlr_egl_context prev_ctx;
 	wlr_egl_make_current(fx_buffer->renderer->egl, &prev_ctx);
 
+	fx_gl_forget_framebuffer(fx_buffer->renderer, fx_buffer->fbo);
 	glDeleteFramebuffers(1, &fx_buffer->fbo);
 	fx_buffer->fbo = -1;
 	glDeleteRenderbuffers(1, &fx_buffer->rbo);
 	fx_buffer->rbo = -1;
+	fx_gl_forget_texture(fx_buffer->renderer, fx_buffer->tex);
 	glDeleteTextures(1, &fx_buffer->tex);
 	fx_buffer->tex = -1;
 	glDeleteRenderbuffers(1, &fx_buffer->sb);
@@ -0,0 +1,172 @@
+#include <string.h>
+
+#include "render/fx_renderer/fx_renderer.h"
+
+void fx_gl_state_invalidate(struct fx_gl_state *state) {
+	// No valid name or enum has all bits set
+	memset(state, 0xff, sizeof(*state));
+}
+
+static void skip(struct fx_renderer *renderer, uint64_t calls) {
+	renderer->stats.state_calls_skipped += calls;
+}
+
+void fx_gl_use_program(struct fx_renderer *renderer, GLuint program) {
+	struct fx_gl_state *state = &renderer->gl_state;
+	if (state->program == program) {
+		skip(renderer, 1);
+		return;
+	}
+	glUseProgram(program);
+	state->program = program;
+}
+
+void fx_gl_bind_framebuffer(struct fx_renderer *renderer, GLuint fbo) {
+	struct fx_gl_state *state = &renderer->gl_state;
+	if (state->framebuffer == fbo) {
+		skip(renderer, 1);
+		return;
+	}
+	glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+	state->framebuffer = fbo;
+}
+
+void fx_gl_set_blend(struct fx_renderer *renderer, bool enabled) {
+	struct fx_gl_state *state = &renderer->gl_state;
+	GLuint value = enabled ? GL_TRUE : GL_FALSE;
+	if (state->blend == value) {
+		skip(renderer, 1);
+		return;
+	}
+	if (enabled) {
+		glEnable(GL_BLEND);
+	} else {
+		glDisable(GL_BLEND);
+	}
+	state->blend = value;
+}
+
+void fx_gl_blend_func(struct fx_renderer *renderer, GLenum src, GLenum dst) {
+	struct fx_gl_state *state = &renderer->gl_state;
+	if (state->blend_src == src && state->blend_dst == dst) {
+		skip(renderer, 1);
+		return;
+	}
+	glBlendFunc(src, dst);
+	state->blend_src = src;
+	state->blend_dst = dst;
+}
+
+void fx_gl_set_stencil_test(struct fx_renderer *renderer, bool enabled) {
+	struct fx_gl_state *state = &renderer->gl_state;
+	GLuint value = enabled ? GL_TRUE : GL_FALSE;
+	if (state->stencil_test == value) {
+		skip(renderer, 1);
+		return;
+	}
+	if (enabled) {
+		glEnable(GL_STENCIL_TEST);
+	} else {
+		glDisable(GL_STENCIL_TEST);
+	}
+	state->stencil_test = value;
+}
+
+void fx_gl_stencil_func(struct fx_renderer *renderer, GLenum func, GLint ref,
+		GLuint mask) {
+	struct fx_gl_state *state = &renderer->gl_state;
+	if (state->stencil_func == func && state->stencil_ref == ref &&
+			state->stencil_mask == mask) {
+		skip(renderer, 1);
+		return;
+	}
+	glStencilFunc(func, ref, mask);
+	state->stencil_func = func;
+	state->stencil_ref = ref;
+	state->stencil_mask = mask;
+}
+
+void fx_gl_stencil_op(struct fx_renderer *renderer, GLenum fail, GLenum zfail,
+		GLenum zpass) {
+	struct fx_gl_state *state = &renderer->gl_state;
+	if (state->stencil_fail == fail && state->stencil_zfail == zfail &&
+			state->stencil_zpass == zpass) {
+		skip(renderer, 1);
+		return;
+	}
+	glStencilOp(fail, zfail, zpass);
+	state->stencil_fail = fail;
+	state->stencil_zfail = zfail;
+	state->stencil_zpass = zpass;
+}
+
+void fx_gl_active_texture(struct fx_renderer *renderer, GLenum unit) {
+	struct fx_gl_state *state = &renderer->gl_state;
+	if (state->active_texture == unit) {
+		skip(renderer, 1);
+		return;
+	}
+	glActiveTexture(unit);
+	state->active_texture = unit;
+}
+
+static GLuint *bound_texture(struct fx_gl_state *state, GLenum target) {
+	if (state->active_texture < GL_TEXTURE0 ||
+			state->active_texture >= GL_TEXTURE0 + FX_GL_STATE_TEXTURE_UNITS) {
+		return NULL;
+	}
+
+	GLuint *unit = state->textures[state->active_texture - GL_TEXTURE0];
+	switch (target) {
+	case GL_TEXTURE_2D:
+		return &unit[0];
+	case GL_TEXTURE_EXTERNAL_OES:
+		return &unit[1];
+	default:
+		return NULL;
+	}
+}
+
+void fx_gl_bind_texture(struct fx_renderer *renderer, GLenum target, GLuint tex) {
+	GLuint *bound = bound_texture(&renderer->gl_state, target);
+	if (bound != NULL && *bound == tex) {
+		skip(renderer, 1);
+		return;
+	}
+	glBindTexture(target, tex);
+	if (bound != NULL) {
+		*bound = tex;
+	}
+}
+
+void fx_gl_texture_filter(struct fx_renderer *renderer,
+		struct fx_texture *texture, GLint filter) {
+	// Textures imported from the same buffer share a single GL texture
+	GLint *current = texture->buffer != NULL ?
+		&texture->buffer->tex_filter : &texture->filter;
+	if (*current == filter) {
+		skip(renderer, 2);
+		return;
+	}
+	glTexParameteri(texture->target, GL_TEXTURE_MIN_FILTER, filter);
+	glTexParameteri(texture->target, GL_TEXTURE_MAG_FILTER, filter);
+	*current = filter;
+}
+
+void fx_gl_forget_texture(struct fx_renderer *renderer, GLuint tex) {
+	struct fx_gl_state *state = &renderer->gl_state;
+	for (size_t i = 0; i < FX_GL_STATE_TEXTURE_UNITS; i++) {
+		for (size_t j = 0; j < 2; j++) {
+			if (state->textures[i][j] == tex) {
+				state->textures[i][j] = 0;
+			}
+		}
+	}
+}
+
+void fx_gl_forget_framebuffer(struct fx_renderer *renderer, GLuint fbo) {
+	struct fx_gl_state *state = &renderer->gl_state;
+	if (state->framebuffer == fbo) {
+		state->framebuffer = 0;
+	}
+}
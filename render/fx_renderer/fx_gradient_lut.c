@@ -0,0 +1,159 @@
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <wlr/util/log.h>
+
+#include "render/fx_renderer/fx_renderer.h"
+#include "scenefx/render/pass.h"
+
+static uint64_t gradient_hash(const struct fx_gradient *gradient) {
+	// FNV-1a over everything which ends up in the texture
+	uint64_t hash = 0xcbf29ce484222325ULL;
+	const int values[] = { gradient->count, gradient->blend != 0 };
+	const unsigned char *bytes = (const unsigned char *)values;
+	for (size_t i = 0; i < sizeof(values); i++) {
+		hash = (hash ^ bytes[i]) * 0x100000001b3ULL;
+	}
+	bytes = (const unsigned char *)gradient->colors;
+	for (size_t i = 0; i < (size_t)gradient->count * 4 * sizeof(float); i++) {
+		hash = (hash ^ bytes[i]) * 0x100000001b3ULL;
+	}
+	return hash;
+}
+
+static bool gradient_lut_matches(const struct fx_gradient_lut *lut,
+		const struct fx_gradient *gradient, uint64_t hash) {
+	return lut->hash == hash && lut->count == gradient->count &&
+		lut->blend == (gradient->blend != 0) &&
+		memcmp(lut->colors, gradient->colors,
+			(size_t)gradient->count * 4 * sizeof(float)) == 0;
+}
+
+static float smoothstep(float edge0, float edge1, float x) {
+	float t = fminf(fmaxf((x - edge0) / (edge1 - edge0), 0.0f), 1.0f);
+	return t * t * (3.0f - 2.0f * t);
+}
+
+static void mix_color(float out[static 4], const float a[static 4],
+		const float b[static 4], float t) {
+	for (int i = 0; i < 4; i++) {
+		out[i] = a[i] + (b[i] - a[i]) * t;
+	}
+}
+
+// Matches what gradient.frag used to evaluate per fragment
+static void gradient_sample(const struct fx_gradient *gradient, float step,
+		float out[static 4]) {
+	int count = gradient->count;
+	const float *colors = gradient->colors;
+
+	if (!gradient->blend || count == 1) {
+		int ind = (int)(step * count);
+		ind = ind < 0 ? 0 : ind >= count ? count - 1 : ind;
+		memcpy(out, &colors[ind * 4], 4 * sizeof(float));
+		return;
+	}
+
+	float smooth_fac = 1.0f / (count - 1);
+	int ind = (int)(step / smooth_fac);
+	ind = ind < 0 ? 0 : ind >= count ? count - 1 : ind;
+	float at = ind * smooth_fac;
+
+	float color[4];
+	memcpy(color, &colors[ind * 4], sizeof(color));
+	if (ind > 0) {
+		mix_color(color, &colors[(ind - 1) * 4], color,
+			smoothstep(at - smooth_fac, at, step));
+	}
+	if (ind < count - 1) {
+		mix_color(color, color, &colors[(ind + 1) * 4],
+			smoothstep(at, at + smooth_fac, step));
+	}
+	memcpy(out, color, sizeof(color));
+}
+
+static void gradient_lut_upload(struct fx_renderer *renderer,
+		struct fx_gradient_lut *lut, const struct fx_gradient *gradient) {
+	unsigned char data[FX_GRADIENT_LUT_WIDTH * 4];
+	for (int i = 0; i < FX_GRADIENT_LUT_WIDTH; i++) {
+		float step = (i + 0.5f) / FX_GRADIENT_LUT_WIDTH;
+		float color[4];
+		gradient_sample(gradient, step, color);
+		for (int c = 0; c < 4; c++) {
+			data[i * 4 + c] = (unsigned char)roundf(
+				fminf(fmaxf(color[c], 0.0f), 1.0f) * 255.0f);
+		}
+	}
+
+	// Hard color stops must not be filtered into each other
+	GLint filter = gradient->blend ? GL_LINEAR : GL_NEAREST;
+
+	fx_gl_bind_texture(renderer, GL_TEXTURE_2D, lut->tex);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, filter);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, filter);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, FX_GRADIENT_LUT_WIDTH, 1, 0,
+		GL_RGBA, GL_UNSIGNED_BYTE, data);
+}
+
+GLuint fx_gradient_lut_get(struct fx_renderer *renderer,
+		const struct fx_gradient *gradient) {
+	if (gradient->count <= 0 || gradient->colors == NULL) {
+		return 0;
+	}
+
+	struct fx_gradient_luts *luts = &renderer->gradient_luts;
+	uint64_t hash = gradient_hash(gradient);
+	luts->clock++;
+
+	struct fx_gradient_lut *oldest = &luts->entries[0];
+	for (size_t i = 0; i < FX_GRADIENT_LUT_CACHE_SIZE; i++) {
+		struct fx_gradient_lut *lut = &luts->entries[i];
+		if (lut->tex != 0 && gradient_lut_matches(lut, gradient, hash)) {
+			lut->last_used = luts->clock;
+			return lut->tex;
+		}
+		if (lut->tex == 0 || (oldest->tex != 0 && lut->last_used < oldest->last_used)) {
+			oldest = lut;
+		}
+	}
+
+	// Reuse the least recently used entry, or take an empty one
+	size_t colors_size = (size_t)gradient->count * 4 * sizeof(float);
+	if (oldest->count != gradient->count) {
+		float *colors = realloc(oldest->colors, colors_size);
+		if (colors == NULL) {
+			wlr_log(WLR_ERROR, "Failed to allocate gradient colors");
+			return 0;
+		}
+		oldest->colors = colors;
+		oldest->count = gradient->count;
+	}
+	memcpy(oldest->colors, gradient->colors, colors_size);
+	oldest->blend = gradient->blend != 0;
+	if (oldest->tex == 0) {
+		glGenTextures(1, &oldest->tex);
+		if (oldest->tex == 0) {
+			wlr_log(WLR_ERROR, "Failed to create gradient texture");
+			return 0;
+		}
+	}
+	oldest->hash = hash;
+	oldest->last_used = luts->clock;
+	gradient_lut_upload(renderer, oldest, gradient);
+
+	return oldest->tex;
+}
+
+void fx_gradient_luts_finish(struct fx_renderer *renderer) {
+	struct fx_gradient_luts *luts = &renderer->gradient_luts;
+	for (size_t i = 0; i < FX_GRADIENT_LUT_CACHE_SIZE; i++) {
+		if (luts->entries[i].tex != 0) {
+			fx_gl_forget_texture(renderer, luts->entries[i].tex);
+			glDeleteTextures(1, &luts->entries[i].tex);
+		}
+		free(luts->entries[i].colors);
+	}
+	*luts = (struct fx_gradient_luts){0};
+}
@@ -7,9 +7,48 @@
 #include "scenefx/render/fx_renderer/fx_renderer.h"
 #include "scenefx/render/fx_renderer/fx_offscreen_buffers.h"
 
+static void texture_finish(struct wlr_texture **texture) {
+	if (*texture != NULL) {
+		wlr_texture_destroy(*texture);
+		*texture = NULL;
+	}
+}
+
+static bool texture_update(struct wlr_texture **texture,
+		struct fx_framebuffer *buffer) {
+	if (buffer == NULL) {
+		texture_finish(texture);
+		return true;
+	}
+	// The texture keeps its buffer alive, so a texture of a since replaced
+	// buffer never matches the new one
+	if (*texture != NULL && fx_get_texture(*texture)->buffer == buffer) {
+		return true;
+	}
+
+	texture_finish(texture);
+	*texture = fx_texture_from_buffer(&buffer->renderer->wlr_renderer,
+		buffer->buffer);
+	if (*texture == NULL) {
+		wlr_log(WLR_ERROR, "Failed to import offscreen buffer");
+		return false;
+	}
+	return true;
+}
+
 static void addon_handle_destroy(struct wlr_addon *addon) {
 	struct fx_offscreen_buffers *fbos = wl_container_of(addon, fbos, addon);
 
+	// The textures lock their buffers, so they have to go first
+	texture_finish(&fbos->optimized_blur_texture);
+	texture_finish(&fbos->optimized_no_blur_texture);
+	texture_finish(&fbos->blur_saved_pixels_texture);
+	texture_finish(&fbos->effects_texture);
+	for (int i = 0; i < FX_OFFSCREEN_BLUR_LEVELS; i++) {
+		texture_finish(&fbos->blur_level_textures[i]);
+		texture_finish(&fbos->optimized_blur_level_textures[i]);
+	}
+
 	// Make sure to free the buffers
 	if (fbos->optimized_blur_buffer != NULL) {
 		wlr_buffer_drop(fbos->optimized_blur_buffer->buffer);
@@ -27,9 +66,15 @@ static void addon_handle_destroy(struct wlr_addon *addon) {
 		wlr_buffer_drop(fbos->effects_buffer->buffer);
 		fbos->effects_buffer = NULL;
 	}
-	if (fbos->effects_buffer_swapped != NULL) {
-		wlr_buffer_drop(fbos->effects_buffer_swapped->buffer);
-		fbos->effects_buffer_swapped = NULL;
+	for (int i = 0; i < FX_OFFSCREEN_BLUR_LEVELS; i++) {
+		if (fbos->blur_levels[i] != NULL) {
+			wlr_buffer_drop(fbos->blur_levels[i]->buffer);
+			fbos->blur_levels[i] = NULL;
+		}
+		if (fbos->optimized_blur_levels[i] != NULL) {
+			wlr_buffer_drop(fbos->optimized_blur_levels[i]->buffer);
+			fbos->optimized_blur_levels[i] = NULL;
+		}
 	}
 
 	wl_list_remove(&fbos->link);
@@ -48,6 +93,46 @@ static bool fx_offscreen_buffers_assign(struct wlr_output *output,
 	return true;
 }
 
+bool fx_offscreen_buffers_update_textures(struct fx_offscreen_buffers *fbos) {
+	bool ok = texture_update(&fbos->optimized_blur_texture,
+		fbos->optimized_blur_buffer);
+	ok = texture_update(&fbos->optimized_no_blur_texture,
+		fbos->optimized_no_blur_buffer) && ok;
+	ok = texture_update(&fbos->blur_saved_pixels_texture,
+		fbos->blur_saved_pixels_buffer) && ok;
+	ok = texture_update(&fbos->effects_texture, fbos->effects_buffer) && ok;
+	for (int i = 0; i < FX_OFFSCREEN_BLUR_LEVELS; i++) {
+		ok = texture_update(&fbos->blur_level_textures[i],
+			fbos->blur_levels[i]) && ok;
+		ok = texture_update(&fbos->optimized_blur_level_textures[i],
+			fbos->optimized_blur_levels[i]) && ok;
+	}
+	return ok;
+}
+
+struct wlr_texture *fx_offscreen_buffers_get_texture(
+		struct fx_offscreen_buffers *fbos, struct fx_framebuffer *buffer) {
+	if (buffer == NULL) {
+		return NULL;
+	} else if (buffer == fbos->optimized_blur_buffer) {
+		return fbos->optimized_blur_texture;
+	} else if (buffer == fbos->optimized_no_blur_buffer) {
+		return fbos->optimized_no_blur_texture;
+	} else if (buffer == fbos->blur_saved_pixels_buffer) {
+		return fbos->blur_saved_pixels_texture;
+	} else if (buffer == fbos->effects_buffer) {
+		return fbos->effects_texture;
+	}
+	for (int i = 0; i < FX_OFFSCREEN_BLUR_LEVELS; i++) {
+		if (buffer == fbos->blur_levels[i]) {
+			return fbos->blur_level_textures[i];
+		} else if (buffer == fbos->optimized_blur_levels[i]) {
+			return fbos->optimized_blur_level_textures[i];
+		}
+	}
+	return NULL;
+}
+
 void fx_offscreen_buffers_destroy(struct fx_offscreen_buffers *fbos) {
 	addon_handle_destroy(&fbos->addon);
 }
@@ -87,6 +172,7 @@ create_new:;
 		free(fbos);
 		return NULL;
 	}
+	fbos->output = output;
 	wl_list_insert(&renderer->offscreen_buffers, &fbos->link);
 	return fbos;
 }
@@ -21,7 +21,10 @@
 #include "scenefx/types/fx/blur_data.h"
 #include "util/matrix.h"
 
-#define MAX_QUADS 86 // 4kb
+// M_PI is an XSI extension, not available with _POSIX_C_SOURCE
+#define DEG_TO_RAD (3.14159265358979323846 / 180.0)
+
+static void batch_flush(struct fx_renderer *renderer);
 
 struct fx_render_texture_options fx_render_texture_options_default(
 		const struct wlr_render_texture_options *base) {
@@ -47,6 +50,25 @@ struct fx_render_rect_options fx_render_rect_options_default(
 	return options;
 }
 
+// Creates one of the output sized offscreen buffers, or resizes it to the
+// output. They're only drawn to with the stencil test disabled, so they go
+// without a stencil attachment.
+static bool offscreen_buffer_ensure(struct fx_gles_render_pass *pass,
+		struct fx_framebuffer **buffer, bool has_alpha) {
+	struct fx_offscreen_buffers *fbos = pass->fx_offscreen_buffers;
+	bool failed = false;
+	fx_framebuffer_get_or_create_custom(pass->buffer->renderer,
+			fbos->output->allocator, pass->buffer->buffer->width,
+			pass->buffer->buffer->height, has_alpha, false, buffer, &failed);
+	if (!failed && !fx_offscreen_buffers_update_textures(fbos)) {
+		failed = true;
+	}
+
+	// Bind back to the default buffer
+	fx_framebuffer_bind(pass->buffer);
+	return !failed;
+}
+
 bool fx_render_pass_init_offscreen_buffers(struct wlr_render_pass *render_pass,
 		struct wlr_output *output) {
 	struct fx_gles_render_pass *pass = fx_get_render_pass(render_pass);
@@ -67,24 +89,21 @@ bool fx_render_pass_init_offscreen_buffers(struct wlr_render_pass *render_pass,
 		return false;
 	}
 
-	// Update the buffers if needed
-	struct fx_renderer *renderer = pass->buffer->renderer;
-	const int width = pass->buffer->buffer->width;
-	const int height = pass->buffer->buffer->height;
-	bool failed = false;
-	fx_framebuffer_get_or_create_custom(renderer, output->allocator, width, height, false,
-			&pass->fx_offscreen_buffers->blur_saved_pixels_buffer, &failed);
-	fx_framebuffer_get_or_create_custom(renderer, output->allocator, width, height, true,
-			&pass->fx_offscreen_buffers->effects_buffer, &failed);
-	fx_framebuffer_get_or_create_custom(renderer, output->allocator, width, height, true,
-			&pass->fx_offscreen_buffers->effects_buffer_swapped, &failed);
-	fx_framebuffer_get_or_create_custom(renderer, output->allocator, width, height, false,
-			&pass->fx_offscreen_buffers->optimized_blur_buffer, &failed);
-	fx_framebuffer_get_or_create_custom(renderer, output->allocator, width, height, false,
-			&pass->fx_offscreen_buffers->optimized_no_blur_buffer, &failed);
-
-	// Bind back to the default buffer
-	fx_framebuffer_bind(pass->buffer);
+	// Update the buffers if needed. The effects and optimized blur buffers
+	// are only created once a blur draws into them, see
+	// offscreen_buffer_ensure, but follow the size of the output from then on.
+	struct fx_offscreen_buffers *fbos = pass->fx_offscreen_buffers;
+	batch_flush(pass->buffer->renderer);
+	bool failed = !offscreen_buffer_ensure(pass, &fbos->blur_saved_pixels_buffer, false);
+	if (!failed && fbos->effects_buffer != NULL) {
+		failed = !offscreen_buffer_ensure(pass, &fbos->effects_buffer, true);
+	}
+	if (!failed && fbos->optimized_blur_buffer != NULL) {
+		failed = !offscreen_buffer_ensure(pass, &fbos->optimized_blur_buffer, false);
+	}
+	if (!failed && fbos->optimized_no_blur_buffer != NULL) {
+		failed = !offscreen_buffer_ensure(pass, &fbos->optimized_no_blur_buffer, false);
+	}
 
 	if (failed) {
 		fx_offscreen_buffers_destroy(pass->fx_offscreen_buffers);
@@ -116,6 +135,16 @@ static bool render_pass_submit(struct wlr_render_pass *wlr_pass) {
 	TRACY_BOTH_ZONES_START(pass->buffer->renderer);
 	push_fx_debug(renderer);
 
+	batch_flush(renderer);
+	renderer->stats.last_pass_draw_calls =
+		renderer->stats.draw_calls - pass->draw_calls_start;
+	renderer->stats.last_pass_state_calls_skipped =
+		renderer->stats.state_calls_skipped - pass->state_calls_skipped_start;
+	renderer->stats.last_pass_uniform_calls_skipped =
+		renderer->stats.uniform_calls_skipped - pass->uniform_calls_skipped_start;
+	renderer->stats.last_pass_textures_created =
+		renderer->stats.textures_created - pass->textures_created_start;
+
 	if (timer) {
 		// clear disjoint flag
 		GLint64 disjoint;
@@ -152,7 +181,7 @@ static bool render_pass_submit(struct wlr_render_pass *wlr_pass) {
 	ok = true;
 
 out:
-	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	fx_gl_bind_framebuffer(renderer, 0);
 
 	pop_fx_debug(renderer);
 	TRACY_BOTH_ZONES_END;
@@ -204,97 +233,143 @@ static const struct wlr_render_pass_impl render_pass_impl = {
 // TODO: REMOVE STENCILING
 
 // Initialize the stenciling work
-static void stencil_mask_init(void) {
+static void stencil_mask_init(struct fx_renderer *renderer) {
 	glClearStencil(0);
 	glClear(GL_STENCIL_BUFFER_BIT);
-	glEnable(GL_STENCIL_TEST);
+	fx_gl_set_stencil_test(renderer, true);
 
-	glStencilFunc(GL_ALWAYS, 1, 0xFF);
-	glStencilOp(GL_KEEP, GL_KEEP, GL_REPLACE);
+	fx_gl_stencil_func(renderer, GL_ALWAYS, 1, 0xFF);
+	fx_gl_stencil_op(renderer, GL_KEEP, GL_KEEP, GL_REPLACE);
 	// Disable writing to color buffer
 	glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
 }
 
 // Close the mask
-static void stencil_mask_close(bool draw_inside_mask) {
+static void stencil_mask_close(struct fx_renderer *renderer, bool draw_inside_mask) {
 	// Reenable writing to color buffer
 	glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
 	if (draw_inside_mask) {
-		glStencilFunc(GL_EQUAL, 1, 0xFF);
-		glStencilOp(GL_KEEP, GL_KEEP, GL_REPLACE);
+		fx_gl_stencil_func(renderer, GL_EQUAL, 1, 0xFF);
+		fx_gl_stencil_op(renderer, GL_KEEP, GL_KEEP, GL_REPLACE);
 		return;
 	}
-	glStencilFunc(GL_NOTEQUAL, 1, 0xFF);
-	glStencilOp(GL_KEEP, GL_KEEP, GL_KEEP);
+	fx_gl_stencil_func(renderer, GL_NOTEQUAL, 1, 0xFF);
+	fx_gl_stencil_op(renderer, GL_KEEP, GL_KEEP, GL_KEEP);
 }
 
 // Finish stenciling and clear the buffer
-static void stencil_mask_fini(void) {
+static void stencil_mask_fini(struct fx_renderer *renderer) {
 	glClearStencil(0);
 	glClear(GL_STENCIL_BUFFER_BIT);
-	glDisable(GL_STENCIL_TEST);
+	fx_gl_set_stencil_test(renderer, false);
 }
 
-static void render(const struct wlr_box *box, const pixman_region32_t *clip, GLint attrib) {
-	pixman_region32_t region;
-	pixman_region32_init_rect(&region, box->x, box->y, box->width, box->height);
+/**
+ * Returns the rects of the clip, or the box itself without a clip. Drawing
+ * code clips these to the box one by one with box_clip_rect() instead of
+ * intersecting the clip into a region of its own, which would allocate for
+ * every clip made of more than one rect.
+ */
+static const pixman_box32_t *box_clip_rects(const struct wlr_box *box,
+		const pixman_region32_t *clip, pixman_box32_t *box_rect, int *rects_len) {
+	if (clip == NULL) {
+		*box_rect = (pixman_box32_t){
+			.x1 = box->x,
+			.y1 = box->y,
+			.x2 = box->x + box->width,
+			.y2 = box->y + box->height,
+		};
+		*rects_len = 1;
+		return box_rect;
+	}
+	return pixman_region32_rectangles(clip, rects_len);
+}
 
-	if (clip) {
-		pixman_region32_intersect(&region, &region, clip);
+static bool box_clip_rect(const struct wlr_box *box, const pixman_box32_t *clip_rect,
+		pixman_box32_t *rect) {
+	rect->x1 = clip_rect->x1 > box->x ? clip_rect->x1 : box->x;
+	rect->y1 = clip_rect->y1 > box->y ? clip_rect->y1 : box->y;
+	rect->x2 = clip_rect->x2 < box->x + box->width ? clip_rect->x2 : box->x + box->width;
+	rect->y2 = clip_rect->y2 < box->y + box->height ? clip_rect->y2 : box->y + box->height;
+	return rect->x1 < rect->x2 && rect->y1 < rect->y2;
+}
+
+static int box_clip_rects_count(const struct wlr_box *box,
+		const pixman_box32_t *clip_rects, int clip_rects_len) {
+	int rects_len = 0;
+	pixman_box32_t rect;
+	for (int i = 0; i < clip_rects_len; i++) {
+		if (box_clip_rect(box, &clip_rects[i], &rect)) {
+			rects_len++;
+		}
 	}
+	return rects_len;
+}
 
-	int rects_len;
-	const pixman_box32_t *rects = pixman_region32_rectangles(&region, &rects_len);
+static void render(struct fx_renderer *renderer, const struct wlr_box *box,
+		const pixman_region32_t *clip, GLint attrib) {
+	pixman_box32_t box_rect;
+	int clip_rects_len;
+	const pixman_box32_t *clip_rects =
+		box_clip_rects(box, clip, &box_rect, &clip_rects_len);
+	int rects_len = box_clip_rects_count(box, clip_rects, clip_rects_len);
 	if (rects_len == 0) {
-		pixman_region32_fini(&region);
 		return;
 	}
 
-	glEnableVertexAttribArray(attrib);
+	struct fx_vertex_ring *ring = &renderer->vertex_ring;
+	GLfloat *verts = fx_vertex_ring_reserve(ring, (size_t)rects_len * 6 * 2);
+	if (verts == NULL) {
+		return;
+	}
 
-	for (int i = 0; i < rects_len;) {
-		int batch = rects_len - i < MAX_QUADS ? rects_len - i : MAX_QUADS;
-		int batch_end = batch + i;
-
-		size_t vert_index = 0;
-		GLfloat verts[MAX_QUADS * 6 * 2];
-		for (; i < batch_end; i++) {
-			const pixman_box32_t *rect = &rects[i];
-
-			verts[vert_index++] = (GLfloat)(rect->x1 - box->x) / box->width;
-			verts[vert_index++] = (GLfloat)(rect->y1 - box->y) / box->height;
-			verts[vert_index++] = (GLfloat)(rect->x2 - box->x) / box->width;
-			verts[vert_index++] = (GLfloat)(rect->y1 - box->y) / box->height;
-			verts[vert_index++] = (GLfloat)(rect->x1 - box->x) / box->width;
-			verts[vert_index++] = (GLfloat)(rect->y2 - box->y) / box->height;
-			verts[vert_index++] = (GLfloat)(rect->x2 - box->x) / box->width;
-			verts[vert_index++] = (GLfloat)(rect->y1 - box->y) / box->height;
-			verts[vert_index++] = (GLfloat)(rect->x2 - box->x) / box->width;
-			verts[vert_index++] = (GLfloat)(rect->y2 - box->y) / box->height;
-			verts[vert_index++] = (GLfloat)(rect->x1 - box->x) / box->width;
-			verts[vert_index++] = (GLfloat)(rect->y2 - box->y) / box->height;
+	size_t vert_index = 0;
+	for (int i = 0; i < clip_rects_len; i++) {
+		pixman_box32_t rect;
+		if (!box_clip_rect(box, &clip_rects[i], &rect)) {
+			continue;
 		}
 
-		glVertexAttribPointer(attrib, 2, GL_FLOAT, GL_FALSE, 0, verts);
-		glDrawArrays(GL_TRIANGLES, 0, batch * 6);
+		verts[vert_index++] = (GLfloat)(rect.x1 - box->x) / box->width;
+		verts[vert_index++] = (GLfloat)(rect.y1 - box->y) / box->height;
+		verts[vert_index++] = (GLfloat)(rect.x2 - box->x) / box->width;
+		verts[vert_index++] = (GLfloat)(rect.y1 - box->y) / box->height;
+		verts[vert_index++] = (GLfloat)(rect.x1 - box->x) / box->width;
+		verts[vert_index++] = (GLfloat)(rect.y2 - box->y) / box->height;
+		verts[vert_index++] = (GLfloat)(rect.x2 - box->x) / box->width;
+		verts[vert_index++] = (GLfloat)(rect.y1 - box->y) / box->height;
+		verts[vert_index++] = (GLfloat)(rect.x2 - box->x) / box->width;
+		verts[vert_index++] = (GLfloat)(rect.y2 - box->y) / box->height;
+		verts[vert_index++] = (GLfloat)(rect.x1 - box->x) / box->width;
+		verts[vert_index++] = (GLfloat)(rect.y2 - box->y) / box->height;
 	}
 
+	// All rects of the region go out with a single draw call
+	GLintptr offset = fx_vertex_ring_upload(ring);
+
+	glEnableVertexAttribArray(attrib);
+	glVertexAttribPointer(attrib, 2, GL_FLOAT, GL_FALSE, 0, (const void *)offset);
+	glDrawArrays(GL_TRIANGLES, 0, rects_len * 6);
 	glDisableVertexAttribArray(attrib);
+	renderer->stats.draw_calls++;
 
-	pixman_region32_fini(&region);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
 }
 
-static void set_proj_matrix(GLint loc, float proj[9], const struct wlr_box *box) {
+static void set_proj_matrix(struct fx_renderer *renderer,
+		struct shader_uniform_cache *cache, GLint loc, float proj[9],
+		const struct wlr_box *box) {
 	float gl_matrix[9];
 	wlr_matrix_identity(gl_matrix);
 	wlr_matrix_translate(gl_matrix, box->x, box->y);
 	wlr_matrix_scale(gl_matrix, box->width, box->height);
 	wlr_matrix_multiply(gl_matrix, proj, gl_matrix);
-	glUniformMatrix3fv(loc, 1, GL_FALSE, gl_matrix);
+	uniform_matrix3_set(renderer, cache, loc, gl_matrix);
 }
 
-static void set_tex_matrix(GLint loc, enum wl_output_transform trans,
-		const struct wlr_fbox *box) {
+static void set_tex_matrix(struct fx_renderer *renderer,
+		struct shader_uniform_cache *cache, GLint loc,
+		enum wl_output_transform trans, const struct wlr_fbox *box) {
 	float tex_matrix[9];
 	wlr_matrix_identity(tex_matrix);
 	wlr_matrix_translate(tex_matrix, box->x, box->y);
@@ -310,20 +385,295 @@ static void set_tex_matrix(GLint loc, enum wl_output_transform trans,
 	}
 	wlr_matrix_translate(tex_matrix, -.5, -.5);
 
-	glUniformMatrix3fv(loc, 1, GL_FALSE, tex_matrix);
+	uniform_matrix3_set(renderer, cache, loc, tex_matrix);
 }
 
-static void setup_blending(enum wlr_render_blend_mode mode) {
+static void setup_blending(struct fx_renderer *renderer,
+		enum wlr_render_blend_mode mode) {
 	switch (mode) {
 	case WLR_RENDER_BLEND_MODE_PREMULTIPLIED:
-		glEnable(GL_BLEND);
+		fx_gl_set_blend(renderer, true);
 		break;
 	case WLR_RENDER_BLEND_MODE_NONE:
-		glDisable(GL_BLEND);
+		fx_gl_set_blend(renderer, false);
 		break;
 	}
 }
 
+/**
+ * Parameters of a single instance of an instanced program, see
+ * instanced.vert. One instance is added per rect of the clip region.
+ */
+struct fx_batch_instance {
+	GLfloat draw_box[4]; // x1, y1, x2, y2
+	GLfloat color[4];
+	GLfloat box[4]; // x, y, width, height
+	GLfloat radius[4]; // top left, top right, bottom left, bottom right
+	GLfloat clip_box[4]; // x, y, width, height
+	GLfloat clip_radius[4]; // top left, top right, bottom left, bottom right
+};
+
+// Drawn once per instance, in front of the instances in the vertex buffer
+static const GLfloat batch_unit_quad[] = {
+	0, 0,
+	1, 0,
+	0, 1,
+	1, 0,
+	1, 1,
+	0, 1,
+};
+
+static void batch_draw_rects(struct fx_renderer *renderer,
+		struct fx_gles_render_pass *pass, GLintptr offset, GLsizei count) {
+	struct quad_batch_shader *shader = &renderer->shaders.quad_batch;
+	fx_gl_use_program(renderer, shader->program);
+	// Vertices are already in buffer coordinates
+	set_proj_matrix(renderer, &shader->uniforms, shader->proj, pass->projection_matrix,
+		&(struct wlr_box){ .width = 1, .height = 1 });
+
+	GLsizei stride = 6 * sizeof(GLfloat);
+	glEnableVertexAttribArray(shader->pos_attrib);
+	glEnableVertexAttribArray(shader->color_attrib);
+	glVertexAttribPointer(shader->pos_attrib, 2, GL_FLOAT, GL_FALSE, stride,
+		(void *)offset);
+	glVertexAttribPointer(shader->color_attrib, 4, GL_FLOAT, GL_FALSE, stride,
+		(void *)(offset + 2 * sizeof(GLfloat)));
+	glDrawArrays(GL_TRIANGLES, 0, count);
+	glDisableVertexAttribArray(shader->color_attrib);
+	glDisableVertexAttribArray(shader->pos_attrib);
+}
+
+static void batch_draw_instances(struct fx_renderer *renderer,
+		struct fx_gles_render_pass *pass, struct instanced_shader *shader,
+		GLintptr offset, GLsizei count) {
+	fx_gl_use_program(renderer, shader->program);
+	set_proj_matrix(renderer, &shader->uniforms, shader->proj, pass->projection_matrix,
+		&(struct wlr_box){ .width = 1, .height = 1 });
+
+	glEnableVertexAttribArray(shader->pos_attrib);
+	glVertexAttribPointer(shader->pos_attrib, 2, GL_FLOAT, GL_FALSE, 0,
+		(void *)offset);
+
+	// Same order as the members of struct fx_batch_instance
+	const GLint attribs[] = {
+		shader->draw_box_attrib,
+		shader->color_attrib,
+		shader->box_attrib,
+		shader->radius_attrib,
+		shader->clip_box_attrib,
+		shader->clip_radius_attrib,
+	};
+	const size_t attribs_len = sizeof(attribs) / sizeof(attribs[0]);
+
+	GLintptr instances = offset + sizeof(batch_unit_quad);
+	for (size_t i = 0; i < attribs_len; i++) {
+		// Attributes unused by the fragment shader may be optimized out
+		if (attribs[i] < 0) {
+			continue;
+		}
+		glEnableVertexAttribArray(attribs[i]);
+		glVertexAttribPointer(attribs[i], 4, GL_FLOAT, GL_FALSE,
+			sizeof(struct fx_batch_instance),
+			(void *)(instances + i * 4 * sizeof(GLfloat)));
+		renderer->procs.glVertexAttribDivisor(attribs[i], 1);
+	}
+
+	renderer->procs.glDrawArraysInstanced(GL_TRIANGLES, 0, 6, count);
+
+	for (size_t i = 0; i < attribs_len; i++) {
+		if (attribs[i] < 0) {
+			continue;
+		}
+		// The divisor is attribute state, don't leak it into other draws
+		renderer->procs.glVertexAttribDivisor(attribs[i], 0);
+		glDisableVertexAttribArray(attribs[i]);
+	}
+	glDisableVertexAttribArray(shader->pos_attrib);
+}
+
+/**
+ * Draws the pending batch of the renderer, if any. Must be called before
+ * anything else gets drawn or the bound framebuffer changes.
+ */
+static void batch_flush(struct fx_renderer *renderer) {
+	struct fx_gles_render_pass *pass = renderer->batch.pass;
+	if (pass == NULL) {
+		return;
+	}
+	renderer->batch.pass = NULL;
+
+	struct wl_array *data = &renderer->batch.data;
+	if (data->size == 0) {
+		return;
+	}
+
+	const bool instanced = renderer->batch.type != FX_BATCH_RECTS;
+	size_t prefix_len = instanced ?
+		sizeof(batch_unit_quad) / sizeof(batch_unit_quad[0]) : 0;
+	GLfloat *verts = fx_vertex_ring_reserve(&renderer->vertex_ring,
+		prefix_len + data->size / sizeof(GLfloat));
+	if (verts == NULL) {
+		data->size = 0;
+		return;
+	}
+	memcpy(verts, batch_unit_quad, prefix_len * sizeof(GLfloat));
+	memcpy(verts + prefix_len, data->data, data->size);
+	size_t size = data->size;
+	data->size = 0;
+
+	TRACY_BOTH_ZONES_START(renderer);
+	TRACY_ZONE_TEXT_f("Batch Type: %d", renderer->batch.type);
+	push_fx_debug(renderer);
+
+	GLintptr offset = fx_vertex_ring_upload(&renderer->vertex_ring);
+	switch (renderer->batch.type) {
+	case FX_BATCH_RECTS:
+		setup_blending(renderer, renderer->batch.blend_mode);
+		batch_draw_rects(renderer, pass, offset, size / (6 * sizeof(GLfloat)));
+		break;
+	case FX_BATCH_ROUNDED_RECTS:
+		setup_blending(renderer, WLR_RENDER_BLEND_MODE_PREMULTIPLIED);
+		batch_draw_instances(renderer, pass, &renderer->shaders.quad_round_instanced,
+			offset, size / sizeof(struct fx_batch_instance));
+		break;
+	case FX_BATCH_BOX_SHADOWS:
+		setup_blending(renderer, WLR_RENDER_BLEND_MODE_PREMULTIPLIED);
+		fx_gl_blend_func(renderer, GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+		batch_draw_instances(renderer, pass, &renderer->shaders.box_shadow_instanced,
+			offset, size / sizeof(struct fx_batch_instance));
+		fx_gl_blend_func(renderer, GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+		break;
+	}
+	renderer->stats.draw_calls++;
+
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	pop_fx_debug(renderer);
+	TRACY_BOTH_ZONES_END;
+}
+
+/**
+ * Makes the pending batch of the renderer accept primitives of the given
+ * type, flushing it first if it holds anything incompatible.
+ */
+static void batch_begin(struct fx_gles_render_pass *pass, enum fx_batch_type type,
+		enum wlr_render_blend_mode blend_mode) {
+	struct fx_renderer *renderer = pass->buffer->renderer;
+	if (renderer->batch.pass != pass || renderer->batch.type != type ||
+			renderer->batch.blend_mode != blend_mode) {
+		batch_flush(renderer);
+	}
+
+	renderer->batch.pass = pass;
+	renderer->batch.type = type;
+	renderer->batch.blend_mode = blend_mode;
+}
+
+static GLfloat *rect_batch_vertex(GLfloat *verts, int32_t x, int32_t y,
+		const struct wlr_render_color *color) {
+	*verts++ = x;
+	*verts++ = y;
+	*verts++ = color->r;
+	*verts++ = color->g;
+	*verts++ = color->b;
+	*verts++ = color->a;
+	return verts;
+}
+
+/**
+ * Queues a solid rect to be drawn along with the other solid rects added
+ * right before or after it.
+ */
+static void rect_batch_add(struct fx_gles_render_pass *pass, const struct wlr_box *box,
+		const pixman_region32_t *clip, const struct wlr_render_color *color,
+		enum wlr_render_blend_mode blend_mode) {
+	struct fx_renderer *renderer = pass->buffer->renderer;
+	batch_begin(pass, FX_BATCH_RECTS, blend_mode);
+
+	pixman_box32_t box_rect;
+	int clip_rects_len;
+	const pixman_box32_t *clip_rects =
+		box_clip_rects(box, clip, &box_rect, &clip_rects_len);
+	int rects_len = box_clip_rects_count(box, clip_rects, clip_rects_len);
+	if (rects_len == 0) {
+		return;
+	}
+
+	GLfloat *verts = wl_array_add(&renderer->batch.data,
+		(size_t)rects_len * 6 * 6 * sizeof(GLfloat));
+	if (verts == NULL) {
+		wlr_log(WLR_ERROR, "Failed to grow the rect batch");
+		return;
+	}
+
+	for (int i = 0; i < clip_rects_len; i++) {
+		pixman_box32_t rect;
+		if (!box_clip_rect(box, &clip_rects[i], &rect)) {
+			continue;
+		}
+		verts = rect_batch_vertex(verts, rect.x1, rect.y1, color);
+		verts = rect_batch_vertex(verts, rect.x2, rect.y1, color);
+		verts = rect_batch_vertex(verts, rect.x1, rect.y2, color);
+		verts = rect_batch_vertex(verts, rect.x2, rect.y1, color);
+		verts = rect_batch_vertex(verts, rect.x2, rect.y2, color);
+		verts = rect_batch_vertex(verts, rect.x1, rect.y2, color);
+	}
+}
+
+/**
+ * Queues an instance of an instanced program for every rect of the clip
+ * region intersecting the box. Only available with instanced_arrays.
+ */
+static void instance_batch_add(struct fx_gles_render_pass *pass,
+		enum fx_batch_type type, const struct wlr_box *box,
+		const pixman_region32_t *clip, const struct fx_batch_instance *instance) {
+	struct fx_renderer *renderer = pass->buffer->renderer;
+	assert(renderer->exts.instanced_arrays);
+	batch_begin(pass, type, WLR_RENDER_BLEND_MODE_PREMULTIPLIED);
+
+	pixman_box32_t box_rect;
+	int clip_rects_len;
+	const pixman_box32_t *clip_rects =
+		box_clip_rects(box, clip, &box_rect, &clip_rects_len);
+	int rects_len = box_clip_rects_count(box, clip_rects, clip_rects_len);
+	if (rects_len == 0) {
+		return;
+	}
+
+	struct fx_batch_instance *instances = wl_array_add(&renderer->batch.data,
+		(size_t)rects_len * sizeof(*instances));
+	if (instances == NULL) {
+		wlr_log(WLR_ERROR, "Failed to grow the instance batch");
+		return;
+	}
+
+	for (int i = 0; i < clip_rects_len; i++) {
+		pixman_box32_t rect;
+		if (!box_clip_rect(box, &clip_rects[i], &rect)) {
+			continue;
+		}
+		*instances = *instance;
+		instances->draw_box[0] = rect.x1;
+		instances->draw_box[1] = rect.y1;
+		instances->draw_box[2] = rect.x2;
+		instances->draw_box[3] = rect.y2;
+		instances++;
+	}
+}
+
+static void batch_instance_set_clip(struct fx_batch_instance *instance,
+		const struct wlr_box *clipped_region_box,
+		const struct fx_corner_fradii *clipped_region_corners) {
+	instance->clip_box[0] = clipped_region_box->x;
+	instance->clip_box[1] = clipped_region_box->y;
+	instance->clip_box[2] = clipped_region_box->width;
+	instance->clip_box[3] = clipped_region_box->height;
+	instance->clip_radius[0] = clipped_region_corners->top_left;
+	instance->clip_radius[1] = clipped_region_corners->top_right;
+	instance->clip_radius[2] = clipped_region_corners->bottom_left;
+	instance->clip_radius[3] = clipped_region_corners->bottom_right;
+}
+
 static bool apply_clip_region(pixman_region32_t *clip_region,
 		const struct wlr_box *clipped_region_box, const struct fx_corner_fradii *corners) {
 	if (!wlr_box_empty(clipped_region_box)) {
@@ -348,49 +698,178 @@ static bool apply_clip_region(pixman_region32_t *clip_region,
 	return false;
 }
 
+// Picks the cheapest corner variant able to draw the given radii. The uniform
+// variant only handles corners which don't overlap, see corner_alpha_uniform
+static enum shader_corners corners_variant(const struct fx_corner_fradii *corners,
+		int width, int height) {
+	if (fx_corner_fradii_is_empty(corners)) {
+		return SHADER_CORNERS_NONE;
+	}
+
+	float radius = corners->top_left;
+	if (corners->top_right == radius && corners->bottom_left == radius &&
+			corners->bottom_right == radius &&
+			radius * 2 <= fmin(width, height) - 1) {
+		return SHADER_CORNERS_UNIFORM;
+	}
+	return SHADER_CORNERS_PER_CORNER;
+}
+
+/**
+ * Moves the part of the region inside the box which is away from the rounded
+ * corners into interior, leaving only the corner patches and whatever lies
+ * outside of the box in region. Drawing the interior with the corners
+ * disabled gives the same result, without evaluating them for every pixel.
+ * Returns false if the interior is empty.
+ */
+static bool rounded_box_split(const struct wlr_box *box,
+		const struct fx_corner_fradii *corners, pixman_region32_t *region,
+		pixman_region32_t *interior) {
+	// Covers the antialiased edge of the corner as well
+	int tl = corners->top_left > 0 ? ceilf(corners->top_left) + 1 : 0;
+	int tr = corners->top_right > 0 ? ceilf(corners->top_right) + 1 : 0;
+	int bl = corners->bottom_left > 0 ? ceilf(corners->bottom_left) + 1 : 0;
+	int br = corners->bottom_right > 0 ? ceilf(corners->bottom_right) + 1 : 0;
+
+	pixman_region32_t patches;
+	pixman_region32_init(&patches);
+	pixman_region32_union_rect(&patches, &patches,
+		box->x, box->y, tl, tl);
+	pixman_region32_union_rect(&patches, &patches,
+		box->x + box->width - tr, box->y, tr, tr);
+	pixman_region32_union_rect(&patches, &patches,
+		box->x, box->y + box->height - bl, bl, bl);
+	pixman_region32_union_rect(&patches, &patches,
+		box->x + box->width - br, box->y + box->height - br, br, br);
+
+	pixman_region32_intersect_rect(interior, region,
+		box->x, box->y, box->width, box->height);
+	pixman_region32_subtract(interior, interior, &patches);
+	pixman_region32_subtract(region, region, interior);
+	pixman_region32_fini(&patches);
+
+	return pixman_region32_not_empty(interior);
+}
+
+static void render_texture_region(struct fx_gles_render_pass *pass,
+		const struct fx_render_texture_options *fx_options,
+		struct fx_texture *texture, enum fx_tex_shader_source source,
+		const struct shader_variant *variant, const struct wlr_box *dst_box,
+		const struct wlr_fbox *src_fbox, const struct wlr_box *clip_box,
+		const pixman_region32_t *region) {
+	if (!pixman_region32_not_empty(region)) {
+		return;
+	}
+
+	const struct wlr_render_texture_options *options = &fx_options->base;
+	struct fx_renderer *renderer = pass->buffer->renderer;
+
+	struct shader_variant picked;
+	struct tex_shader *shader = fx_renderer_tex_shader(renderer, source, variant, &picked);
+	if (shader == NULL) {
+		return;
+	}
+
+	float alpha = wlr_render_texture_options_get_alpha(options);
+	bool use_effects = variant->corners != SHADER_CORNERS_NONE || variant->clip;
+	bool has_alpha = texture->has_alpha || alpha < 1.0 || use_effects;
+	setup_blending(renderer, !has_alpha ? WLR_RENDER_BLEND_MODE_NONE : options->blend_mode);
+
+	fx_gl_use_program(renderer, shader->program);
+
+	fx_gl_active_texture(renderer, GL_TEXTURE0);
+	fx_gl_bind_texture(renderer, texture->target, texture->tex);
+
+	switch (options->filter_mode) {
+	case WLR_SCALE_FILTER_BILINEAR:
+		fx_gl_texture_filter(renderer, texture, GL_LINEAR);
+		break;
+	case WLR_SCALE_FILTER_NEAREST:
+		fx_gl_texture_filter(renderer, texture, GL_NEAREST);
+		break;
+	}
+
+	uniform_1i_set(renderer, &shader->uniforms, shader->tex, 0);
+	uniform_1f_set(renderer, &shader->uniforms, shader->alpha, alpha);
+
+	// A fallback to the full variant evaluates more than was asked for,
+	// these features get neutral values: no discard and zero radii
+	if (picked.discard_transparent) {
+		uniform_1f_set(renderer, &shader->uniforms, shader->discard_transparent,
+			variant->discard_transparent && fx_options->discard_transparent);
+	}
+
+	if (picked.corners != SHADER_CORNERS_NONE) {
+		struct fx_corner_fradii corners = {0};
+		if (variant->corners != SHADER_CORNERS_NONE) {
+			corners = fx_options->corners;
+		}
+
+		uniform_2f_set(renderer, &shader->uniforms, shader->effects.size, clip_box->width, clip_box->height);
+		uniform_2f_set(renderer, &shader->uniforms, shader->effects.position, clip_box->x, clip_box->y);
+		uniform_corner_radii_set(renderer, &shader->uniforms, &shader->effects.radius, &corners);
+	}
+	if (picked.clip) {
+		const struct wlr_box *clipped_region_box = &fx_options->clipped_region.area;
+		struct fx_corner_fradii clipped_region_corners = {0};
+		if (variant->clip) {
+			clipped_region_corners = fx_options->clipped_region.corners;
+		}
+		uniform_2f_set(renderer, &shader->uniforms, shader->effects.clip_size, clipped_region_box->width, clipped_region_box->height);
+		uniform_2f_set(renderer, &shader->uniforms, shader->effects.clip_position, clipped_region_box->x, clipped_region_box->y);
+		uniform_corner_radii_set(renderer, &shader->uniforms, &shader->effects.clip_radius, &clipped_region_corners);
+	}
+
+	set_proj_matrix(renderer, &shader->uniforms, shader->proj, pass->projection_matrix, dst_box);
+	set_tex_matrix(renderer, &shader->uniforms, shader->tex_proj, options->transform, src_fbox);
+
+	render(renderer, dst_box, region, shader->pos_attrib);
+}
+
 void fx_render_pass_add_texture(struct fx_gles_render_pass *pass,
 		const struct fx_render_texture_options *fx_options) {
 	const struct wlr_render_texture_options *options = &fx_options->base;
 	struct fx_renderer *renderer = pass->buffer->renderer;
 	struct fx_texture *texture = fx_get_texture(options->texture);
 
-	struct tex_shader *shader = NULL;
+	batch_flush(renderer);
+
+	struct wlr_box dst_box;
+	struct wlr_fbox src_fbox;
+	wlr_render_texture_options_get_src_box(options, &src_fbox);
+	wlr_render_texture_options_get_dst_box(options, &dst_box);
+
+	const struct wlr_box *clip_box = &dst_box;
+	if (!wlr_box_empty(fx_options->clip_box)) {
+		clip_box = fx_options->clip_box;
+	}
 
-	bool use_effects = !fx_corner_fradii_is_empty(&fx_options->corners)
-		|| clipped_fregion_is_valid(&fx_options->clipped_region);
+	struct shader_variant variant = {
+		.corners = corners_variant(&fx_options->corners,
+			clip_box->width, clip_box->height),
+		.clip = clipped_fregion_is_valid(&fx_options->clipped_region),
+		.discard_transparent = fx_options->discard_transparent,
+	};
+
+	enum fx_tex_shader_source source;
 	switch (texture->target) {
 	case GL_TEXTURE_2D:
-		if (texture->has_alpha) {
-			shader = use_effects
-				? &renderer->shaders.tex_effects_rgba
-				: &renderer->shaders.tex_rgba;
-		} else {
-			shader = use_effects
-				? &renderer->shaders.tex_effects_rgbx
-				: &renderer->shaders.tex_rgbx;
-		}
+		source = texture->has_alpha
+			? SHADER_SOURCE_TEXTURE_RGBA
+			: SHADER_SOURCE_TEXTURE_RGBX;
 		break;
 	case GL_TEXTURE_EXTERNAL_OES:
 		// EGL_EXT_image_dma_buf_import_modifiers requires
 		// GL_OES_EGL_image_external
 		assert(renderer->exts.OES_egl_image_external);
-		shader = use_effects
-			? &renderer->shaders.tex_effects_ext
-			: &renderer->shaders.tex_ext;
+		source = SHADER_SOURCE_TEXTURE_EXTERNAL;
 		break;
 	default:
 		abort();
 	}
-
-	struct wlr_box dst_box;
-	struct wlr_fbox src_fbox;
-	wlr_render_texture_options_get_src_box(options, &src_fbox);
-	wlr_render_texture_options_get_dst_box(options, &dst_box);
-	float alpha = wlr_render_texture_options_get_alpha(options);
-
-	const struct wlr_box *clip_box = &dst_box;
-	if (!wlr_box_empty(fx_options->clip_box)) {
-		clip_box = fx_options->clip_box;
+	struct shader_variant picked;
+	if (fx_renderer_tex_shader(renderer, source, &variant, &picked) == NULL) {
+		return;
 	}
 
 	src_fbox.x /= options->texture->width;
@@ -405,17 +884,11 @@ void fx_render_pass_add_texture(struct fx_gles_render_pass *pass,
 			clip_box->width, clip_box->height, clip_box->x, clip_box->y);
 	TRACY_ZONE_TEXT_f("src_box (WxH, X, Y): %lfx%lf, %lf, %lf",
 			src_fbox.width, src_fbox.height, src_fbox.x, src_fbox.y);
-	TRACY_ZONE_TEXT_f("Shader Type: %s",
-			use_effects ? (
-			 shader == &renderer->shaders.tex_effects_rgba ? "Effects RGBA"
-			 : shader == &renderer->shaders.tex_effects_rgbx ? "Effects RGBX"
-			 : "Effects EXT"
-			) : (
-				shader == &renderer->shaders.tex_rgba ? "RGBA"
-				: shader == &renderer->shaders.tex_rgbx ? "RGBX"
-				: "EXT"
-			)
-		);
+	TRACY_ZONE_TEXT_f("Shader Type: %s, variant %zu",
+			source == SHADER_SOURCE_TEXTURE_RGBA ? "RGBA"
+			: source == SHADER_SOURCE_TEXTURE_RGBX ? "RGBX"
+			: "EXT",
+			shader_variant_index(&variant));
 	push_fx_debug(renderer);
 
 	if (options->wait_timeline != NULL) {
@@ -441,10 +914,6 @@ void fx_render_pass_add_texture(struct fx_gles_render_pass *pass,
 		}
 	}
 
-	bool has_alpha = texture->has_alpha || alpha < 1.0 || use_effects;
-	TRACY_ZONE_TEXT_f("Has Alpha: %d", has_alpha);
-	setup_blending(!has_alpha ? WLR_RENDER_BLEND_MODE_NONE : options->blend_mode);
-
 	pixman_region32_t clip_region;
 	if (options->clip) {
 		pixman_region32_init(&clip_region);
@@ -456,47 +925,23 @@ void fx_render_pass_add_texture(struct fx_gles_render_pass *pass,
 	struct fx_corner_fradii clipped_region_corners = fx_options->clipped_region.corners;
 	apply_clip_region(&clip_region, &clipped_region_box, &clipped_region_corners);
 
-	glUseProgram(shader->program);
-
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(texture->target, texture->tex);
-
-	switch (options->filter_mode) {
-	case WLR_SCALE_FILTER_BILINEAR:
-		glTexParameteri(texture->target, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-		glTexParameteri(texture->target, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-		break;
-	case WLR_SCALE_FILTER_NEAREST:
-		glTexParameteri(texture->target, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-		glTexParameteri(texture->target, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-		break;
-	}
-
-	glUniform1i(shader->tex, 0);
-	glUniform1f(shader->alpha, alpha);
-
-	glUniform1f(shader->discard_transparent, fx_options->discard_transparent);
-
-	if (use_effects) {
-		struct fx_corner_fradii corners = fx_options->corners;
-
-		glUniform2f(shader->effects.size, clip_box->width, clip_box->height);
-		glUniform2f(shader->effects.position, clip_box->x, clip_box->y);
-		uniform_corner_radii_set(&shader->effects.radius, &corners);
-
-		glUniform2f(shader->effects.clip_size, clipped_region_box.width, clipped_region_box.height);
-		glUniform2f(shader->effects.clip_position, clipped_region_box.x, clipped_region_box.y);
-		uniform_corner_radii_set(&shader->effects.clip_radius, &clipped_region_corners);
+	// Only the corner patches need the corners evaluated, the interior of
+	// the box goes through the cheaper variant and may skip blending
+	pixman_region32_t interior;
+	pixman_region32_init(&interior);
+	if (variant.corners != SHADER_CORNERS_NONE &&
+			rounded_box_split(clip_box, &fx_options->corners, &clip_region, &interior)) {
+		struct shader_variant interior_variant = variant;
+		interior_variant.corners = SHADER_CORNERS_NONE;
+		render_texture_region(pass, fx_options, texture, source, &interior_variant,
+			&dst_box, &src_fbox, clip_box, &interior);
 	}
+	pixman_region32_fini(&interior);
 
-	set_proj_matrix(shader->proj, pass->projection_matrix, &dst_box);
-	set_tex_matrix(shader->tex_proj, options->transform, &src_fbox);
-
-	render(&dst_box, &clip_region, shader->pos_attrib);
+	render_texture_region(pass, fx_options, texture, source, &variant,
+		&dst_box, &src_fbox, clip_box, &clip_region);
 	pixman_region32_fini(&clip_region);
 
-	glBindTexture(texture->target, 0);
-
 	pop_fx_debug(renderer);
 	TRACY_BOTH_ZONES_END;
 }
@@ -530,9 +975,39 @@ void fx_render_pass_add_rect(struct fx_gles_render_pass *pass,
 
 	push_fx_debug(renderer);
 	if (use_fast_clear) {
+		batch_flush(renderer);
 		glClearColor(color->r, color->g, color->b, color->a);
 		glClear(GL_COLOR_BUFFER_BIT);
+	} else if (!should_clip) {
+		// Solid rects don't need any per-draw state besides blending, so
+		// they can be drawn together with their neighbours
+		rect_batch_add(pass, &box, options->clip, color, blend_mode);
+	} else if (blend_mode == WLR_RENDER_BLEND_MODE_PREMULTIPLIED &&
+			fx_renderer_quad_round_instanced_shader(renderer) != NULL) {
+		// A clipped rect is a rounded rect without any radii
+		const struct wlr_box *clipped_region_box = &fx_options->clipped_region.area;
+		const struct fx_corner_fradii *clipped_region_corners = &fx_options->clipped_region.corners;
+
+		pixman_region32_t clip_region;
+		if (options->clip) {
+			pixman_region32_init(&clip_region);
+			pixman_region32_copy(&clip_region, options->clip);
+		} else {
+			pixman_region32_init_rect(&clip_region, box.x, box.y, box.width, box.height);
+		}
+		apply_clip_region(&clip_region, clipped_region_box, clipped_region_corners);
+
+		struct fx_batch_instance instance = {
+			.color = { color->r, color->g, color->b, color->a },
+			.box = { box.x, box.y, box.width, box.height },
+		};
+		batch_instance_set_clip(&instance, clipped_region_box, clipped_region_corners);
+		instance_batch_add(pass, FX_BATCH_ROUNDED_RECTS, &box, &clip_region, &instance);
+
+		pixman_region32_fini(&clip_region);
 	} else {
+		batch_flush(renderer);
+
 		const struct wlr_box *clipped_region_box = &fx_options->clipped_region.area;
 		const struct fx_corner_fradii *clipped_region_corners = &fx_options->clipped_region.corners;
 
@@ -555,19 +1030,19 @@ void fx_render_pass_add_rect(struct fx_gles_render_pass *pass,
 
 		apply_clip_region(&clip_region, clipped_region_box, clipped_region_corners);
 
-		setup_blending(blend_mode);
+		setup_blending(renderer, blend_mode);
 		struct quad_shader *shader = should_clip
 			? &renderer->shaders.quad_clip
 			: &renderer->shaders.quad;
-		glUseProgram(shader->program);
-		set_proj_matrix(shader->proj, pass->projection_matrix, &box);
-		glUniform4f(shader->color, color->r, color->g, color->b, color->a);
+		fx_gl_use_program(renderer, shader->program);
+		set_proj_matrix(renderer, &shader->uniforms, shader->proj, pass->projection_matrix, &box);
+		uniform_4f_set(renderer, &shader->uniforms, shader->color, color->r, color->g, color->b, color->a);
 		if (should_clip) {
-			glUniform2f(shader->effects.clip_size, clipped_region_box->width, clipped_region_box->height);
-			glUniform2f(shader->effects.clip_position, clipped_region_box->x, clipped_region_box->y);
-			uniform_corner_radii_set(&shader->effects.clip_radius, clipped_region_corners);
+			uniform_2f_set(renderer, &shader->uniforms, shader->effects.clip_size, clipped_region_box->width, clipped_region_box->height);
+			uniform_2f_set(renderer, &shader->uniforms, shader->effects.clip_position, clipped_region_box->x, clipped_region_box->y);
+			uniform_corner_radii_set(renderer, &shader->uniforms, &shader->effects.clip_radius, clipped_region_corners);
 		}
-		render(&box, &clip_region, shader->pos_attrib);
+		render(renderer, &box, &clip_region, shader->pos_attrib);
 
 		pixman_region32_fini(&clip_region);
 	}
@@ -581,13 +1056,15 @@ void fx_render_pass_add_rect_grad(struct fx_gles_render_pass *pass,
 	const struct wlr_render_rect_options *options = &fx_options->base;
 
 	struct fx_renderer *renderer = pass->buffer->renderer;
+	batch_flush(renderer);
 
-	if (renderer->shaders.quad_grad.max_len <= fx_options->gradient.count) {
-		glDeleteProgram(renderer->shaders.quad_grad.program);
-		if (!link_quad_grad_program(&renderer->shaders.quad_grad, fx_options->gradient.count + 1)) {
-			wlr_log(WLR_ERROR, "Could not link quad shader after updating max_len to %d. Aborting renderer", fx_options->gradient.count + 1);
-			abort();
-		}
+	if (!fx_renderer_link_programs(renderer, FX_RENDERER_PROGRAMS_GRADIENTS)) {
+		return;
+	}
+	fx_gl_active_texture(renderer, GL_TEXTURE0);
+	GLuint lut = fx_gradient_lut_get(renderer, &fx_options->gradient);
+	if (lut == 0) {
+		return;
 	}
 
 	struct wlr_box box;
@@ -612,33 +1089,81 @@ void fx_render_pass_add_rect_grad(struct fx_gles_render_pass *pass,
 	// TODO: Display Colors (not really sure how it works without a scene example...)
 	push_fx_debug(renderer);
 
-	setup_blending(options->blend_mode);
+	setup_blending(renderer, options->blend_mode);
 
-	struct quad_grad_shader shader = renderer->shaders.quad_grad;
-	glUseProgram(shader.program);
+	struct quad_grad_shader *shader = &renderer->shaders.quad_grad;
+	fx_gl_use_program(renderer, shader->program);
 
-	set_proj_matrix(shader.proj, pass->projection_matrix, &box);
-	glUniform4fv(shader.colors, fx_options->gradient.count, (GLfloat*)fx_options->gradient.colors);
-	glUniform1i(shader.count, fx_options->gradient.count);
-	glUniform2f(shader.size, fx_options->gradient.range.width, fx_options->gradient.range.height);
-	glUniform1f(shader.degree, fx_options->gradient.degree);
-	glUniform1f(shader.linear, fx_options->gradient.linear);
-	glUniform1f(shader.blend, fx_options->gradient.blend);
-	glUniform2f(shader.grad_box, fx_options->gradient.range.x, fx_options->gradient.range.y);
-	glUniform2f(shader.origin, fx_options->gradient.origin[0], fx_options->gradient.origin[1]);
+	set_proj_matrix(renderer, &shader->uniforms, shader->proj, pass->projection_matrix, &box);
+	fx_gl_bind_texture(renderer, GL_TEXTURE_2D, lut);
+	uniform_1i_set(renderer, &shader->uniforms, shader->lut, 0);
+	float rad = fx_options->gradient.degree * DEG_TO_RAD;
+	uniform_2f_set(renderer, &shader->uniforms, shader->rotation, cosf(rad), sinf(rad));
+	uniform_2f_set(renderer, &shader->uniforms, shader->size, fx_options->gradient.range.width, fx_options->gradient.range.height);
+	uniform_1f_set(renderer, &shader->uniforms, shader->linear, fx_options->gradient.linear);
+	uniform_2f_set(renderer, &shader->uniforms, shader->grad_box, fx_options->gradient.range.x, fx_options->gradient.range.y);
+	uniform_2f_set(renderer, &shader->uniforms, shader->origin, fx_options->gradient.origin[0], fx_options->gradient.origin[1]);
 
-	render(&box, options->clip, shader.pos_attrib);
+	render(renderer, &box, options->clip, shader->pos_attrib);
 
 	pop_fx_debug(renderer);
 	TRACY_BOTH_ZONES_END;
 }
 
+static void render_rounded_rect_region(struct fx_gles_render_pass *pass,
+		const struct fx_render_rounded_rect_options *fx_options,
+		const struct wlr_box *box, const struct shader_variant *variant,
+		const pixman_region32_t *region) {
+	if (!pixman_region32_not_empty(region)) {
+		return;
+	}
+
+	struct fx_renderer *renderer = pass->buffer->renderer;
+	const struct wlr_render_color *color = &fx_options->base.color;
+	const struct wlr_box *clipped_region_box = &fx_options->clipped_region.area;
+	const struct fx_corner_fradii *clipped_region_corners = &fx_options->clipped_region.corners;
+
+	setup_blending(renderer, WLR_RENDER_BLEND_MODE_PREMULTIPLIED);
+
+	struct shader_variant picked;
+	struct quad_round_shader *shader = fx_renderer_quad_round_shader(renderer, variant, &picked);
+	if (shader == NULL) {
+		return;
+	}
+
+	fx_gl_use_program(renderer, shader->program);
+
+	set_proj_matrix(renderer, &shader->uniforms, shader->proj, pass->projection_matrix, box);
+	uniform_4f_set(renderer, &shader->uniforms, shader->color, color->r, color->g, color->b, color->a);
+
+	// Features only present because of a fallback get zero radii
+	if (picked.corners != SHADER_CORNERS_NONE) {
+		struct fx_corner_fradii corners = {0};
+		if (variant->corners != SHADER_CORNERS_NONE) {
+			corners = fx_options->corners;
+		}
+		uniform_2f_set(renderer, &shader->uniforms, shader->size, box->width, box->height);
+		uniform_2f_set(renderer, &shader->uniforms, shader->position, box->x, box->y);
+		uniform_corner_radii_set(renderer, &shader->uniforms, &shader->radius, &corners);
+	}
+	if (picked.clip) {
+		struct fx_corner_fradii clip_corners = {0};
+		if (variant->clip) {
+			clip_corners = *clipped_region_corners;
+		}
+		uniform_2f_set(renderer, &shader->uniforms, shader->clip_size, clipped_region_box->width, clipped_region_box->height);
+		uniform_2f_set(renderer, &shader->uniforms, shader->clip_position, clipped_region_box->x, clipped_region_box->y);
+		uniform_corner_radii_set(renderer, &shader->uniforms, &shader->clip_radius, &clip_corners);
+	}
+
+	render(renderer, box, region, shader->pos_attrib);
+}
+
 void fx_render_pass_add_rounded_rect(struct fx_gles_render_pass *pass,
 		const struct fx_render_rounded_rect_options *fx_options) {
 	const struct wlr_render_rect_options *options = &fx_options->base;
 
 	struct fx_renderer *renderer = pass->buffer->renderer;
-
 	const struct wlr_render_color *color = &options->color;
 	struct wlr_box box;
 	struct wlr_buffer *wlr_buffer = pass->buffer->buffer;
@@ -655,6 +1180,33 @@ void fx_render_pass_add_rounded_rect(struct fx_gles_render_pass *pass,
 	const struct fx_corner_fradii *clipped_region_corners = &fx_options->clipped_region.corners;
 	apply_clip_region(&clip_region, clipped_region_box, clipped_region_corners);
 
+	// Only the corner patches need the corners evaluated
+	pixman_region32_t interior;
+	pixman_region32_init(&interior);
+	bool split = rounded_box_split(&box, &fx_options->corners, &clip_region, &interior);
+
+	if (fx_renderer_quad_round_instanced_shader(renderer) != NULL) {
+		const struct fx_corner_fradii *corners = &fx_options->corners;
+		struct fx_batch_instance instance = {
+			.color = { color->r, color->g, color->b, color->a },
+			.box = { box.x, box.y, box.width, box.height },
+		};
+		batch_instance_set_clip(&instance, clipped_region_box, clipped_region_corners);
+		if (split) {
+			// corner_alpha returns early for instances without radii
+			instance_batch_add(pass, FX_BATCH_ROUNDED_RECTS, &box, &interior, &instance);
+		}
+		instance.radius[0] = corners->top_left;
+		instance.radius[1] = corners->top_right;
+		instance.radius[2] = corners->bottom_left;
+		instance.radius[3] = corners->bottom_right;
+		instance_batch_add(pass, FX_BATCH_ROUNDED_RECTS, &box, &clip_region, &instance);
+		pixman_region32_fini(&interior);
+		pixman_region32_fini(&clip_region);
+		return;
+	}
+	batch_flush(renderer);
+
 	TRACY_BOTH_ZONES_START(renderer);
 	TRACY_ZONE_TEXT_f("Box (WxH, X, Y): %dx%d, %d, %d", box.width, box.height, box.x, box.y);
 	TRACY_ZONE_TEXT_f("Clip Box (WxH, X, Y): %dx%d, %d, %d",
@@ -673,27 +1225,29 @@ void fx_render_pass_add_rounded_rect(struct fx_gles_render_pass *pass,
 			clipped_region_corners->bottom_right);
 	push_fx_debug(renderer);
 
-	setup_blending(WLR_RENDER_BLEND_MODE_PREMULTIPLIED);
-
-	struct quad_round_shader shader = renderer->shaders.quad_round;
-
-	glUseProgram(shader.program);
-
-	set_proj_matrix(shader.proj, pass->projection_matrix, &box);
-	glUniform4f(shader.color, color->r, color->g, color->b, color->a);
-
-	glUniform2f(shader.size, box.width, box.height);
-	glUniform2f(shader.position, box.x, box.y);
-	glUniform2f(shader.clip_size, clipped_region_box->width, clipped_region_box->height);
-	glUniform2f(shader.clip_position, clipped_region_box->x, clipped_region_box->y);
-	uniform_corner_radii_set(&shader.clip_radius, clipped_region_corners);
-
-	struct fx_corner_fradii corners = fx_options->corners;
-	uniform_corner_radii_set(&shader.radius, &corners);
-
-	render(&box, &clip_region, renderer->shaders.quad_round.pos_attrib);
+	struct shader_variant variant = {
+		.corners = corners_variant(&fx_options->corners, box.width, box.height),
+		.clip = clipped_fregion_is_valid(&fx_options->clipped_region),
+	};
+	render_rounded_rect_region(pass, fx_options, &box, &variant, &clip_region);
 	pixman_region32_fini(&clip_region);
 
+	if (split && !variant.clip) {
+		// Without the clip the interior is a solid rect, which can be
+		// batched with its neighbours
+		enum wlr_render_blend_mode blend_mode = color->a == 1.0
+			? WLR_RENDER_BLEND_MODE_NONE
+			: WLR_RENDER_BLEND_MODE_PREMULTIPLIED;
+		rect_batch_add(pass, &box, &interior, color, blend_mode);
+	} else if (split) {
+		struct shader_variant interior_variant = {
+			.corners = SHADER_CORNERS_NONE,
+			.clip = true,
+		};
+		render_rounded_rect_region(pass, fx_options, &box, &interior_variant, &interior);
+	}
+	pixman_region32_fini(&interior);
+
 	pop_fx_debug(renderer);
 	TRACY_BOTH_ZONES_END;
 }
@@ -703,13 +1257,15 @@ void fx_render_pass_add_rounded_rect_grad(struct fx_gles_render_pass *pass,
 	const struct wlr_render_rect_options *options = &fx_options->base;
 
 	struct fx_renderer *renderer = pass->buffer->renderer;
+	batch_flush(renderer);
 
-	if (renderer->shaders.quad_grad_round.max_len <= fx_options->gradient.count) {
-		glDeleteProgram(renderer->shaders.quad_grad_round.program);
-		if (!link_quad_grad_round_program(&renderer->shaders.quad_grad_round, fx_options->gradient.count + 1)) {
-			wlr_log(WLR_ERROR, "Could not link quad shader after updating max_len to %d. Aborting renderer", fx_options->gradient.count + 1);
-			abort();
-		}
+	if (!fx_renderer_link_programs(renderer, FX_RENDERER_PROGRAMS_GRADIENTS)) {
+		return;
+	}
+	fx_gl_active_texture(renderer, GL_TEXTURE0);
+	GLuint lut = fx_gradient_lut_get(renderer, &fx_options->gradient);
+	if (lut == 0) {
+		return;
 	}
 
 	struct wlr_box box;
@@ -739,29 +1295,29 @@ void fx_render_pass_add_rounded_rect_grad(struct fx_gles_render_pass *pass,
 	// TODO: Display Colors (not really sure how it works without a scene example...)
 	push_fx_debug(renderer);
 
-	setup_blending(WLR_RENDER_BLEND_MODE_PREMULTIPLIED);
+	setup_blending(renderer, WLR_RENDER_BLEND_MODE_PREMULTIPLIED);
 
-	struct quad_grad_round_shader shader = renderer->shaders.quad_grad_round;
-	glUseProgram(shader.program);
+	struct quad_grad_round_shader *shader = &renderer->shaders.quad_grad_round;
+	fx_gl_use_program(renderer, shader->program);
 
-	set_proj_matrix(shader.proj, pass->projection_matrix, &box);
+	set_proj_matrix(renderer, &shader->uniforms, shader->proj, pass->projection_matrix, &box);
 
-	glUniform2f(shader.size, box.width, box.height);
-	glUniform2f(shader.position, box.x, box.y);
+	uniform_2f_set(renderer, &shader->uniforms, shader->size, box.width, box.height);
+	uniform_2f_set(renderer, &shader->uniforms, shader->position, box.x, box.y);
 
-	glUniform4fv(shader.colors, fx_options->gradient.count, (GLfloat*)fx_options->gradient.colors);
-	glUniform1i(shader.count, fx_options->gradient.count);
-	glUniform2f(shader.grad_size, fx_options->gradient.range.width, fx_options->gradient.range.height);
-	glUniform1f(shader.degree, fx_options->gradient.degree);
-	glUniform1f(shader.linear, fx_options->gradient.linear);
-	glUniform1f(shader.blend, fx_options->gradient.blend);
-	glUniform2f(shader.grad_box, fx_options->gradient.range.x, fx_options->gradient.range.y);
-	glUniform2f(shader.origin, fx_options->gradient.origin[0], fx_options->gradient.origin[1]);
+	fx_gl_bind_texture(renderer, GL_TEXTURE_2D, lut);
+	uniform_1i_set(renderer, &shader->uniforms, shader->lut, 0);
+	float rad = fx_options->gradient.degree * DEG_TO_RAD;
+	uniform_2f_set(renderer, &shader->uniforms, shader->rotation, cosf(rad), sinf(rad));
+	uniform_2f_set(renderer, &shader->uniforms, shader->grad_size, fx_options->gradient.range.width, fx_options->gradient.range.height);
+	uniform_1f_set(renderer, &shader->uniforms, shader->linear, fx_options->gradient.linear);
+	uniform_2f_set(renderer, &shader->uniforms, shader->grad_box, fx_options->gradient.range.x, fx_options->gradient.range.y);
+	uniform_2f_set(renderer, &shader->uniforms, shader->origin, fx_options->gradient.origin[0], fx_options->gradient.origin[1]);
 
 	struct fx_corner_fradii corners = fx_options->corners;
-	uniform_corner_radii_set(&shader.radius, &corners);
+	uniform_corner_radii_set(renderer, &shader->uniforms, &shader->radius, &corners);
 
-	render(&box, options->clip, shader.pos_attrib);
+	render(renderer, &box, options->clip, shader->pos_attrib);
 
 	pop_fx_debug(renderer);
 	TRACY_BOTH_ZONES_END;
@@ -770,7 +1326,6 @@ void fx_render_pass_add_rounded_rect_grad(struct fx_gles_render_pass *pass,
 void fx_render_pass_add_box_shadow(struct fx_gles_render_pass *pass,
 		const struct fx_render_box_shadow_options *options) {
 	struct fx_renderer *renderer = pass->buffer->renderer;
-
 	struct wlr_box box = options->box;
 	assert(box.width > 0 && box.height > 0);
 
@@ -785,6 +1340,20 @@ void fx_render_pass_add_box_shadow(struct fx_gles_render_pass *pass,
 	struct fx_corner_fradii clipped_region_corners = options->clipped_region.corners;
 	apply_clip_region(&clip_region, &clipped_region_box, &clipped_region_corners);
 
+	if (fx_renderer_box_shadow_instanced_shader(renderer) != NULL) {
+		const struct wlr_render_color *color = &options->color;
+		struct fx_batch_instance instance = {
+			.color = { color->r, color->g, color->b, color->a },
+			.box = { box.x, box.y, box.width, box.height },
+			.radius = { options->corner_radius, options->blur_sigma },
+		};
+		batch_instance_set_clip(&instance, &clipped_region_box, &clipped_region_corners);
+		instance_batch_add(pass, FX_BATCH_BOX_SHADOWS, &box, &clip_region, &instance);
+		pixman_region32_fini(&clip_region);
+		return;
+	}
+	batch_flush(renderer);
+
 	TRACY_BOTH_ZONES_START(renderer);
 	TRACY_ZONE_TEXT_f("Box (WxH, X, Y): %dx%d, %d, %d", box.width, box.height, box.x, box.y);
 	TRACY_ZONE_TEXT_f("Clip Box (WxH, X, Y): %dx%d, %d, %d",
@@ -803,115 +1372,222 @@ void fx_render_pass_add_box_shadow(struct fx_gles_render_pass *pass,
 
 	// blending will practically always be needed (unless we have a madman
 	// who uses opaque shadows with zero sigma), so just enable it
-	setup_blending(WLR_RENDER_BLEND_MODE_PREMULTIPLIED);
-	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	setup_blending(renderer, WLR_RENDER_BLEND_MODE_PREMULTIPLIED);
+	fx_gl_blend_func(renderer, GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
-	glUseProgram(renderer->shaders.box_shadow.program);
+	struct shader_variant variant = {
+		.clip = clipped_fregion_is_valid(&options->clipped_region),
+	};
+	struct shader_variant picked;
+	struct box_shadow_shader *shader = fx_renderer_box_shadow_shader(renderer, &variant, &picked);
+	if (shader == NULL) {
+		pixman_region32_fini(&clip_region);
+		fx_gl_blend_func(renderer, GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+		pop_fx_debug(renderer);
+		TRACY_BOTH_ZONES_END_FAIL;
+		return;
+	}
+	fx_gl_use_program(renderer, shader->program);
 
 	const struct wlr_render_color *color = &options->color;
-	set_proj_matrix(renderer->shaders.box_shadow.proj, pass->projection_matrix, &box);
-	glUniform4f(renderer->shaders.box_shadow.color, color->r, color->g, color->b, color->a);
-	glUniform1f(renderer->shaders.box_shadow.blur_sigma, options->blur_sigma);
-	glUniform2f(renderer->shaders.box_shadow.size, box.width, box.height);
-	glUniform2f(renderer->shaders.box_shadow.position, box.x, box.y);
-	glUniform1f(renderer->shaders.box_shadow.corner_radius, options->corner_radius);
-
-	uniform_corner_radii_set(&renderer->shaders.box_shadow.clip_radius, &clipped_region_corners);
-
-	glUniform2f(renderer->shaders.box_shadow.clip_position, clipped_region_box.x, clipped_region_box.y);
-	glUniform2f(renderer->shaders.box_shadow.clip_size, clipped_region_box.width, clipped_region_box.height);
+	set_proj_matrix(renderer, &shader->uniforms, shader->proj, pass->projection_matrix, &box);
+	uniform_4f_set(renderer, &shader->uniforms, shader->color, color->r, color->g, color->b, color->a);
+	uniform_1f_set(renderer, &shader->uniforms, shader->blur_sigma, options->blur_sigma);
+	uniform_2f_set(renderer, &shader->uniforms, shader->size, box.width, box.height);
+	uniform_2f_set(renderer, &shader->uniforms, shader->position, box.x, box.y);
+	uniform_1f_set(renderer, &shader->uniforms, shader->corner_radius, options->corner_radius);
+
+	// The full variant clips even when it wasn't asked for, zero radii
+	// leave it unclipped
+	if (picked.clip) {
+		if (!variant.clip) {
+			clipped_region_corners = (struct fx_corner_fradii){0};
+		}
+		uniform_corner_radii_set(renderer, &shader->uniforms, &shader->clip_radius, &clipped_region_corners);
+		uniform_2f_set(renderer, &shader->uniforms, shader->clip_position, clipped_region_box.x, clipped_region_box.y);
+		uniform_2f_set(renderer, &shader->uniforms, shader->clip_size, clipped_region_box.width, clipped_region_box.height);
+	}
 
-	render(&box, &clip_region, renderer->shaders.box_shadow.pos_attrib);
+	render(renderer, &box, &clip_region, shader->pos_attrib);
 	pixman_region32_fini(&clip_region);
 
-	glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+	fx_gl_blend_func(renderer, GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
 
 	pop_fx_debug(renderer);
 	TRACY_BOTH_ZONES_END;
 }
 
-// Renders the blur for each damaged rect and swaps the buffer
+/**
+ * Returns a texture of a buffer drawn to during the pass. The offscreen
+ * buffers keep their textures around, other buffers are imported. Release
+ * the texture with pass_buffer_texture_release.
+ */
+static struct wlr_texture *pass_buffer_texture(struct fx_gles_render_pass *pass,
+		struct fx_framebuffer *buffer) {
+	struct wlr_texture *texture = NULL;
+	if (pass->fx_offscreen_buffers != NULL) {
+		texture = fx_offscreen_buffers_get_texture(pass->fx_offscreen_buffers, buffer);
+	}
+	if (texture == NULL) {
+		texture = fx_texture_from_buffer(&buffer->renderer->wlr_renderer,
+			buffer->buffer);
+	}
+	return texture;
+}
+
+static void pass_buffer_texture_release(struct fx_gles_render_pass *pass,
+		struct fx_framebuffer *buffer, struct wlr_texture *texture) {
+	if (pass->fx_offscreen_buffers != NULL && texture ==
+			fx_offscreen_buffers_get_texture(pass->fx_offscreen_buffers, buffer)) {
+		return;
+	}
+	wlr_texture_destroy(texture);
+}
+
+/**
+ * Draws the region of src into dst, which covers box of the pass buffer at
+ * its own size. The region is in pass buffer coordinates.
+ */
+static bool render_buffer_to_box(struct fx_gles_render_pass *pass,
+		struct fx_framebuffer *src, struct fx_framebuffer *dst,
+		const struct wlr_box *box, const pixman_region32_t *region) {
+	struct wlr_texture *src_tex = pass_buffer_texture(pass, src);
+	if (src_tex == NULL) {
+		return false;
+	}
+
+	const int width = dst->buffer->width;
+	const int height = dst->buffer->height;
+	const float scale_x = (float)width / box->width;
+	const float scale_y = (float)height / box->height;
+
+	pixman_region32_t clip;
+	pixman_region32_init(&clip);
+	pixman_region32_copy(&clip, region);
+	pixman_region32_translate(&clip, -box->x, -box->y);
+	wlr_region_scale_xy(&clip, &clip, scale_x, scale_y);
+
+	// Draw with the projection of dst, which may differ in size
+	float projection[9];
+	memcpy(projection, pass->projection_matrix, sizeof(projection));
+	fx_framebuffer_bind(dst);
+	glViewport(0, 0, width, height);
+	matrix_projection(pass->projection_matrix, width, height,
+		WL_OUTPUT_TRANSFORM_FLIPPED_180);
+
+	fx_render_pass_add_texture(pass, &(struct fx_render_texture_options){
+		.base = {
+			.texture = src_tex,
+			.clip = &clip,
+			.transform = WL_OUTPUT_TRANSFORM_NORMAL,
+			.blend_mode = WLR_RENDER_BLEND_MODE_NONE,
+			.filter_mode = WLR_SCALE_FILTER_BILINEAR,
+			.dst_box = {
+				.x = round(-box->x * scale_x),
+				.y = round(-box->y * scale_y),
+				.width = round(src->buffer->width * scale_x),
+				.height = round(src->buffer->height * scale_y),
+			},
+		},
+	});
+
+	memcpy(pass->projection_matrix, projection, sizeof(projection));
+	fx_framebuffer_bind(pass->buffer);
+	glViewport(0, 0, pass->buffer->buffer->width, pass->buffer->buffer->height);
+
+	pixman_region32_fini(&clip);
+	pass_buffer_texture_release(pass, src, src_tex);
+	return true;
+}
+
+// Renders the blur of current_buffer into dst for each damaged rect, and
+// makes dst the current buffer. Both fill their whole buffer, dst only
+// differs in size.
 static void render_blur_segments(struct fx_gles_render_pass *pass,
-		struct fx_render_blur_pass_options *fx_options, struct blur_shader* shader) {
+		struct fx_render_blur_pass_options *fx_options, struct blur_shader* shader,
+		struct fx_framebuffer *dst) {
 	struct fx_render_texture_options *tex_options = &fx_options->tex_options;
 	struct wlr_render_texture_options *options = &tex_options->base;
 	struct fx_renderer *renderer = pass->buffer->renderer;
 	struct blur_data *blur_data = fx_options->blur_data;
 
+	struct wlr_texture *wlr_texture = pass_buffer_texture(pass, fx_options->current_buffer);
+	if (wlr_texture == NULL) {
+		return;
+	}
+	struct fx_texture *texture = fx_get_texture(wlr_texture);
+
 	TRACY_BOTH_ZONES_START(renderer);
 	push_fx_debug(renderer);
 
-	// Swap fbo
-	if (fx_options->current_buffer == pass->fx_offscreen_buffers->effects_buffer) {
-		fx_framebuffer_bind(pass->fx_offscreen_buffers->effects_buffer_swapped);
-	} else {
-		fx_framebuffer_bind(pass->fx_offscreen_buffers->effects_buffer);
-	}
+	fx_framebuffer_bind(dst);
+	glViewport(0, 0, dst->buffer->width, dst->buffer->height);
 
-	options->texture = fx_texture_from_buffer(&renderer->wlr_renderer,
-			fx_options->current_buffer->buffer);
-	struct fx_texture *texture = fx_get_texture(options->texture);
+	float projection[9];
+	matrix_projection(projection, dst->buffer->width, dst->buffer->height,
+		WL_OUTPUT_TRANSFORM_FLIPPED_180);
 
 	/*
 	 * Render
 	 */
 
-	struct wlr_box dst_box;
-	struct wlr_fbox src_fbox;
-	wlr_render_texture_options_get_src_box(options, &src_fbox);
-	wlr_render_texture_options_get_dst_box(options, &dst_box);
-	src_fbox.x /= options->texture->width;
-	src_fbox.y /= options->texture->height;
-	src_fbox.width /= options->texture->width;
-	src_fbox.height /= options->texture->height;
+	struct wlr_box dst_box = {
+		.width = dst->buffer->width,
+		.height = dst->buffer->height,
+	};
+	struct wlr_fbox src_fbox = {
+		.width = 1.0,
+		.height = 1.0,
+	};
 
-	glDisable(GL_BLEND);
-	glDisable(GL_STENCIL_TEST);
+	fx_gl_set_blend(renderer, false);
+	fx_gl_set_stencil_test(renderer, false);
 
-	glUseProgram(shader->program);
+	fx_gl_use_program(renderer, shader->program);
 
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(texture->target, texture->tex);
+	fx_gl_active_texture(renderer, GL_TEXTURE0);
+	fx_gl_bind_texture(renderer, texture->target, texture->tex);
 
 	switch (options->filter_mode) {
 	case WLR_SCALE_FILTER_BILINEAR:
-		glTexParameteri(texture->target, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-		glTexParameteri(texture->target, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		fx_gl_texture_filter(renderer, texture, GL_LINEAR);
 		break;
 	case WLR_SCALE_FILTER_NEAREST:
 		abort();
 	}
 
-	glUniform1i(shader->tex, 0);
-	glUniform1f(shader->radius, blur_data->radius);
+	uniform_1i_set(renderer, &shader->uniforms, shader->tex, 0);
+	uniform_1f_set(renderer, &shader->uniforms, shader->radius, blur_data->radius);
 
+	// Offsets are in texels of the source level
 	if (shader == &renderer->shaders.blur1) {
-		glUniform2f(shader->halfpixel,
-				0.5f / (options->texture->width / 2.0f),
-				0.5f / (options->texture->height / 2.0f));
+		uniform_2f_set(renderer, &shader->uniforms, shader->halfpixel,
+				0.5f / (wlr_texture->width / 2.0f),
+				0.5f / (wlr_texture->height / 2.0f));
 	} else {
-		glUniform2f(shader->halfpixel,
-				0.5f / (options->texture->width * 2.0f),
-				0.5f / (options->texture->height * 2.0f));
+		uniform_2f_set(renderer, &shader->uniforms, shader->halfpixel,
+				0.5f / (wlr_texture->width * 2.0f),
+				0.5f / (wlr_texture->height * 2.0f));
+	}
+
+	if (shader == &renderer->shaders.blur2_effects) {
+		uniform_1f_set(renderer, &shader->uniforms, shader->noise, blur_data->noise);
+		uniform_1f_set(renderer, &shader->uniforms, shader->brightness, blur_data->brightness);
+		uniform_1f_set(renderer, &shader->uniforms, shader->contrast, blur_data->contrast);
+		uniform_1f_set(renderer, &shader->uniforms, shader->saturation, blur_data->saturation);
 	}
 
-	set_proj_matrix(shader->proj, pass->projection_matrix, &dst_box);
-	set_tex_matrix(shader->tex_proj, options->transform, &src_fbox);
+	set_proj_matrix(renderer, &shader->uniforms, shader->proj, projection, &dst_box);
+	set_tex_matrix(renderer, &shader->uniforms, shader->tex_proj, options->transform, &src_fbox);
 
-	render(&dst_box, options->clip, shader->pos_attrib);
+	render(renderer, &dst_box, options->clip, shader->pos_attrib);
 
-	glBindTexture(texture->target, 0);
 	pop_fx_debug(renderer);
 	TRACY_BOTH_ZONES_END;
 
-	wlr_texture_destroy(options->texture);
+	pass_buffer_texture_release(pass, fx_options->current_buffer, wlr_texture);
 
-	// Swap buffer. We don't want to draw to the same buffer
-	if (fx_options->current_buffer != pass->fx_offscreen_buffers->effects_buffer) {
-		fx_options->current_buffer = pass->fx_offscreen_buffers->effects_buffer;
-	} else {
-		fx_options->current_buffer = pass->fx_offscreen_buffers->effects_buffer_swapped;
-	}
+	fx_options->current_buffer = dst;
 }
 
 static void render_blur_effects(struct fx_gles_render_pass *pass,
@@ -922,7 +1598,7 @@ static void render_blur_effects(struct fx_gles_render_pass *pass,
 	struct blur_data *blur_data = fx_options->blur_data;
 	struct fx_texture *texture = fx_get_texture(options->texture);
 
-	struct blur_effects_shader shader = renderer->shaders.blur_effects;
+	struct blur_effects_shader *shader = &renderer->shaders.blur_effects;
 
 	struct wlr_box dst_box;
 	struct wlr_fbox src_fbox;
@@ -934,66 +1610,100 @@ static void render_blur_effects(struct fx_gles_render_pass *pass,
 	src_fbox.width /= options->texture->width;
 	src_fbox.height /= options->texture->height;
 
-	glDisable(GL_BLEND);
-	glDisable(GL_STENCIL_TEST);
+	setup_blending(renderer, options->blend_mode);
+	fx_gl_set_stencil_test(renderer, false);
 
 	TRACY_BOTH_ZONES_START(renderer);
 	push_fx_debug(renderer);
 
-	glUseProgram(shader.program);
+	fx_gl_use_program(renderer, shader->program);
 
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(texture->target, texture->tex);
+	fx_gl_active_texture(renderer, GL_TEXTURE0);
+	fx_gl_bind_texture(renderer, texture->target, texture->tex);
 
 	switch (options->filter_mode) {
 	case WLR_SCALE_FILTER_BILINEAR:
-		glTexParameteri(texture->target, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-		glTexParameteri(texture->target, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		fx_gl_texture_filter(renderer, texture, GL_LINEAR);
 		break;
 	case WLR_SCALE_FILTER_NEAREST:
 		abort();
 	}
 
-	glUniform1i(shader.tex, 0);
-	glUniform1f(shader.noise, blur_data->noise);
-	glUniform1f(shader.brightness, blur_data->brightness);
-	glUniform1f(shader.contrast, blur_data->contrast);
-	glUniform1f(shader.saturation, blur_data->saturation);
+	uniform_1i_set(renderer, &shader->uniforms, shader->tex, 0);
+	uniform_1f_set(renderer, &shader->uniforms, shader->alpha,
+		wlr_render_texture_options_get_alpha(options));
+	uniform_1f_set(renderer, &shader->uniforms, shader->noise, blur_data->noise);
+	uniform_1f_set(renderer, &shader->uniforms, shader->brightness, blur_data->brightness);
+	uniform_1f_set(renderer, &shader->uniforms, shader->contrast, blur_data->contrast);
+	uniform_1f_set(renderer, &shader->uniforms, shader->saturation, blur_data->saturation);
 
-	set_proj_matrix(shader.proj, pass->projection_matrix, &dst_box);
-	set_tex_matrix(shader.tex_proj, options->transform, &src_fbox);
+	set_proj_matrix(renderer, &shader->uniforms, shader->proj, pass->projection_matrix, &dst_box);
+	set_tex_matrix(renderer, &shader->uniforms, shader->tex_proj, options->transform, &src_fbox);
 
-	render(&dst_box, options->clip, shader.pos_attrib);
-
-	glBindTexture(texture->target, 0);
+	render(renderer, &dst_box, options->clip, shader->pos_attrib);
 
 	pop_fx_debug(renderer);
 	TRACY_BOTH_ZONES_END;
 
-	wlr_texture_destroy(options->texture);
+	pass_buffer_texture_release(pass, fx_options->current_buffer, options->texture);
 }
 
-// Blurs the fx_options current_buffer content and returns the blurred framebuffer.
-// Returns NULL when the blur parameters reach 0.
-static struct fx_framebuffer *get_main_buffer_blur(struct fx_gles_render_pass *pass,
-		struct fx_render_blur_pass_options *fx_options) {
-	if (pass->fx_offscreen_buffers == NULL) {
-		wlr_log(WLR_ERROR, "FX Pass offscreen buffers not initialized. Skipping getting blur...");
-		return NULL;
+/**
+ * Creates the downsampled levels which a blur with num_passes goes through
+ * and drops the deeper ones, so that only the configured depth takes up
+ * memory. The blur shaders don't use the stencil test, neither do the levels.
+ */
+static bool blur_levels_ensure(struct fx_gles_render_pass *pass, int num_passes) {
+	struct fx_offscreen_buffers *fbos = pass->fx_offscreen_buffers;
+	struct fx_renderer *renderer = pass->buffer->renderer;
+	const int width = pass->buffer->buffer->width;
+	const int height = pass->buffer->buffer->height;
+
+	bool failed = false;
+	for (int i = 0; i < FX_OFFSCREEN_BLUR_LEVELS; i++) {
+		if (i >= num_passes) {
+			// The texture keeps the buffer until it's updated below
+			if (fbos->blur_levels[i] != NULL) {
+				wlr_buffer_drop(fbos->blur_levels[i]->buffer);
+				fbos->blur_levels[i] = NULL;
+			}
+			continue;
+		}
+		// Rounded up, so that every level covers the whole output
+		int shift = i + 1;
+		int level_width = (width + (1 << shift) - 1) >> shift;
+		int level_height = (height + (1 << shift) - 1) >> shift;
+		fx_framebuffer_get_or_create_custom(renderer, fbos->output->allocator,
+				level_width, level_height, true, false,
+				&fbos->blur_levels[i], &failed);
 	}
 
+	if (failed || !fx_offscreen_buffers_update_textures(fbos)) {
+		wlr_log(WLR_ERROR, "Failed to create the blur levels");
+		fx_framebuffer_bind(pass->buffer);
+		return false;
+	}
+	return true;
+}
+
+/**
+ * Blurs the fx_options current_buffer content with the given blur data and
+ * returns the blurred framebuffer. The blur levels must already exist for
+ * the passes of the blur data, see blur_levels_ensure.
+ *
+ * The blur lands in target if it's set. If level is set,
+ * the blur is also drawn into it without the blur effects, at the size of
+ * blur_levels[0], see optimized_blur_levels_build.
+ */
+static struct fx_framebuffer *render_blur_chain(struct fx_gles_render_pass *pass,
+		struct fx_render_blur_pass_options *fx_options, struct blur_data *blur_data,
+		struct fx_framebuffer *level, struct fx_framebuffer *target) {
 	struct fx_renderer *renderer = pass->buffer->renderer;
 	struct wlr_box buffer_bounds = {
 		0, 0,
 		fx_options->current_buffer->buffer->width, fx_options->current_buffer->buffer->height
 	};
-
-	// We don't want to affect the reference blur_data
-	struct blur_data blur_data = blur_data_apply_strength(fx_options->blur_data, fx_options->blur_strength);
-	if (fx_options->blur_strength <= 0 || !is_scene_blur_enabled(&blur_data)) {
-		return NULL;
-	}
-	fx_options->blur_data = &blur_data;
+	fx_options->blur_data = blur_data;
 
 	pixman_region32_t damage;
 	pixman_region32_init(&damage);
@@ -1001,7 +1711,7 @@ static struct fx_framebuffer *get_main_buffer_blur(struct fx_gles_render_pass *p
 	wlr_region_transform(&damage, &damage, fx_options->tex_options.base.transform,
 			buffer_bounds.width, buffer_bounds.height);
 
-	wlr_region_expand(&damage, &damage, blur_data_calc_size(&blur_data));
+	wlr_region_expand(&damage, &damage, blur_data_calc_size(blur_data));
 	// Make sure that the region doesn't expand past the buffer bounds
 	pixman_region32_intersect_rect(&damage, &damage,
 			0, 0, buffer_bounds.width, buffer_bounds.height);
@@ -1053,44 +1763,53 @@ static struct fx_framebuffer *get_main_buffer_blur(struct fx_gles_render_pass *p
 	TRACY_ZONE_TEXT_f("\tSaturation: %f", fx_options->blur_data->saturation);
 	push_fx_debug(renderer);
 
-	// Downscale
-	for (int i = 0; i < blur_data.num_passes; ++i) {
+	struct fx_offscreen_buffers *fbos = pass->fx_offscreen_buffers;
+	int num_passes = blur_data->num_passes;
+	if (num_passes > FX_OFFSCREEN_BLUR_LEVELS) {
+		num_passes = FX_OFFSCREEN_BLUR_LEVELS;
+	}
+
+	// Downscale, each pass into the next smaller level
+	for (int i = 0; i < num_passes; ++i) {
 		wlr_region_scale(&scaled_damage, &damage, 1.0f / (1 << (i + 1)));
-		render_blur_segments(pass, fx_options, &renderer->shaders.blur1);
+		render_blur_segments(pass, fx_options, &renderer->shaders.blur1,
+			fbos->blur_levels[i]);
 	}
 
-	// Upscale
-	for (int i = blur_data.num_passes - 1; i >= 0; --i) {
+	// Upscale back up the levels
+	for (int i = num_passes - 1; i > 0; --i) {
 		// when upsampling we make the region twice as big
 		wlr_region_scale(&scaled_damage, &damage, 1.0f / (1 << i));
-		render_blur_segments(pass, fx_options, &renderer->shaders.blur2);
+		render_blur_segments(pass, fx_options, &renderer->shaders.blur2,
+			fbos->blur_levels[i - 1]);
 	}
 
-	pixman_region32_fini(&scaled_damage);
+	// The optimized blur levels are upsampled from the same level as the
+	// full size blur, but at half the size and without the effects
+	struct fx_framebuffer *last_level = fx_options->current_buffer;
+	if (level != NULL) {
+		wlr_region_scale(&scaled_damage, &damage, 0.5f);
+		render_blur_segments(pass, fx_options, &renderer->shaders.blur2, level);
+	}
 
-	// Render additional blur effects like saturation, noise, contrast, etc...
-	if (blur_data_should_parameters_blur_effects(&blur_data)
-			&& pixman_region32_not_empty(&damage)) {
-		if (fx_options->current_buffer == pass->fx_offscreen_buffers->effects_buffer) {
-			fx_framebuffer_bind(pass->fx_offscreen_buffers->effects_buffer_swapped);
-		} else {
-			fx_framebuffer_bind(pass->fx_offscreen_buffers->effects_buffer);
-		}
-		fx_options->tex_options.base.clip = &damage;
-		fx_options->tex_options.base.texture = fx_texture_from_buffer(
-				&renderer->wlr_renderer, fx_options->current_buffer->buffer);
-		render_blur_effects(pass, fx_options);
-		if (fx_options->current_buffer != pass->fx_offscreen_buffers->effects_buffer) {
-			fx_options->current_buffer = pass->fx_offscreen_buffers->effects_buffer;
-		} else {
-			fx_options->current_buffer = pass->fx_offscreen_buffers->effects_buffer_swapped;
-		}
+	// The last pass lands in the full size target and renders additional
+	// blur effects like saturation, noise, contrast, etc... on the way
+	if (target != NULL) {
+		fx_options->current_buffer = last_level;
+		pixman_region32_copy(&scaled_damage, &damage);
+		struct blur_shader *shader =
+			blur_data_should_parameters_blur_effects(blur_data)
+			? &renderer->shaders.blur2_effects
+			: &renderer->shaders.blur2;
+		render_blur_segments(pass, fx_options, shader, target);
 	}
 
+	pixman_region32_fini(&scaled_damage);
 	pixman_region32_fini(&damage);
 
-	// Bind back to the default buffer
+	// Bind back to the default buffer, the levels are smaller
 	fx_framebuffer_bind(pass->buffer);
+	glViewport(0, 0, pass->buffer->buffer->width, pass->buffer->buffer->height);
 
 	pop_fx_debug(renderer);
 	TRACY_BOTH_ZONES_END;
@@ -1098,6 +1817,274 @@ static struct fx_framebuffer *get_main_buffer_blur(struct fx_gles_render_pass *p
 	return fx_options->current_buffer;
 }
 
+// Blurs the fx_options current_buffer content into the effects buffer, or
+// into the optimized blur buffer if optimized is set, and returns the blurred
+// framebuffer. Returns NULL when the blur parameters reach 0. If level is set,
+// the blur is also kept there as an optimized blur level, see
+// render_blur_chain.
+static struct fx_framebuffer *get_main_buffer_blur(struct fx_gles_render_pass *pass,
+		struct fx_render_blur_pass_options *fx_options, struct fx_framebuffer *level,
+		bool optimized) {
+	if (pass->fx_offscreen_buffers == NULL) {
+		wlr_log(WLR_ERROR, "FX Pass offscreen buffers not initialized. Skipping getting blur...");
+		return NULL;
+	}
+
+	struct fx_renderer *renderer = pass->buffer->renderer;
+	if (!fx_renderer_link_programs(renderer, FX_RENDERER_PROGRAMS_BLUR)) {
+		return NULL;
+	}
+
+	// We don't want to affect the reference blur_data
+	struct blur_data blur_data = blur_data_apply_strength(fx_options->blur_data, fx_options->blur_strength);
+	if (fx_options->blur_strength <= 0 || !is_scene_blur_enabled(&blur_data)) {
+		return NULL;
+	}
+	if (fx_options->current_buffer == NULL) {
+		return NULL;
+	}
+
+	struct fx_offscreen_buffers *fbos = pass->fx_offscreen_buffers;
+	struct fx_framebuffer **target = optimized
+		? &fbos->optimized_blur_buffer : &fbos->effects_buffer;
+	// Sized for the reference blur data, weaker blurs use fewer levels
+	if (!offscreen_buffer_ensure(pass, target, !optimized) ||
+			!blur_levels_ensure(pass, fx_options->blur_data->num_passes)) {
+		return NULL;
+	}
+	return render_blur_chain(pass, fx_options, &blur_data, level, *target);
+}
+
+/**
+ * Creates the first num_passes optimized blur levels and drops the others.
+ * Blurred content doesn't need the full resolution, the levels have the size
+ * of blur_levels[0].
+ */
+static bool optimized_blur_levels_ensure(struct fx_gles_render_pass *pass,
+		int num_passes) {
+	struct fx_offscreen_buffers *fbos = pass->fx_offscreen_buffers;
+	struct fx_renderer *renderer = pass->buffer->renderer;
+	const int width = (pass->buffer->buffer->width + 1) >> 1;
+	const int height = (pass->buffer->buffer->height + 1) >> 1;
+
+	bool failed = false;
+	for (int i = 0; i < FX_OFFSCREEN_BLUR_LEVELS; i++) {
+		if (i >= num_passes) {
+			// The texture keeps the buffer until it's updated below
+			if (fbos->optimized_blur_levels[i] != NULL) {
+				wlr_buffer_drop(fbos->optimized_blur_levels[i]->buffer);
+				fbos->optimized_blur_levels[i] = NULL;
+			}
+			continue;
+		}
+		fx_framebuffer_get_or_create_custom(renderer, fbos->output->allocator,
+				width, height, true, false, &fbos->optimized_blur_levels[i], &failed);
+	}
+
+	if (failed || !fx_offscreen_buffers_update_textures(fbos)) {
+		wlr_log(WLR_ERROR, "Failed to create optimized blur levels");
+		fx_framebuffer_bind(pass->buffer);
+		return false;
+	}
+	return true;
+}
+
+/**
+ * Invalidates the optimized blur levels before the optimized blur is
+ * re-rendered. Returns the level which the re-render should keep its blur
+ * in, so that it doesn't need its own blur once the levels are built again.
+ * If no lower strength was drawn since the last re-render, the levels are
+ * dropped and NULL is returned.
+ */
+static struct fx_framebuffer *optimized_blur_levels_invalidate(
+		struct fx_gles_render_pass *pass,
+		struct fx_render_blur_pass_options *fx_options) {
+	struct fx_offscreen_buffers *fbos = pass->fx_offscreen_buffers;
+	fbos->optimized_blur_passes = 0;
+	fbos->optimized_blur_top_passes = 0;
+
+	const bool used = fbos->optimized_blur_levels_used;
+	fbos->optimized_blur_levels_used = false;
+	if (!used) {
+		optimized_blur_levels_ensure(pass, 0);
+		return NULL;
+	}
+
+	// Weaker optimized blurs don't go through all levels
+	int num_passes = fx_options->blur_data->num_passes;
+	if (num_passes > FX_OFFSCREEN_BLUR_LEVELS) {
+		num_passes = FX_OFFSCREEN_BLUR_LEVELS;
+	}
+	if (fx_options->blur_strength < 1.0f || num_passes <= 0 ||
+			!optimized_blur_levels_ensure(pass, num_passes)) {
+		return NULL;
+	}
+	return fbos->optimized_blur_levels[num_passes - 1];
+}
+
+/**
+ * Blurs the saved backdrop of the optimized blur with each number of passes
+ * up to the one of the blur data, so that lower blur strengths can be drawn
+ * by blending between them instead of blurring again. The top level is
+ * skipped if the last re-render kept it.
+ */
+static bool optimized_blur_levels_build(struct fx_gles_render_pass *pass,
+		struct fx_render_blur_pass_options *fx_options, int num_passes) {
+	struct fx_offscreen_buffers *fbos = pass->fx_offscreen_buffers;
+	struct fx_renderer *renderer = pass->buffer->renderer;
+	struct blur_data *ref_blur_data = fx_options->blur_data;
+	if (fbos->optimized_no_blur_buffer == NULL ||
+			!fx_renderer_link_programs(renderer, FX_RENDERER_PROGRAMS_BLUR) ||
+			!blur_levels_ensure(pass, ref_blur_data->num_passes) ||
+			!optimized_blur_levels_ensure(pass, num_passes)) {
+		return false;
+	}
+
+	int count = num_passes;
+	if (fbos->optimized_blur_top_passes == num_passes &&
+			fbos->optimized_blur_radius == ref_blur_data->radius) {
+		count--;
+	}
+
+	// The blur effects are applied when blending, for the drawn strength
+	struct blur_data blur_data = *ref_blur_data;
+	blur_data.brightness = 1.0f;
+	blur_data.contrast = 1.0f;
+	blur_data.saturation = 1.0f;
+	blur_data.noise = 0.0f;
+
+	// The saved backdrop is in buffer coordinates
+	pixman_region32_t clip;
+	pixman_region32_init_rect(&clip, 0, 0,
+		pass->buffer->buffer->width, pass->buffer->buffer->height);
+	for (int i = 0; i < count; i++) {
+		blur_data.num_passes = i + 1;
+		struct fx_render_blur_pass_options blur_options = *fx_options;
+		blur_options.blur_strength = 1.0f;
+		blur_options.current_buffer = fbos->optimized_no_blur_buffer;
+		blur_options.tex_options.base.clip = &clip;
+		blur_options.tex_options.base.transform = WL_OUTPUT_TRANSFORM_NORMAL;
+		render_blur_chain(pass, &blur_options, &blur_data,
+			fbos->optimized_blur_levels[i], NULL);
+	}
+	pixman_region32_fini(&clip);
+
+	fbos->optimized_blur_passes = num_passes;
+	fbos->optimized_blur_radius = ref_blur_data->radius;
+	// The top level is one of the built levels now
+	fbos->optimized_blur_top_passes = 0;
+	return true;
+}
+
+/**
+ * Draws a level kept by optimized_blur_levels_build over the bound buffer
+ * with the given alpha, the first level replaces the content. The blur
+ * effects are affine, so they can be applied to each level instead of to the
+ * blend of them, which saves a pass and a full size buffer.
+ */
+static void blend_optimized_blur_level(struct fx_gles_render_pass *pass,
+		struct fx_render_blur_pass_options *fx_options,
+		struct blur_data *blur_data, struct wlr_texture *texture, float alpha,
+		bool effects) {
+	struct wlr_render_texture_options options = {
+		.texture = texture,
+		.clip = fx_options->tex_options.base.clip,
+		.dst_box = {
+			.width = pass->buffer->buffer->width,
+			.height = pass->buffer->buffer->height,
+		},
+		.alpha = &alpha,
+		.transform = WL_OUTPUT_TRANSFORM_NORMAL,
+		.blend_mode = alpha < 1.0f
+			? WLR_RENDER_BLEND_MODE_PREMULTIPLIED
+			: WLR_RENDER_BLEND_MODE_NONE,
+		.filter_mode = WLR_SCALE_FILTER_BILINEAR,
+	};
+	if (!effects) {
+		fx_render_pass_add_texture(pass, &(struct fx_render_texture_options){
+			.base = options,
+		});
+		return;
+	}
+
+	struct fx_render_blur_pass_options effects_options = *fx_options;
+	effects_options.blur_data = blur_data;
+	effects_options.tex_options.base = options;
+	// The texture is kept by the offscreen buffers, so render_blur_effects
+	// doesn't release it
+	effects_options.current_buffer = fx_get_texture(texture)->buffer;
+	render_blur_effects(pass, &effects_options);
+}
+
+/**
+ * Draws the optimized blur at a lower strength into an effects buffer, by
+ * blending between the two levels kept by optimized_blur_levels_build which
+ * are closest in blur size. Returns NULL if the levels don't match the blur
+ * data.
+ */
+static struct fx_framebuffer *blend_optimized_blur_levels(
+		struct fx_gles_render_pass *pass,
+		struct fx_render_blur_pass_options *fx_options) {
+	struct fx_offscreen_buffers *fbos = pass->fx_offscreen_buffers;
+	struct blur_data *ref_blur_data = fx_options->blur_data;
+	int num_passes = ref_blur_data->num_passes;
+	if (num_passes > FX_OFFSCREEN_BLUR_LEVELS) {
+		num_passes = FX_OFFSCREEN_BLUR_LEVELS;
+	}
+	if (fx_options->blur_strength <= 0 || !is_scene_blur_enabled(ref_blur_data)) {
+		return NULL;
+	}
+
+	// Keeps the levels around for the next re-render
+	fbos->optimized_blur_levels_used = true;
+	if ((fbos->optimized_blur_passes != num_passes ||
+			fbos->optimized_blur_radius != ref_blur_data->radius) &&
+			!optimized_blur_levels_build(pass, fx_options, num_passes)) {
+		return NULL;
+	}
+
+	// The blur size doubles with every pass. Level 0 is the unblurred
+	// backdrop, level i the one blurred with i passes.
+	float size = blur_data_calc_size(ref_blur_data) * fx_options->blur_strength;
+	int lower = 0;
+	float lower_size = 0.0f;
+	float upper_size = 4.0f * ref_blur_data->radius;
+	while (lower < num_passes && size >= upper_size) {
+		lower++;
+		lower_size = upper_size;
+		upper_size *= 2.0f;
+	}
+	int upper = lower < num_passes ? lower + 1 : lower;
+	float upper_alpha = upper != lower ?
+		(size - lower_size) / (upper_size - lower_size) : 0.0f;
+
+	struct wlr_texture *lower_texture = lower > 0
+		? fbos->optimized_blur_level_textures[lower - 1]
+		: fbos->optimized_no_blur_texture;
+	struct wlr_texture *upper_texture = fbos->optimized_blur_level_textures[upper - 1];
+	if (lower_texture == NULL || upper_texture == NULL) {
+		return NULL;
+	}
+
+	struct blur_data blur_data =
+		blur_data_apply_strength(ref_blur_data, fx_options->blur_strength);
+	const bool effects = blur_data_should_parameters_blur_effects(&blur_data);
+	if (!offscreen_buffer_ensure(pass, &fbos->effects_buffer, true)) {
+		return NULL;
+	}
+
+	fx_framebuffer_bind(fbos->effects_buffer);
+	blend_optimized_blur_level(pass, fx_options, &blur_data, lower_texture,
+		1.0f, effects);
+	if (upper_alpha > 0.0f) {
+		blend_optimized_blur_level(pass, fx_options, &blur_data, upper_texture,
+			upper_alpha, effects);
+	}
+
+	fx_framebuffer_bind(pass->buffer);
+	return fbos->effects_buffer;
+}
+
 void fx_render_pass_add_blur(struct fx_gles_render_pass *pass,
 		struct fx_render_blur_pass_options *fx_options) {
 	if (pass->fx_offscreen_buffers == NULL) {
@@ -1107,6 +2094,7 @@ void fx_render_pass_add_blur(struct fx_gles_render_pass *pass,
 
 	struct fx_renderer *renderer = pass->buffer->renderer;
 	struct fx_render_texture_options *tex_options = &fx_options->tex_options;
+	batch_flush(renderer);
 
 	TRACY_BOTH_ZONES_START(renderer);
 	push_fx_debug(renderer);
@@ -1116,44 +2104,60 @@ void fx_render_pass_add_blur(struct fx_gles_render_pass *pass,
 	TRACY_ZONE_TEXT_f("Use Optimized Blur: %d", fx_options->use_optimized_blur);
 	TRACY_ZONE_TEXT_f("Optimized Blur Successfully Used: %d",
 			buffer && fx_options->use_optimized_blur);
-	if (!fx_options->use_optimized_blur || has_strength) {
+	TRACY_ZONE_TEXT_f("Shared Blur Used: %d", fx_options->blurred_buffer != NULL);
+	TRACY_ZONE_TEXT_f("Cached Blur Used: %d", fx_options->blur_cache != NULL);
+	struct wlr_box blur_box = {0};
+	struct wlr_texture *wlr_texture = NULL;
+	if (fx_options->blur_cache != NULL) {
+		buffer = fx_options->blur_cache->buffer;
+		blur_box = fx_options->blur_cache->box;
+		wlr_texture = fx_options->blur_cache->texture;
+	} else if (fx_options->blurred_buffer != NULL) {
+		buffer = fx_options->blurred_buffer;
+	} else if (!fx_options->use_optimized_blur || has_strength) {
 		// Render the blur into its own buffer
 		struct fx_render_blur_pass_options blur_options = *fx_options;
 		if (fx_options->use_optimized_blur && has_strength) {
-			// Re-blur the saved non-blurred version of the optimized blur.
-			// Isn't as efficient as just using the optimized blur buffer
-			blur_options.current_buffer = pass->fx_offscreen_buffers->optimized_no_blur_buffer;
+			buffer = blend_optimized_blur_levels(pass, &blur_options);
+			if (buffer == NULL) {
+				// Re-blur the saved non-blurred version of the optimized
+				// blur. Isn't as efficient as blending the kept levels.
+				blur_options.current_buffer =
+					pass->fx_offscreen_buffers->optimized_no_blur_buffer;
+				buffer = get_main_buffer_blur(pass, &blur_options, NULL, false);
+			}
 		} else {
 			blur_options.current_buffer = pass->buffer;
+			buffer = get_main_buffer_blur(pass, &blur_options, NULL, false);
 		}
-		buffer = get_main_buffer_blur(pass, &blur_options);
 	}
 	if (!buffer) {
 		goto finish;
 	}
-	struct wlr_texture *wlr_texture =
-		fx_texture_from_buffer(&renderer->wlr_renderer, buffer->buffer);
+	if (wlr_texture == NULL) {
+		wlr_texture = pass_buffer_texture(pass, buffer);
+		if (wlr_texture == NULL) {
+			goto finish;
+		}
+		blur_box.width = buffer->buffer->width;
+		blur_box.height = buffer->buffer->height;
+	}
 	struct fx_texture *blur_texture = fx_get_texture(wlr_texture);
 
 	// Get a stencil of the window ignoring transparent regions
 	if (fx_options->ignore_transparent && fx_options->tex_options.base.texture) {
-		stencil_mask_init();
+		stencil_mask_init(renderer);
 
 		struct fx_render_texture_options tex_options = fx_options->tex_options;
 		tex_options.discard_transparent = true;
 		tex_options.clipped_region = fx_options->clipped_region;
 		fx_render_pass_add_texture(pass, &tex_options);
 
-		stencil_mask_close(true);
+		stencil_mask_close(renderer, true);
 	}
 
 	// Draw the blurred texture
-	tex_options->base.dst_box = (struct wlr_box) {
-		.x = 0,
-		.y = 0,
-		.width = buffer->buffer->width,
-		.height = buffer->buffer->height,
-	};
+	tex_options->base.dst_box = blur_box;
 	tex_options->base.src_box = (struct wlr_fbox) {
 		.x = 0,
 		.y = 0,
@@ -1166,11 +2170,13 @@ void fx_render_pass_add_blur(struct fx_gles_render_pass *pass,
 	tex_options->clipped_region = fx_options->clipped_region;
 	fx_render_pass_add_texture(pass, tex_options);
 
-	wlr_texture_destroy(&blur_texture->wlr_texture);
+	if (fx_options->blur_cache == NULL) {
+		pass_buffer_texture_release(pass, buffer, wlr_texture);
+	}
 
 	// Finish stenciling
 	if (fx_options->ignore_transparent && fx_options->tex_options.base.texture) {
-		stencil_mask_fini();
+		stencil_mask_fini(renderer);
 	}
 
 finish:
@@ -1178,6 +2184,77 @@ finish:
 	TRACY_BOTH_ZONES_END;
 }
 
+struct fx_framebuffer *fx_render_pass_blur_backdrop(struct fx_gles_render_pass *pass,
+		struct fx_render_blur_pass_options *fx_options) {
+	if (pass->fx_offscreen_buffers == NULL) {
+		wlr_log(WLR_ERROR, "FX Pass offscreen buffers not initialized. Skipping blur...");
+		return NULL;
+	}
+	batch_flush(pass->buffer->renderer);
+
+	struct fx_render_blur_pass_options blur_options = *fx_options;
+	if (fx_options->use_optimized_blur) {
+		blur_options.current_buffer = pass->fx_offscreen_buffers->optimized_no_blur_buffer;
+	} else {
+		blur_options.current_buffer = pass->buffer;
+	}
+	return get_main_buffer_blur(pass, &blur_options, NULL, false);
+}
+
+bool fx_render_pass_save_blur(struct fx_gles_render_pass *pass,
+		struct wlr_allocator *allocator, struct fx_blur_cache *cache,
+		const struct wlr_box *box, struct fx_framebuffer *blurred,
+		const pixman_region32_t *region) {
+	struct fx_renderer *renderer = pass->buffer->renderer;
+	batch_flush(renderer);
+
+	// The texture locks the buffer, drop both before replacing the buffer
+	if (cache->buffer != NULL && (cache->buffer->buffer->width != box->width
+			|| cache->buffer->buffer->height != box->height)) {
+		fx_blur_cache_finish(cache);
+	}
+
+	bool failed = false;
+	fx_framebuffer_get_or_create_custom(renderer, allocator, box->width, box->height,
+			true, false, &cache->buffer, &failed);
+	if (failed) {
+		fx_blur_cache_finish(cache);
+		fx_framebuffer_bind(pass->buffer);
+		return false;
+	}
+	if (cache->texture == NULL) {
+		cache->texture = fx_texture_from_buffer(&renderer->wlr_renderer,
+			cache->buffer->buffer);
+		if (cache->texture == NULL) {
+			wlr_log(WLR_ERROR, "Failed to import the blur cache buffer");
+			fx_blur_cache_finish(cache);
+			fx_framebuffer_bind(pass->buffer);
+			return false;
+		}
+	}
+	cache->box = *box;
+
+	TRACY_BOTH_ZONES_START(renderer);
+	push_fx_debug(renderer);
+
+	bool ok = render_buffer_to_box(pass, blurred, cache->buffer, box, region);
+	fx_framebuffer_bind(pass->buffer);
+
+	pop_fx_debug(renderer);
+	TRACY_BOTH_ZONES_END;
+	return ok;
+}
+
+void fx_blur_cache_finish(struct fx_blur_cache *cache) {
+	if (cache->texture != NULL) {
+		wlr_texture_destroy(cache->texture);
+	}
+	if (cache->buffer != NULL) {
+		wlr_buffer_drop(cache->buffer->buffer);
+	}
+	*cache = (struct fx_blur_cache){0};
+}
+
 bool fx_render_pass_add_optimized_blur(struct fx_gles_render_pass *pass,
 		struct fx_render_blur_pass_options *fx_options) {
 	if (pass->fx_offscreen_buffers == NULL) {
@@ -1185,6 +2262,7 @@ bool fx_render_pass_add_optimized_blur(struct fx_gles_render_pass *pass,
 		return false;
 	}
 	struct fx_renderer *renderer = pass->buffer->renderer;
+	batch_flush(renderer);
 	struct wlr_box dst_box = fx_options->tex_options.base.dst_box;
 
 	TRACY_BOTH_ZONES_START(renderer);
@@ -1223,15 +2301,27 @@ bool fx_render_pass_add_optimized_blur(struct fx_gles_render_pass *pass,
 	struct fx_render_blur_pass_options blur_options = *fx_options;
 	blur_options.current_buffer = pass->buffer;
 	blur_options.tex_options.base.clip = &clip;
-	struct fx_framebuffer *fx_buffer = get_main_buffer_blur(pass, &blur_options);
+	struct fx_offscreen_buffers *fbos = pass->fx_offscreen_buffers;
+	struct fx_framebuffer *top_level = optimized_blur_levels_invalidate(pass, fx_options);
+	// The blur lands in the optimized blur buffer directly
+	struct fx_framebuffer *fx_buffer =
+		get_main_buffer_blur(pass, &blur_options, top_level, true);
+	if (fx_buffer != NULL &&
+			!offscreen_buffer_ensure(pass, &fbos->optimized_no_blur_buffer, false)) {
+		fx_buffer = NULL;
+	}
 	if (fx_buffer != NULL) {
-		// Render the newly blurred content into the blur_buffer
-		fx_render_pass_read_to_buffer(pass, &clip,
-				pass->fx_offscreen_buffers->optimized_blur_buffer, fx_buffer);
-
 		// Save the current scene pass state
 		fx_render_pass_read_to_buffer(pass, &clip,
-				pass->fx_offscreen_buffers->optimized_no_blur_buffer, pass->buffer);
+				fbos->optimized_no_blur_buffer, pass->buffer);
+
+		if (top_level != NULL) {
+			fbos->optimized_blur_top_passes = fx_options->blur_data->num_passes;
+			if (fbos->optimized_blur_top_passes > FX_OFFSCREEN_BLUR_LEVELS) {
+				fbos->optimized_blur_top_passes = FX_OFFSCREEN_BLUR_LEVELS;
+			}
+			fbos->optimized_blur_radius = fx_options->blur_data->radius;
+		}
 	}
 
 	pixman_region32_fini(&clip);
@@ -1247,14 +2337,14 @@ void fx_render_pass_read_to_buffer(struct fx_gles_render_pass *pass,
 	if (!_region || !pixman_region32_not_empty(_region)) {
 		return;
 	}
+	batch_flush(pass->buffer->renderer);
 	TRACY_BOTH_ZONES_START(pass->buffer->renderer);
 
 	pixman_region32_t region;
 	pixman_region32_init(&region);
 	pixman_region32_copy(&region, _region);
 
-	struct wlr_texture *src_tex =
-		fx_texture_from_buffer(&pass->buffer->renderer->wlr_renderer, src_buffer->buffer);
+	struct wlr_texture *src_tex = pass_buffer_texture(pass, src_buffer);
 	if (src_tex == NULL) {
 		goto done;
 	}
@@ -1279,7 +2369,7 @@ void fx_render_pass_read_to_buffer(struct fx_gles_render_pass *pass,
 			.height = src_buffer->buffer->height,
 		},
 	});
-	wlr_texture_destroy(src_tex);
+	pass_buffer_texture_release(pass, src_buffer, src_tex);
 
 	// Bind back to the main WLR buffer
 	fx_framebuffer_bind(pass->buffer);
@@ -1318,6 +2408,14 @@ struct fx_gles_render_pass *fx_begin_buffer_pass(struct fx_framebuffer *buffer,
 		}
 	}
 
+	// Rects of a parent pass have to land in its framebuffer, which is
+	// still bound
+	batch_flush(renderer);
+
+	// The context may have been used outside of the renderer since the last
+	// pass, e.g. with the FBO from fx_renderer_get_buffer_fbo
+	fx_gl_state_invalidate(&renderer->gl_state);
+
 	GLint fbo = fx_framebuffer_get_fbo(buffer);
 	if (!fbo) {
 		return NULL;
@@ -1341,15 +2439,19 @@ struct fx_gles_render_pass *fx_begin_buffer_pass(struct fx_framebuffer *buffer,
 	pass->fx_offscreen_buffers = NULL;
 	pixman_region32_init(&pass->blur_padding_region);
 	pass->has_blur = false;
+	pass->draw_calls_start = renderer->stats.draw_calls;
+	pass->state_calls_skipped_start = renderer->stats.state_calls_skipped;
+	pass->uniform_calls_skipped_start = renderer->stats.uniform_calls_skipped;
+	pass->textures_created_start = renderer->stats.textures_created;
 
 	matrix_projection(pass->projection_matrix, wlr_buffer->width, wlr_buffer->height,
 		WL_OUTPUT_TRANSFORM_FLIPPED_180);
 
 	push_fx_debug(renderer);
-	glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+	fx_gl_bind_framebuffer(renderer, fbo);
 
 	glViewport(0, 0, wlr_buffer->width, wlr_buffer->height);
-	glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+	fx_gl_blend_func(renderer, GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
 	glDisable(GL_SCISSOR_TEST);
 
 	pop_fx_debug(renderer);
@@ -0,0 +1,389 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <wlr/util/log.h>
+
+#include "render/fx_renderer/fx_renderer.h"
+#include "util/env.h"
+
+#define PROGRAM_CACHE_MAGIC "SFXPROG2"
+
+#ifndef GL_COMPLETION_STATUS_KHR
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
+
+struct pending_program {
+	uint64_t source_hash;
+	GLuint prog;
+	bool from_binary;
+};
+
+// Followed by the vertex and fragment sources the binary was linked from,
+// then by the binary itself
+struct program_binary_header {
+	char magic[8];
+	uint64_t driver_hash;
+	uint64_t source_hash;
+	uint32_t vert_len;
+	uint32_t frag_len;
+	uint32_t format;
+	uint32_t length;
+};
+
+// FNV-1a, continuing from hash
+static uint64_t hash_str(uint64_t hash, const char *str) {
+	for (const unsigned char *c = (const unsigned char *)str; *c != '\0'; c++) {
+		hash ^= *c;
+		hash *= 0x100000001b3ULL;
+	}
+	// Separator, so that ("ab", "c") and ("a", "bc") differ
+	hash ^= 0xff;
+	hash *= 0x100000001b3ULL;
+	return hash;
+}
+
+static uint64_t hash_gl_string(uint64_t hash, GLenum name) {
+	const char *str = (const char *)glGetString(name);
+	return hash_str(hash, str != NULL ? str : "");
+}
+
+// Creates the directory along with its missing parents, like mkdir -p
+static bool mkdir_if_missing(const char *path) {
+	char buf[PATH_MAX];
+	if (snprintf(buf, sizeof(buf), "%s", path) >= (int)sizeof(buf)) {
+		return false;
+	}
+
+	for (char *sep = strchr(buf + 1, '/'); ; sep = strchr(sep + 1, '/')) {
+		if (sep != NULL) {
+			*sep = '\0';
+		}
+		if (mkdir(buf, 0700) != 0 && errno != EEXIST) {
+			wlr_log_errno(WLR_DEBUG, "Failed to create %s", buf);
+			return false;
+		}
+		if (sep == NULL) {
+			return true;
+		}
+		*sep = '/';
+	}
+}
+
+static char *get_cache_dir(void) {
+	char base[PATH_MAX];
+	const char *xdg_cache_home = getenv("XDG_CACHE_HOME");
+	const char *home = getenv("HOME");
+	if (xdg_cache_home != NULL && xdg_cache_home[0] == '/') {
+		snprintf(base, sizeof(base), "%s", xdg_cache_home);
+	} else if (home != NULL) {
+		snprintf(base, sizeof(base), "%s/.cache", home);
+	} else {
+		return NULL;
+	}
+
+	char path[PATH_MAX];
+	snprintf(path, sizeof(path), "%s/scenefx/programs", base);
+	if (!mkdir_if_missing(path)) {
+		return NULL;
+	}
+
+	return strdup(path);
+}
+
+void fx_program_cache_init(struct fx_program_cache *cache, const char *exts_str) {
+	*cache = (struct fx_program_cache){0};
+
+	if (env_parse_bool("WLR_RENDERER_DISABLE_PROGRAM_CACHE")) {
+		wlr_log(WLR_INFO, "Program binary cache disabled");
+		return;
+	}
+	if (!check_gl_ext(exts_str, "GL_OES_get_program_binary")) {
+		wlr_log(WLR_DEBUG, "GL_OES_get_program_binary not supported, "
+			"program binary cache disabled");
+		return;
+	}
+
+	GLint formats = 0;
+	glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS_OES, &formats);
+	if (formats <= 0) {
+		wlr_log(WLR_DEBUG, "No program binary formats supported, "
+			"program binary cache disabled");
+		return;
+	}
+
+	cache->dir = get_cache_dir();
+	if (cache->dir == NULL) {
+		wlr_log(WLR_INFO, "No usable cache directory, "
+			"program binary cache disabled");
+		return;
+	}
+
+	load_gl_proc(&cache->procs.glGetProgramBinaryOES, "glGetProgramBinaryOES");
+	load_gl_proc(&cache->procs.glProgramBinaryOES, "glProgramBinaryOES");
+
+	// Binaries are only valid for the exact driver which produced them
+	uint64_t hash = 0xcbf29ce484222325ULL;
+	hash = hash_gl_string(hash, GL_VENDOR);
+	hash = hash_gl_string(hash, GL_RENDERER);
+	hash = hash_gl_string(hash, GL_VERSION);
+	hash = hash_str(hash, SCENEFX_VERSION);
+	cache->driver_hash = hash;
+
+	cache->enabled = true;
+	wlr_log(WLR_DEBUG, "Using program binary cache in %s", cache->dir);
+}
+
+void fx_program_cache_finish(struct fx_program_cache *cache) {
+	struct pending_program *pending;
+	wl_array_for_each(pending, &cache->pending) {
+		glDeleteProgram(pending->prog);
+	}
+	wl_array_release(&cache->pending);
+	free(cache->dir);
+	*cache = (struct fx_program_cache){0};
+}
+
+static uint64_t source_hash(const GLchar *vert_src, const GLchar *frag_src) {
+	uint64_t hash = 0xcbf29ce484222325ULL;
+	hash = hash_str(hash, vert_src);
+	hash = hash_str(hash, frag_src);
+	return hash;
+}
+
+static void get_program_path(struct fx_program_cache *cache, uint64_t hash,
+		char *path, size_t path_len) {
+	snprintf(path, path_len, "%s/%016llx.bin", cache->dir,
+		(unsigned long long)hash);
+}
+
+static bool read_full(int fd, void *data, size_t len) {
+	char *ptr = data;
+	while (len > 0) {
+		ssize_t n = read(fd, ptr, len);
+		if (n < 0 && errno == EINTR) {
+			continue;
+		} else if (n <= 0) {
+			return false;
+		}
+		ptr += n;
+		len -= n;
+	}
+	return true;
+}
+
+static bool write_full(int fd, const void *data, size_t len) {
+	const char *ptr = data;
+	while (len > 0) {
+		ssize_t n = write(fd, ptr, len);
+		if (n < 0 && errno == EINTR) {
+			continue;
+		} else if (n <= 0) {
+			return false;
+		}
+		ptr += n;
+		len -= n;
+	}
+	return true;
+}
+
+GLuint fx_program_cache_load(struct fx_program_cache *cache,
+		const GLchar *vert_src, const GLchar *frag_src) {
+	if (cache == NULL) {
+		return 0;
+	}
+	if (!cache->enabled) {
+		cache->misses++;
+		return 0;
+	}
+
+	uint64_t hash = source_hash(vert_src, frag_src);
+	char path[PATH_MAX];
+	get_program_path(cache, hash, path, sizeof(path));
+
+	int fd = open(path, O_RDONLY | O_CLOEXEC);
+	if (fd < 0) {
+		cache->misses++;
+		return 0;
+	}
+
+	GLuint prog = 0;
+	char *sources = NULL;
+	void *binary = NULL;
+
+	size_t vert_len = strlen(vert_src);
+	size_t frag_len = strlen(frag_src);
+	struct program_binary_header header;
+	struct stat st;
+	if (!read_full(fd, &header, sizeof(header)) || fstat(fd, &st) != 0) {
+		goto out;
+	}
+	// The hash only picks the file, the sources it holds must match
+	if (memcmp(header.magic, PROGRAM_CACHE_MAGIC, sizeof(header.magic)) != 0 ||
+			header.driver_hash != cache->driver_hash ||
+			header.source_hash != hash ||
+			header.vert_len != vert_len || header.frag_len != frag_len ||
+			header.length == 0 ||
+			(off_t)(sizeof(header) + vert_len + frag_len + header.length) != st.st_size) {
+		wlr_log(WLR_DEBUG, "Ignoring stale program binary %s", path);
+		goto out;
+	}
+
+	sources = malloc(vert_len + frag_len);
+	if (sources == NULL || !read_full(fd, sources, vert_len + frag_len)) {
+		goto out;
+	}
+	if (memcmp(sources, vert_src, vert_len) != 0 ||
+			memcmp(sources + vert_len, frag_src, frag_len) != 0) {
+		wlr_log(WLR_DEBUG, "Ignoring program binary %s of other sources", path);
+		goto out;
+	}
+
+	binary = malloc(header.length);
+	if (binary == NULL || !read_full(fd, binary, header.length)) {
+		goto out;
+	}
+
+	prog = glCreateProgram();
+	cache->procs.glProgramBinaryOES(prog, header.format, binary, header.length);
+
+	// Drivers may reject binaries at any time, e.g. after an update which
+	// didn't change the version string
+	GLint ok;
+	glGetProgramiv(prog, GL_LINK_STATUS, &ok);
+	if (ok == GL_FALSE) {
+		wlr_log(WLR_DEBUG, "Driver rejected program binary %s", path);
+		glDeleteProgram(prog);
+		prog = 0;
+	}
+
+out:
+	free(binary);
+	free(sources);
+	close(fd);
+	if (prog == 0) {
+		cache->misses++;
+	} else {
+		cache->hits++;
+	}
+	return prog;
+}
+
+void fx_program_cache_store(struct fx_program_cache *cache, GLuint prog,
+		const GLchar *vert_src, const GLchar *frag_src) {
+	if (cache == NULL || !cache->enabled) {
+		return;
+	}
+
+	GLint length = 0;
+	glGetProgramiv(prog, GL_PROGRAM_BINARY_LENGTH_OES, &length);
+	if (length <= 0) {
+		return;
+	}
+
+	void *binary = malloc(length);
+	if (binary == NULL) {
+		return;
+	}
+
+	GLsizei written = 0;
+	GLenum format = 0;
+	cache->procs.glGetProgramBinaryOES(prog, length, &written, &format, binary);
+	if (written <= 0) {
+		free(binary);
+		return;
+	}
+
+	uint64_t hash = source_hash(vert_src, frag_src);
+	size_t vert_len = strlen(vert_src);
+	size_t frag_len = strlen(frag_src);
+	struct program_binary_header header = {
+		.driver_hash = cache->driver_hash,
+		.source_hash = hash,
+		.vert_len = vert_len,
+		.frag_len = frag_len,
+		.format = format,
+		.length = written,
+	};
+	memcpy(header.magic, PROGRAM_CACHE_MAGIC, sizeof(header.magic));
+
+	char path[PATH_MAX];
+	get_program_path(cache, hash, path, sizeof(path));
+
+	// Write to a temporary file first, so that concurrently starting
+	// compositors never read a partially written binary
+	char tmp_path[PATH_MAX];
+	snprintf(tmp_path, sizeof(tmp_path), "%s.XXXXXX", path);
+	int fd = mkstemp(tmp_path);
+	if (fd < 0) {
+		wlr_log_errno(WLR_DEBUG, "Failed to create %s", tmp_path);
+		free(binary);
+		return;
+	}
+
+	bool ok = write_full(fd, &header, sizeof(header)) &&
+		write_full(fd, vert_src, vert_len) &&
+		write_full(fd, frag_src, frag_len) &&
+		write_full(fd, binary, written);
+	close(fd);
+	free(binary);
+
+	if (!ok || rename(tmp_path, path) != 0) {
+		wlr_log_errno(WLR_DEBUG, "Failed to write program binary %s", path);
+		unlink(tmp_path);
+		return;
+	}
+	cache->stores++;
+}
+
+void fx_program_cache_add_pending(struct fx_program_cache *cache, GLuint prog,
+		const GLchar *vert_src, const GLchar *frag_src, bool from_binary) {
+	struct pending_program *pending = wl_array_add(&cache->pending, sizeof(*pending));
+	if (pending == NULL) {
+		wlr_log(WLR_ERROR, "Failed to allocate pending program");
+		glDeleteProgram(prog);
+		return;
+	}
+	*pending = (struct pending_program){
+		.source_hash = source_hash(vert_src, frag_src),
+		.prog = prog,
+		.from_binary = from_binary,
+	};
+}
+
+GLuint fx_program_cache_take_pending(struct fx_program_cache *cache,
+		const GLchar *vert_src, const GLchar *frag_src, bool *from_binary) {
+	if (cache == NULL || cache->pending.size == 0) {
+		return 0;
+	}
+
+	uint64_t hash = source_hash(vert_src, frag_src);
+	struct pending_program *programs = cache->pending.data;
+	size_t len = cache->pending.size / sizeof(*programs);
+	for (size_t i = 0; i < len; i++) {
+		if (programs[i].source_hash != hash) {
+			continue;
+		}
+
+		GLuint prog = programs[i].prog;
+		if (cache->poll) {
+			// Only programs started with GL_KHR_parallel_shader_compile
+			// are pending, so the query is supported
+			GLint done = GL_FALSE;
+			glGetProgramiv(prog, GL_COMPLETION_STATUS_KHR, &done);
+			if (done == GL_FALSE) {
+				cache->busy = true;
+				return 0;
+			}
+		}
+		*from_binary = programs[i].from_binary;
+		programs[i] = programs[len - 1];
+		cache->pending.size -= sizeof(*programs);
+		return prog;
+	}
+	return 0;
+}
@@ -85,18 +85,21 @@ static inline void free_shaders(struct fx_renderer *renderer) {
 	push_fx_debug(renderer);
 	glDeleteProgram(renderer->shaders.quad.program);
 	glDeleteProgram(renderer->shaders.quad_clip.program);
-	glDeleteProgram(renderer->shaders.quad_round.program);
+	glDeleteProgram(renderer->shaders.quad_batch.program);
 	glDeleteProgram(renderer->shaders.quad_grad.program);
 	glDeleteProgram(renderer->shaders.quad_grad_round.program);
-	glDeleteProgram(renderer->shaders.tex_rgba.program);
-	glDeleteProgram(renderer->shaders.tex_rgbx.program);
-	glDeleteProgram(renderer->shaders.tex_ext.program);
-	glDeleteProgram(renderer->shaders.tex_effects_rgba.program);
-	glDeleteProgram(renderer->shaders.tex_effects_rgbx.program);
-	glDeleteProgram(renderer->shaders.tex_effects_ext.program);
-	glDeleteProgram(renderer->shaders.box_shadow.program);
+	for (size_t i = 0; i < SHADER_VARIANTS; i++) {
+		glDeleteProgram(renderer->shaders.quad_round[i].program);
+		glDeleteProgram(renderer->shaders.box_shadow[i].program);
+		for (size_t j = 0; j < 3; j++) {
+			glDeleteProgram(renderer->shaders.tex[j][i].program);
+		}
+	}
+	glDeleteProgram(renderer->shaders.quad_round_instanced.program);
+	glDeleteProgram(renderer->shaders.box_shadow_instanced.program);
 	glDeleteProgram(renderer->shaders.blur1.program);
 	glDeleteProgram(renderer->shaders.blur2.program);
+	glDeleteProgram(renderer->shaders.blur2_effects.program);
 	glDeleteProgram(renderer->shaders.blur_effects.program);
 	pop_fx_debug(renderer);
 }
@@ -124,6 +127,10 @@ static void fx_renderer_destroy(struct wlr_renderer *wlr_renderer) {
 	}
 
 	free_shaders(renderer);
+	fx_program_cache_finish(&renderer->program_cache);
+	fx_gradient_luts_finish(renderer);
+	fx_vertex_ring_finish(&renderer->vertex_ring);
+	wl_array_release(&renderer->batch.data);
 
 	if (renderer->exts.KHR_debug) {
 		glDisable(GL_DEBUG_OUTPUT_KHR);
@@ -197,6 +204,12 @@ GLuint fx_renderer_get_buffer_fbo(struct wlr_renderer *wlr_renderer,
 }
 
 
+void fx_renderer_get_stats(struct wlr_renderer *wlr_renderer,
+		struct fx_renderer_stats *stats) {
+	struct fx_renderer *renderer = fx_get_renderer(wlr_renderer);
+	*stats = renderer->stats;
+}
+
 static struct wlr_render_timer *fx_render_timer_create(struct wlr_renderer *wlr_renderer) {
 	struct fx_renderer *renderer = fx_get_renderer(wlr_renderer);
 	if (!renderer->exts.EXT_disjoint_timer_query) {
@@ -354,86 +367,455 @@ struct wlr_renderer *fx_renderer_create(struct wlr_backend *backend) {
 	return renderer_autocreate(backend, -1);
 }
 
-static bool link_shaders(struct fx_renderer *renderer) {
-	// quad fragment shader
-	if (!link_quad_program(&renderer->shaders.quad, false)) {
-		wlr_log(WLR_ERROR, "Could not link quad shader");
-		goto error;
+// Covers every variant: corner_alpha_uniform and the cutout are only
+// shortcuts of the per-corner path, and discard_transparent is a uniform
+static const struct shader_variant full_variant = {
+	.corners = SHADER_CORNERS_PER_CORNER,
+	.clip = true,
+	.discard_transparent = true,
+};
+
+// Rounded rects and shadows don't support discard_transparent
+static const struct shader_variant full_shape_variant = {
+	.corners = SHADER_CORNERS_PER_CORNER,
+	.clip = true,
+};
+
+static const struct shader_variant plain_variant = {
+	.corners = SHADER_CORNERS_NONE,
+};
+
+static struct tex_shader *tex_variant(struct fx_renderer *renderer,
+		enum fx_tex_shader_source source, const struct shader_variant *variant) {
+	assert(source >= SHADER_SOURCE_TEXTURE_RGBA &&
+		source <= SHADER_SOURCE_TEXTURE_EXTERNAL);
+	return &renderer->shaders.tex[source - 1][shader_variant_index(variant)];
+}
+
+static bool link_tex_variant(struct fx_renderer *renderer,
+		enum fx_tex_shader_source source, const struct shader_variant *variant) {
+	return link_tex_program(&renderer->program_cache,
+		tex_variant(renderer, source, variant), source, variant);
+}
+
+static struct quad_round_shader *quad_round_full(struct fx_renderer *renderer) {
+	return &renderer->shaders.quad_round[shader_variant_index(&full_shape_variant)];
+}
+
+static struct box_shadow_shader *box_shadow_full(struct fx_renderer *renderer) {
+	return &renderer->shaders.box_shadow[shader_variant_index(&full_shape_variant)];
+}
+
+// The variants most rounded windows and rects pick, with and without a
+// rounded clip
+static const struct shader_variant common_variants[] = {
+	{ .corners = SHADER_CORNERS_UNIFORM },
+	{ .corners = SHADER_CORNERS_UNIFORM, .clip = true },
+};
+
+// The variant of shadows outside of a rounded clip
+static const struct shader_variant unclipped_shape_variant = {
+	.corners = SHADER_CORNERS_PER_CORNER,
+};
+
+/**
+ * Links the common variants of the group which aren't linked yet, or only
+ * starts them in background mode. They are optional: the getters fall back
+ * to the full variants, so a failure only marks the variant.
+ */
+static void link_common_variants(struct fx_renderer *renderer,
+		enum fx_renderer_programs group) {
+	struct fx_program_cache *cache = &renderer->program_cache;
+	switch (group) {
+	case FX_RENDERER_PROGRAMS_ROUNDED:
+		for (size_t i = 0; i < sizeof(common_variants) / sizeof(common_variants[0]); i++) {
+			const struct shader_variant *variant = &common_variants[i];
+			// External textures are rarely rounded
+			for (enum fx_tex_shader_source source = SHADER_SOURCE_TEXTURE_RGBA;
+					source <= SHADER_SOURCE_TEXTURE_RGBX; source++) {
+				struct tex_shader *shader = tex_variant(renderer, source, variant);
+				if (shader->program == 0 && !shader->link_failed &&
+						!link_tex_variant(renderer, source, variant)) {
+					shader->link_failed = !cache->background;
+				}
+			}
+
+			struct quad_round_shader *shader =
+				&renderer->shaders.quad_round[shader_variant_index(variant)];
+			if (shader->program == 0 && !shader->link_failed &&
+					!link_quad_round_program(cache, shader, variant)) {
+				shader->link_failed = !cache->background;
+			}
+		}
+		break;
+	case FX_RENDERER_PROGRAMS_SHADOWS: {
+		struct box_shadow_shader *shader = &renderer->shaders.box_shadow[
+			shader_variant_index(&unclipped_shape_variant)];
+		if (shader->program == 0 && !shader->link_failed &&
+				!link_box_shadow_program(cache, shader, &unclipped_shape_variant)) {
+			shader->link_failed = !cache->background;
+		}
+		break;
 	}
+	default:
+		break;
+	}
+}
 
-	// quad clip fragment shader
-	if (!link_quad_program(&renderer->shaders.quad_clip, true)) {
-		wlr_log(WLR_ERROR, "Could not link quad clip shader");
-		goto error;
+/**
+ * Links every program of the group which isn't linked yet, along with its
+ * common variants. While the program cache is in background mode, the
+ * programs are only started and this always fails, see
+ * fx_renderer_prewarm_programs.
+ */
+static bool link_program_group(struct fx_renderer *renderer,
+		enum fx_renderer_programs group) {
+	struct fx_program_cache *cache = &renderer->program_cache;
+	link_common_variants(renderer, group);
+	// Don't stop at the first failure, so that all programs get started
+	bool ok = true;
+	switch (group) {
+	case FX_RENDERER_PROGRAMS_ROUNDED:
+		if (quad_round_full(renderer)->program == 0) {
+			ok = link_quad_round_program(cache, quad_round_full(renderer),
+				&full_shape_variant) && ok;
+		}
+		for (enum fx_tex_shader_source source = SHADER_SOURCE_TEXTURE_RGBA;
+				source <= SHADER_SOURCE_TEXTURE_EXTERNAL; source++) {
+			if (tex_variant(renderer, source, &full_variant)->program == 0) {
+				ok = link_tex_variant(renderer, source, &full_variant) && ok;
+			}
+		}
+		if (renderer->exts.instanced_arrays &&
+				renderer->shaders.quad_round_instanced.program == 0) {
+			ok = link_quad_round_instanced_program(cache,
+				&renderer->shaders.quad_round_instanced) && ok;
+		}
+		return ok;
+	case FX_RENDERER_PROGRAMS_GRADIENTS:
+		if (renderer->shaders.quad_grad.program == 0) {
+			ok = link_quad_grad_program(cache, &renderer->shaders.quad_grad) && ok;
+		}
+		if (renderer->shaders.quad_grad_round.program == 0) {
+			ok = link_quad_grad_round_program(cache,
+				&renderer->shaders.quad_grad_round) && ok;
+		}
+		return ok;
+	case FX_RENDERER_PROGRAMS_SHADOWS:
+		if (box_shadow_full(renderer)->program == 0) {
+			ok = link_box_shadow_program(cache, box_shadow_full(renderer),
+				&full_shape_variant) && ok;
+		}
+		if (renderer->exts.instanced_arrays &&
+				renderer->shaders.box_shadow_instanced.program == 0) {
+			ok = link_box_shadow_instanced_program(cache,
+				&renderer->shaders.box_shadow_instanced) && ok;
+		}
+		return ok;
+	case FX_RENDERER_PROGRAMS_BLUR:
+		if (renderer->shaders.blur1.program == 0) {
+			ok = link_blur1_program(cache, &renderer->shaders.blur1) && ok;
+		}
+		if (renderer->shaders.blur2.program == 0) {
+			ok = link_blur2_program(cache, &renderer->shaders.blur2, false) && ok;
+		}
+		if (renderer->shaders.blur2_effects.program == 0) {
+			ok = link_blur2_program(cache, &renderer->shaders.blur2_effects, true) && ok;
+		}
+		if (renderer->shaders.blur_effects.program == 0) {
+			ok = link_blur_effects_program(cache, &renderer->shaders.blur_effects) && ok;
+		}
+		return ok;
+	case FX_RENDERER_PROGRAMS_ALL:
+		break;
 	}
+	abort(); // unreachable
+}
 
-	// quad fragment shader with gradients
-	if (!link_quad_grad_program(&renderer->shaders.quad_grad, 16)) {
-		wlr_log(WLR_ERROR, "Could not link quad grad shader");
-		goto error;
+static const char *program_group_name(enum fx_renderer_programs group) {
+	switch (group) {
+	case FX_RENDERER_PROGRAMS_ROUNDED:
+		return "rounded";
+	case FX_RENDERER_PROGRAMS_GRADIENTS:
+		return "gradient";
+	case FX_RENDERER_PROGRAMS_SHADOWS:
+		return "shadow";
+	case FX_RENDERER_PROGRAMS_BLUR:
+		return "blur";
+	case FX_RENDERER_PROGRAMS_ALL:
+		break;
 	}
+	return "unknown";
+}
 
-	if (!link_quad_grad_round_program(&renderer->shaders.quad_grad_round, 16)) {
-		wlr_log(WLR_ERROR, "Could not link quad grad round shader");
-		goto error;
+bool fx_renderer_link_programs(struct fx_renderer *renderer, uint32_t programs) {
+	uint32_t missing = programs & ~renderer->programs.linked;
+	if (missing == 0) {
+		return true;
 	}
 
-	if (!link_quad_round_program(&renderer->shaders.quad_round)) {
-		wlr_log(WLR_ERROR, "Could not link quad round shader");
-		goto error;
+	push_fx_debug(renderer);
+	for (uint32_t group = 1; group & FX_RENDERER_PROGRAMS_ALL; group <<= 1) {
+		if (!(missing & group) || (renderer->programs.failed & group)) {
+			continue;
+		}
+
+		struct timespec start, end, duration;
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		if (link_program_group(renderer, group)) {
+			renderer->programs.linked |= group;
+			clock_gettime(CLOCK_MONOTONIC, &end);
+			timespec_sub(&duration, &end, &start);
+			wlr_log(WLR_DEBUG, "Linked %s shaders in %.2f ms%s",
+				program_group_name(group), timespec_to_nsec(&duration) / 1e6,
+				(renderer->programs.started & group) ? " (started in the background)" : "");
+		} else {
+			wlr_log(WLR_ERROR, "Could not link %s shaders", program_group_name(group));
+			renderer->programs.failed |= group;
+		}
 	}
+	pop_fx_debug(renderer);
 
-	// Basic fragment shaders
-	if (!link_tex_program(&renderer->shaders.tex_rgba,
-				SHADER_SOURCE_TEXTURE_RGBA, false)) {
-		wlr_log(WLR_ERROR, "Could not link tex_RGBA shader");
-		goto error;
+	return (programs & ~renderer->programs.linked) == 0;
+}
+
+static void start_programs(struct fx_renderer *renderer, uint32_t programs) {
+	uint32_t missing = programs &
+		~(renderer->programs.linked | renderer->programs.started);
+	if (missing == 0) {
+		return;
 	}
-	if (!link_tex_program(&renderer->shaders.tex_rgbx,
-				SHADER_SOURCE_TEXTURE_RGBX, false)) {
-		wlr_log(WLR_ERROR, "Could not link tex_RGBX shader");
-		goto error;
+
+	renderer->program_cache.background = true;
+	for (uint32_t group = 1; group & FX_RENDERER_PROGRAMS_ALL; group <<= 1) {
+		if (missing & group) {
+			link_program_group(renderer, group);
+		}
 	}
-	if (!link_tex_program(&renderer->shaders.tex_ext,
-				SHADER_SOURCE_TEXTURE_EXTERNAL, false)) {
-		wlr_log(WLR_ERROR, "Could not link tex_EXTERNAL shader");
-		goto error;
+	renderer->program_cache.background = false;
+
+	renderer->programs.started |= missing;
+}
+
+void fx_renderer_prewarm_programs(struct wlr_renderer *wlr_renderer,
+		uint32_t programs) {
+	struct fx_renderer *renderer = fx_get_renderer(wlr_renderer);
+
+	struct wlr_egl_context prev_ctx = {0};
+	if (!wlr_egl_make_current(renderer->egl, &prev_ctx)) {
+		return;
 	}
 
-	// Effects fragment shaders
-	if (!link_tex_program(&renderer->shaders.tex_effects_rgba,
-				SHADER_SOURCE_TEXTURE_RGBA, true)) {
-		wlr_log(WLR_ERROR, "Could not link tex_effects_RGBA shader");
-		goto error;
+	push_fx_debug(renderer);
+	if (renderer->exts.KHR_parallel_shader_compile) {
+		start_programs(renderer, programs);
+	} else {
+		fx_renderer_link_programs(renderer, programs);
+	}
+	pop_fx_debug(renderer);
+
+	wlr_egl_restore_context(&prev_ctx);
+}
+
+/**
+ * Prepares linking a variant for a draw. If the draw can fall back to a
+ * linked program, a variant still compiling in the background is polled
+ * with GL_COMPLETION_STATUS_KHR instead of waited for.
+ */
+static void begin_variant_link(struct fx_renderer *renderer, bool can_fall_back) {
+	push_fx_debug(renderer);
+	renderer->program_cache.poll = can_fall_back;
+	renderer->program_cache.busy = false;
+}
+
+// Returns true if the variant was left compiling in the background
+static bool end_variant_link(struct fx_renderer *renderer) {
+	struct fx_program_cache *cache = &renderer->program_cache;
+	bool busy = cache->busy;
+	cache->poll = false;
+	cache->busy = false;
+	pop_fx_debug(renderer);
+	return busy;
+}
+
+struct tex_shader *fx_renderer_tex_shader(struct fx_renderer *renderer,
+		enum fx_tex_shader_source source, const struct shader_variant *variant,
+		struct shader_variant *picked) {
+	struct tex_shader *shader = tex_variant(renderer, source, variant);
+	struct tex_shader *full = tex_variant(renderer, source, &full_variant);
+	if (shader->program == 0 && !shader->link_failed && shader != full) {
+		begin_variant_link(renderer, full->program != 0);
+		bool ok = link_tex_variant(renderer, source, variant);
+		if (!end_variant_link(renderer) && !ok) {
+			wlr_log(WLR_ERROR, "Could not link tex shader variant %zu, "
+				"falling back to the full variant", shader_variant_index(variant));
+			shader->link_failed = true;
+		}
+	}
+	if (shader->program != 0) {
+		*picked = *variant;
+		return shader;
+	}
+
+	if (full->program == 0 && !full->link_failed) {
+		push_fx_debug(renderer);
+		if (!link_tex_variant(renderer, source, &full_variant)) {
+			wlr_log(WLR_ERROR, "Could not link full tex shader");
+			full->link_failed = true;
+		}
+		pop_fx_debug(renderer);
+	}
+	if (full->program == 0) {
+		return NULL;
+	}
+	*picked = full_variant;
+	return full;
+}
+
+struct quad_round_shader *fx_renderer_quad_round_shader(struct fx_renderer *renderer,
+		const struct shader_variant *variant, struct shader_variant *picked) {
+	struct shader_variant rect_variant = *variant;
+	rect_variant.discard_transparent = false;
+
+	struct fx_program_cache *cache = &renderer->program_cache;
+	struct quad_round_shader *shader =
+		&renderer->shaders.quad_round[shader_variant_index(&rect_variant)];
+	struct quad_round_shader *full = quad_round_full(renderer);
+	if (shader->program == 0 && !shader->link_failed && shader != full) {
+		begin_variant_link(renderer, full->program != 0);
+		bool ok = link_quad_round_program(cache, shader, &rect_variant);
+		if (!end_variant_link(renderer) && !ok) {
+			wlr_log(WLR_ERROR, "Could not link quad round shader variant %zu, "
+				"falling back to the full variant", shader_variant_index(&rect_variant));
+			shader->link_failed = true;
+		}
+	}
+	if (shader->program != 0) {
+		*picked = rect_variant;
+		return shader;
+	}
+
+	if (full->program == 0 && !full->link_failed) {
+		push_fx_debug(renderer);
+		if (!link_quad_round_program(cache, full, &full_shape_variant)) {
+			wlr_log(WLR_ERROR, "Could not link full quad round shader");
+			full->link_failed = true;
+		}
+		pop_fx_debug(renderer);
+	}
+	if (full->program == 0) {
+		return NULL;
+	}
+	*picked = full_shape_variant;
+	return full;
+}
+
+struct box_shadow_shader *fx_renderer_box_shadow_shader(struct fx_renderer *renderer,
+		const struct shader_variant *variant, struct shader_variant *picked) {
+	// Shadows always evaluate their own rounded box, only clipping varies
+	struct shader_variant shadow_variant = {
+		.corners = SHADER_CORNERS_PER_CORNER,
+		.clip = variant->clip,
+	};
+
+	struct fx_program_cache *cache = &renderer->program_cache;
+	struct box_shadow_shader *shader =
+		&renderer->shaders.box_shadow[shader_variant_index(&shadow_variant)];
+	struct box_shadow_shader *full = box_shadow_full(renderer);
+	if (shader->program == 0 && !shader->link_failed && shader != full) {
+		begin_variant_link(renderer, full->program != 0);
+		bool ok = link_box_shadow_program(cache, shader, &shadow_variant);
+		if (!end_variant_link(renderer) && !ok) {
+			wlr_log(WLR_ERROR, "Could not link box shadow shader variant %zu, "
+				"falling back to the full variant", shader_variant_index(&shadow_variant));
+			shader->link_failed = true;
+		}
+	}
+	if (shader->program != 0) {
+		*picked = shadow_variant;
+		return shader;
 	}
-	if (!link_tex_program(&renderer->shaders.tex_effects_rgbx,
-				SHADER_SOURCE_TEXTURE_RGBX, true)) {
-		wlr_log(WLR_ERROR, "Could not link tex_effects_RGBX shader");
+
+	if (full->program == 0 && !full->link_failed) {
+		push_fx_debug(renderer);
+		if (!link_box_shadow_program(cache, full, &full_shape_variant)) {
+			wlr_log(WLR_ERROR, "Could not link full box shadow shader");
+			full->link_failed = true;
+		}
+		pop_fx_debug(renderer);
+	}
+	if (full->program == 0) {
+		return NULL;
+	}
+	*picked = full_shape_variant;
+	return full;
+}
+
+static struct instanced_shader *instanced_shader(struct fx_renderer *renderer,
+		struct instanced_shader *shader,
+		bool (*link)(struct fx_program_cache *cache, struct instanced_shader *shader)) {
+	if (!renderer->exts.instanced_arrays) {
+		return NULL;
+	}
+	if (shader->program == 0 && !shader->link_failed) {
+		push_fx_debug(renderer);
+		if (!link(&renderer->program_cache, shader)) {
+			wlr_log(WLR_ERROR, "Could not link instanced shader");
+			shader->link_failed = true;
+		}
+		pop_fx_debug(renderer);
+	}
+	return shader->program != 0 ? shader : NULL;
+}
+
+struct instanced_shader *fx_renderer_quad_round_instanced_shader(
+		struct fx_renderer *renderer) {
+	return instanced_shader(renderer, &renderer->shaders.quad_round_instanced,
+		link_quad_round_instanced_program);
+}
+
+struct instanced_shader *fx_renderer_box_shadow_instanced_shader(
+		struct fx_renderer *renderer) {
+	return instanced_shader(renderer, &renderer->shaders.box_shadow_instanced,
+		link_box_shadow_instanced_program);
+}
+
+/**
+ * Links the programs needed for plain frames. Everything else is linked once
+ * first used, see fx_renderer_link_programs.
+ */
+static bool link_shaders(struct fx_renderer *renderer) {
+	struct fx_program_cache *cache = &renderer->program_cache;
+
+	// quad fragment shader
+	if (!link_quad_program(cache, &renderer->shaders.quad, false)) {
+		wlr_log(WLR_ERROR, "Could not link quad shader");
 		goto error;
 	}
-	if (!link_tex_program(&renderer->shaders.tex_effects_ext,
-				SHADER_SOURCE_TEXTURE_EXTERNAL, true)) {
-		wlr_log(WLR_ERROR, "Could not link tex_effects_EXTERNAL shader");
+
+	// quad clip fragment shader
+	if (!link_quad_program(cache, &renderer->shaders.quad_clip, true)) {
+		wlr_log(WLR_ERROR, "Could not link quad clip shader");
 		goto error;
 	}
 
-	// box shadow shader
-	if (!link_box_shadow_program(&renderer->shaders.box_shadow)) {
-		wlr_log(WLR_ERROR, "Could not link box shadow shader");
+	// quad shader with per-vertex colors
+	if (!link_quad_batch_program(cache, &renderer->shaders.quad_batch)) {
+		wlr_log(WLR_ERROR, "Could not link quad batch shader");
 		goto error;
 	}
 
-	// Blur shaders
-	if (!link_blur1_program(&renderer->shaders.blur1)) {
-		wlr_log(WLR_ERROR, "Could not link blur1 shader");
+	// Basic fragment shaders, used by most surfaces
+	if (!link_tex_variant(renderer, SHADER_SOURCE_TEXTURE_RGBA, &plain_variant)) {
+		wlr_log(WLR_ERROR, "Could not link tex_RGBA shader");
 		goto error;
 	}
-	if (!link_blur2_program(&renderer->shaders.blur2)) {
-		wlr_log(WLR_ERROR, "Could not link blur2 shader");
+	if (!link_tex_variant(renderer, SHADER_SOURCE_TEXTURE_RGBX, &plain_variant)) {
+		wlr_log(WLR_ERROR, "Could not link tex_RGBX shader");
 		goto error;
 	}
-	if (!link_blur_effects_program(&renderer->shaders.blur_effects)) {
-		wlr_log(WLR_ERROR, "Could not link blur_effects shader");
+	if (!link_tex_variant(renderer, SHADER_SOURCE_TEXTURE_EXTERNAL, &plain_variant)) {
+		wlr_log(WLR_ERROR, "Could not link tex_EXTERNAL shader");
 		goto error;
 	}
 
@@ -465,6 +847,7 @@ struct wlr_renderer *fx_renderer_create_egl(struct wlr_egl *egl) {
 	wl_list_init(&renderer->buffers);
 	wl_list_init(&renderer->textures);
 	wl_list_init(&renderer->offscreen_buffers);
+	wl_array_init(&renderer->batch.data);
 
 	renderer->egl = egl;
 	renderer->exts_str = exts_str;
@@ -557,6 +940,29 @@ struct wlr_renderer *fx_renderer_create_egl(struct wlr_egl *egl) {
 		)
 	}
 
+	int gles_major = 0;
+	const char *gl_version = (const char *)glGetString(GL_VERSION);
+	if (gl_version != NULL) {
+		sscanf(gl_version, "OpenGL ES %d", &gles_major);
+	}
+	if (gles_major >= 3) {
+		renderer->exts.instanced_arrays = true;
+		load_gl_proc(&renderer->procs.glDrawArraysInstanced, "glDrawArraysInstanced");
+		load_gl_proc(&renderer->procs.glVertexAttribDivisor, "glVertexAttribDivisor");
+	} else if (check_gl_ext(exts_str, "GL_EXT_instanced_arrays")) {
+		renderer->exts.instanced_arrays = true;
+		load_gl_proc(&renderer->procs.glDrawArraysInstanced, "glDrawArraysInstancedEXT");
+		load_gl_proc(&renderer->procs.glVertexAttribDivisor, "glVertexAttribDivisorEXT");
+	}
+
+	if (check_gl_ext(exts_str, "GL_KHR_parallel_shader_compile")) {
+		renderer->exts.KHR_parallel_shader_compile = true;
+		load_gl_proc(&renderer->procs.glMaxShaderCompilerThreadsKHR,
+			"glMaxShaderCompilerThreadsKHR");
+		// Let the driver pick the number of threads
+		renderer->procs.glMaxShaderCompilerThreadsKHR(0xFFFFFFFF);
+	}
+
 	if (renderer->exts.KHR_debug) {
 		glEnable(GL_DEBUG_OUTPUT_KHR);
 		glEnable(GL_DEBUG_OUTPUT_SYNCHRONOUS_KHR);
@@ -575,10 +981,34 @@ struct wlr_renderer *fx_renderer_create_egl(struct wlr_egl *egl) {
 		renderer->tracy_data = TRACY_GPU_CONTEXT_NEW(renderer);
 	)
 
-	// Link all shaders
+	// Link the shaders needed for plain frames
+	struct timespec link_start, link_end, link_duration;
+	clock_gettime(CLOCK_MONOTONIC, &link_start);
+	fx_program_cache_init(&renderer->program_cache, exts_str);
 	if (!link_shaders(renderer)) {
+		fx_program_cache_finish(&renderer->program_cache);
 		goto error;
 	}
+	clock_gettime(CLOCK_MONOTONIC, &link_end);
+	timespec_sub(&link_duration, &link_end, &link_start);
+	wlr_log(WLR_INFO, "Linked shaders in %.2f ms (%d loaded from the program "
+		"cache, %d compiled, %d stored)",
+		timespec_to_nsec(&link_duration) / 1e6,
+		renderer->program_cache.hits, renderer->program_cache.misses,
+		renderer->program_cache.stores);
+
+	// Compile the effect programs while the first plain frames are drawn
+	if (renderer->exts.KHR_parallel_shader_compile) {
+		start_programs(renderer, FX_RENDERER_PROGRAMS_ALL);
+	}
+
+	if (!fx_vertex_ring_init(&renderer->vertex_ring)) {
+		free_shaders(renderer);
+		fx_program_cache_finish(&renderer->program_cache);
+		goto error;
+	}
+
+	fx_gl_state_invalidate(&renderer->gl_state);
 
 	pop_fx_debug(renderer);
 
@@ -66,7 +66,7 @@ static bool fx_texture_update_from_buffer(struct wlr_texture *wlr_texture,
 
 	push_fx_debug(texture->fx_renderer);
 
-	glBindTexture(GL_TEXTURE_2D, texture->tex);
+	fx_gl_bind_texture(texture->fx_renderer, GL_TEXTURE_2D, texture->tex);
 
 	int rects_len = 0;
 	pixman_box32_t *rects = pixman_region32_rectangles(damage, &rects_len);
@@ -88,8 +88,6 @@ static bool fx_texture_update_from_buffer(struct wlr_texture *wlr_texture,
 	glPixelStorei(GL_UNPACK_SKIP_PIXELS_EXT, 0);
 	glPixelStorei(GL_UNPACK_SKIP_ROWS_EXT, 0);
 
-	glBindTexture(GL_TEXTURE_2D, 0);
-
 	pop_fx_debug(texture->fx_renderer);
 
 	wlr_egl_restore_context(&prev_ctx);
@@ -109,6 +107,8 @@ void fx_texture_destroy(struct fx_texture *texture) {
 
 		push_fx_debug(texture->fx_renderer);
 
+		fx_gl_forget_texture(texture->fx_renderer, texture->tex);
+		fx_gl_forget_framebuffer(texture->fx_renderer, texture->fbo);
 		glDeleteTextures(1, &texture->tex);
 		glDeleteFramebuffers(1, &texture->fbo);
 
@@ -121,8 +121,9 @@ void fx_texture_destroy(struct fx_texture *texture) {
 }
 
 static bool fx_texture_bind(struct fx_texture *texture) {
+	struct fx_renderer *renderer = texture->fx_renderer;
 	if (texture->fbo) {
-		glBindFramebuffer(GL_FRAMEBUFFER, texture->fbo);
+		fx_gl_bind_framebuffer(renderer, texture->fbo);
 	} else if (texture->buffer) {
 		if (texture->buffer->external_only) {
 				return false;
@@ -133,20 +134,21 @@ static bool fx_texture_bind(struct fx_texture *texture) {
 			return false;
 		}
 
-		glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+		fx_gl_bind_framebuffer(renderer, fbo);
 } else {
 		glGenFramebuffers(1, &texture->fbo);
-		glBindFramebuffer(GL_FRAMEBUFFER, texture->fbo);
+		fx_gl_bind_framebuffer(renderer, texture->fbo);
 		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
 				texture->target, texture->tex, 0);
 
 		GLenum fb_status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
 		if (fb_status != GL_FRAMEBUFFER_COMPLETE) {
 			wlr_log(WLR_ERROR, "Failed to create FBO");
+			fx_gl_forget_framebuffer(renderer, texture->fbo);
 			glDeleteFramebuffers(1, &texture->fbo);
 			texture->fbo = 0;
 
-			glBindFramebuffer(GL_FRAMEBUFFER, 0);
+			fx_gl_bind_framebuffer(renderer, 0);
 			return false;
 		}
 	}
@@ -243,7 +245,7 @@ static uint32_t fx_texture_preferred_read_format(struct wlr_texture *wlr_texture
 	glGetIntegerv(GL_IMPLEMENTATION_COLOR_READ_TYPE, &gl_type);
 	glGetIntegerv(GL_ALPHA_BITS, &alpha_size);
 
-	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	fx_gl_bind_framebuffer(texture->fx_renderer, 0);
 	pop_fx_debug(texture->fx_renderer);
 
 	const struct fx_pixel_format *pix_fmt =
@@ -285,6 +287,7 @@ static struct fx_texture *fx_texture_create(
 			&texture_impl, width, height);
 	texture->fx_renderer = renderer;
 	wl_list_insert(&renderer->textures, &texture->link);
+	renderer->stats.textures_created++;
 	return texture;
 }
 
@@ -332,7 +335,7 @@ static struct wlr_texture *fx_texture_from_pixels(
 	push_fx_debug(renderer);
 
 	glGenTextures(1, &texture->tex);
-	glBindTexture(GL_TEXTURE_2D, texture->tex);
+	fx_gl_bind_texture(renderer, GL_TEXTURE_2D, texture->tex);
 
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
@@ -341,8 +344,6 @@ static struct wlr_texture *fx_texture_from_pixels(
 		fmt->gl_format, fmt->gl_type, data);
 	glPixelStorei(GL_UNPACK_ROW_LENGTH_EXT, 0);
 
-	glBindTexture(GL_TEXTURE_2D, 0);
-
 	pop_fx_debug(renderer);
 
 	wlr_egl_restore_context(&prev_ctx);
@@ -388,11 +389,10 @@ static struct wlr_texture *fx_texture_from_dmabuf(
 	}
 
 	if (invalid) {
-		glBindTexture(texture->target, buffer->tex);
+		fx_gl_bind_texture(renderer, texture->target, buffer->tex);
 		glTexParameteri(texture->target, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
 		glTexParameteri(texture->target, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
 		renderer->procs.glEGLImageTargetTexture2DOES(texture->target, buffer->image);
-		glBindTexture(texture->target, 0);
 	}
 
 	pop_fx_debug(texture->fx_renderer);
@@ -0,0 +1,79 @@
+#include <stdlib.h>
+#include <wlr/util/log.h>
+
+#include "render/fx_renderer/fx_renderer.h"
+
+// Large enough for a few thousand damage rects per frame before wrapping
+#define VERTEX_RING_DEFAULT_SIZE (256 * 1024)
+
+bool fx_vertex_ring_init(struct fx_vertex_ring *ring) {
+	*ring = (struct fx_vertex_ring){
+		.size = VERTEX_RING_DEFAULT_SIZE,
+	};
+
+	glGenBuffers(1, &ring->vbo);
+	if (ring->vbo == 0) {
+		wlr_log(WLR_ERROR, "Failed to create the vertex buffer");
+		return false;
+	}
+
+	glBindBuffer(GL_ARRAY_BUFFER, ring->vbo);
+	glBufferData(GL_ARRAY_BUFFER, ring->size, NULL, GL_STREAM_DRAW);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	return true;
+}
+
+void fx_vertex_ring_finish(struct fx_vertex_ring *ring) {
+	glDeleteBuffers(1, &ring->vbo);
+	free(ring->staging);
+	*ring = (struct fx_vertex_ring){0};
+}
+
+GLfloat *fx_vertex_ring_reserve(struct fx_vertex_ring *ring, size_t len) {
+	if (len > ring->staging_cap) {
+		size_t cap = ring->staging_cap > 0 ? ring->staging_cap : 1024;
+		while (cap < len) {
+			cap *= 2;
+		}
+
+		GLfloat *staging = realloc(ring->staging, cap * sizeof(*staging));
+		if (staging == NULL) {
+			wlr_log(WLR_ERROR, "Failed to grow the vertex staging buffer");
+			ring->staging_len = 0;
+			return NULL;
+		}
+		ring->staging = staging;
+		ring->staging_cap = cap;
+	}
+
+	ring->staging_len = len;
+	return ring->staging;
+}
+
+GLintptr fx_vertex_ring_upload(struct fx_vertex_ring *ring) {
+	GLsizeiptr size = ring->staging_len * sizeof(*ring->staging);
+	ring->staging_len = 0;
+
+	glBindBuffer(GL_ARRAY_BUFFER, ring->vbo);
+
+	if (size > ring->size) {
+		while (ring->size < size) {
+			ring->size *= 2;
+		}
+		glBufferData(GL_ARRAY_BUFFER, ring->size, NULL, GL_STREAM_DRAW);
+		ring->offset = 0;
+	} else if (ring->offset + size > ring->size) {
+		// Orphan the storage instead of overwriting vertices which may still
+		// be in use by queued draws. The driver hands us fresh storage and
+		// releases the old one once the GPU is done with it.
+		glBufferData(GL_ARRAY_BUFFER, ring->size, NULL, GL_STREAM_DRAW);
+		ring->offset = 0;
+	}
+
+	GLintptr offset = ring->offset;
+	glBufferSubData(GL_ARRAY_BUFFER, offset, size, ring->staging);
+	ring->offset += size;
+
+	return offset;
+}
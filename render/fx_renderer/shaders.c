@@ -1,14 +1,18 @@
 #include <EGL/egl.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <wlr/util/log.h>
 #include <scenefx/types/fx/clipped_region.h>
 
+#include "render/fx_renderer/fx_renderer.h"
 #include "render/fx_renderer/shaders.h"
 
 // shaders
 #include "GLES2/gl2.h"
 #include "common_vert_src.h"
+#include "quad_batch_vert_src.h"
+#include "instanced_vert_src.h"
 #include "gradient_frag_src.h"
 #include "corner_alpha_frag_src.h"
 #include "quad_frag_src.h"
@@ -20,34 +24,23 @@
 #include "blur1_frag_src.h"
 #include "blur2_frag_src.h"
 #include "blur_effects_frag_src.h"
+#include "color_effects_frag_src.h"
 
-GLuint compile_shader(GLuint type, const GLchar *src) {
+static GLuint compile_shader(GLuint type, const GLchar *src) {
 	GLuint shader = glCreateShader(type);
 	glShaderSource(shader, 1, &src, NULL);
 	glCompileShader(shader);
-
-	GLint ok;
-	glGetShaderiv(shader, GL_COMPILE_STATUS, &ok);
-	if (ok == GL_FALSE) {
-		wlr_log(WLR_ERROR, "Failed to compile shader");
-		glDeleteShader(shader);
-		shader = 0;
-	}
-
 	return shader;
 }
 
-GLuint link_program(const GLchar *frag_src) {
-	GLuint vert = compile_shader(GL_VERTEX_SHADER, common_vert_src);
-	if (!vert) {
-		goto error;
-	}
-
+/**
+ * Compiles and links the program without querying any results, so that
+ * drivers supporting GL_KHR_parallel_shader_compile can do the work in the
+ * background. Compile errors surface as a failed link.
+ */
+static GLuint start_program(const GLchar *vert_src, const GLchar *frag_src) {
+	GLuint vert = compile_shader(GL_VERTEX_SHADER, vert_src);
 	GLuint frag = compile_shader(GL_FRAGMENT_SHADER, frag_src);
-	if (!frag) {
-		glDeleteShader(vert);
-		goto error;
-	}
 
 	GLuint prog = glCreateProgram();
 	glAttachShader(prog, vert);
@@ -59,21 +52,53 @@ GLuint link_program(const GLchar *frag_src) {
 	glDeleteShader(vert);
 	glDeleteShader(frag);
 
+	return prog;
+}
+
+GLuint link_program(struct fx_program_cache *cache, const GLchar *frag_src) {
+	return link_program_with_vert(cache, common_vert_src, frag_src);
+}
+
+GLuint link_program_with_vert(struct fx_program_cache *cache,
+		const GLchar *vert_src, const GLchar *frag_src) {
+	bool from_binary = false;
+	GLuint prog = fx_program_cache_take_pending(cache, vert_src, frag_src,
+		&from_binary);
+	if (prog == 0 && cache != NULL && cache->busy) {
+		return 0;
+	}
+	if (prog == 0) {
+		prog = fx_program_cache_load(cache, vert_src, frag_src);
+		from_binary = prog != 0;
+	}
+	if (prog == 0) {
+		prog = start_program(vert_src, frag_src);
+	}
+
+	if (cache != NULL && cache->background) {
+		fx_program_cache_add_pending(cache, prog, vert_src, frag_src,
+			from_binary);
+		return 0;
+	}
+	if (from_binary) {
+		return prog;
+	}
+
 	GLint ok;
 	glGetProgramiv(prog, GL_LINK_STATUS, &ok);
 	if (ok == GL_FALSE) {
-		wlr_log(WLR_ERROR, "Failed to link shader");
+		GLchar log[1024];
+		glGetProgramInfoLog(prog, sizeof(log), NULL, log);
+		wlr_log(WLR_ERROR, "Failed to link shader: %s", log);
 		glDeleteProgram(prog);
-		goto error;
+		return 0;
 	}
 
-	return prog;
+	fx_program_cache_store(cache, prog, vert_src, frag_src);
 
-error:
-	return 0;
+	return prog;
 }
 
-
 bool check_gl_ext(const char *exts, const char *ext) {
 	size_t extlen = strlen(ext);
 	const char *end = exts + strlen(exts);
@@ -101,28 +126,119 @@ void load_gl_proc(void *proc_ptr, const char *name) {
 	*(void **)proc_ptr = proc;
 }
 
-void uniform_corner_radii_set(const struct shader_corner_radii *uniform,
+void shader_uniform_cache_reset(struct shader_uniform_cache *cache) {
+	cache->valid = 0;
+	cache->matrices_len = 0;
+}
+
+/**
+ * Stores the value of the uniform at the location in the cache. Returns false
+ * if the cache already held the same value, i.e. the upload can be skipped.
+ */
+static bool uniform_cache_update(struct fx_renderer *renderer,
+		struct shader_uniform_cache *cache, GLint loc, const GLfloat *value,
+		size_t len) {
+	if (loc < 0 || loc >= SHADER_UNIFORM_CACHE_LEN) {
+		return true;
+	}
+
+	uint64_t bit = (uint64_t)1 << loc;
+	GLfloat *cached = cache->values[loc];
+	if ((cache->valid & bit) && memcmp(cached, value, len * sizeof(*value)) == 0) {
+		renderer->stats.uniform_calls_skipped++;
+		return false;
+	}
+
+	memcpy(cached, value, len * sizeof(*value));
+	cache->valid |= bit;
+	return true;
+}
+
+void uniform_1f_set(struct fx_renderer *renderer, struct shader_uniform_cache *cache,
+		GLint loc, GLfloat x) {
+	if (uniform_cache_update(renderer, cache, loc, (GLfloat[]){ x }, 1)) {
+		glUniform1f(loc, x);
+	}
+}
+
+void uniform_2f_set(struct fx_renderer *renderer, struct shader_uniform_cache *cache,
+		GLint loc, GLfloat x, GLfloat y) {
+	if (uniform_cache_update(renderer, cache, loc, (GLfloat[]){ x, y }, 2)) {
+		glUniform2f(loc, x, y);
+	}
+}
+
+void uniform_4f_set(struct fx_renderer *renderer, struct shader_uniform_cache *cache,
+		GLint loc, GLfloat x, GLfloat y, GLfloat z, GLfloat w) {
+	if (uniform_cache_update(renderer, cache, loc, (GLfloat[]){ x, y, z, w }, 4)) {
+		glUniform4f(loc, x, y, z, w);
+	}
+}
+
+void uniform_1i_set(struct fx_renderer *renderer, struct shader_uniform_cache *cache,
+		GLint loc, GLint x) {
+	// Only used for small values, which floats represent exactly
+	if (uniform_cache_update(renderer, cache, loc, (GLfloat[]){ x }, 1)) {
+		glUniform1i(loc, x);
+	}
+}
+
+void uniform_matrix3_set(struct fx_renderer *renderer,
+		struct shader_uniform_cache *cache, GLint loc, const GLfloat value[static 9]) {
+	const size_t matrices_cap = sizeof(cache->matrices) / sizeof(cache->matrices[0]);
+	for (size_t i = 0; i < cache->matrices_len; i++) {
+		if (cache->matrices[i].loc != loc) {
+			continue;
+		}
+		if (memcmp(cache->matrices[i].value, value, sizeof(cache->matrices[i].value)) == 0) {
+			renderer->stats.uniform_calls_skipped++;
+			return;
+		}
+		memcpy(cache->matrices[i].value, value, sizeof(cache->matrices[i].value));
+		glUniformMatrix3fv(loc, 1, GL_FALSE, value);
+		return;
+	}
+
+	if (loc >= 0 && cache->matrices_len < matrices_cap) {
+		cache->matrices[cache->matrices_len].loc = loc;
+		memcpy(cache->matrices[cache->matrices_len].value, value,
+			sizeof(cache->matrices[cache->matrices_len].value));
+		cache->matrices_len++;
+	}
+	glUniformMatrix3fv(loc, 1, GL_FALSE, value);
+}
+
+void uniform_corner_radii_set(struct fx_renderer *renderer,
+		struct shader_uniform_cache *cache, const struct shader_corner_radii *uniform,
 		const struct fx_corner_fradii *corners) {
-	glUniform1f(uniform->top_left, corners->top_left);
-	glUniform1f(uniform->top_right, corners->top_right);
-	glUniform1f(uniform->bottom_left, corners->bottom_left);
-	glUniform1f(uniform->bottom_right, corners->bottom_right);
+	uniform_1f_set(renderer, cache, uniform->top_left, corners->top_left);
+	uniform_1f_set(renderer, cache, uniform->top_right, corners->top_right);
+	uniform_1f_set(renderer, cache, uniform->bottom_left, corners->bottom_left);
+	uniform_1f_set(renderer, cache, uniform->bottom_right, corners->bottom_right);
+}
+
+size_t shader_variant_index(const struct shader_variant *variant) {
+	return (size_t)variant->corners * 4 + variant->clip * 2 +
+		variant->discard_transparent;
 }
+
 // Shaders
 
-bool link_quad_program(struct quad_shader *shader, bool clip) {
+bool link_quad_program(struct fx_program_cache *cache,
+		struct quad_shader *shader, bool clip) {
 	GLchar quad_src_part[2048];
-	GLchar quad_src[4096];
+	GLchar quad_src[8192];
 	snprintf(quad_src_part, sizeof(quad_src_part),
 		quad_frag_src, clip);
 	snprintf(quad_src, sizeof(quad_src),
 		"%s\n%s\n", quad_src_part, clip ? corner_alpha_frag_src : "");
 
 	GLuint prog;
-	shader->program = prog = link_program(quad_src);
+	shader->program = prog = link_program(cache, quad_src);
 	if (!shader->program) {
 		return false;
 	}
+	shader_uniform_cache_reset(&shader->uniforms);
 
 	shader->proj = glGetUniformLocation(prog, "proj");
 	shader->color = glGetUniformLocation(prog, "color");
@@ -141,46 +257,65 @@ bool link_quad_program(struct quad_shader *shader, bool clip) {
 	return true;
 }
 
-bool link_quad_grad_program(struct quad_grad_shader *shader, int max_len) {
-	GLchar quad_src_part[2048];
+bool link_quad_batch_program(struct fx_program_cache *cache,
+		struct quad_batch_shader *shader) {
+	GLchar quad_src[2048];
+	snprintf(quad_src, sizeof(quad_src), quad_frag_src, false);
+
+	GLuint prog;
+	shader->program = prog = link_program_with_vert(cache, quad_batch_vert_src, quad_src);
+	if (!shader->program) {
+		return false;
+	}
+	shader_uniform_cache_reset(&shader->uniforms);
+
+	shader->proj = glGetUniformLocation(prog, "proj");
+	shader->pos_attrib = glGetAttribLocation(prog, "pos");
+	shader->color_attrib = glGetAttribLocation(prog, "color");
+
+	return true;
+}
+
+bool link_quad_grad_program(struct fx_program_cache *cache,
+		struct quad_grad_shader *shader) {
 	GLchar quad_src[4096];
-	snprintf(quad_src_part, sizeof(quad_src_part),
-		quad_grad_frag_src, max_len);
 	snprintf(quad_src, sizeof(quad_src),
-		"%s\n%s", quad_src_part, gradient_frag_src);
+		"%s\n%s", quad_grad_frag_src, gradient_frag_src);
 
 	GLuint prog;
-	shader->program = prog = link_program(quad_src);
+	shader->program = prog = link_program(cache, quad_src);
 	if (!shader->program) {
 		return false;
 	}
+	shader_uniform_cache_reset(&shader->uniforms);
 
 	shader->proj = glGetUniformLocation(prog, "proj");
 	shader->pos_attrib = glGetAttribLocation(prog, "pos");
 	shader->size = glGetUniformLocation(prog, "size");
-	shader->colors = glGetUniformLocation(prog, "colors");
-	shader->degree = glGetUniformLocation(prog, "degree");
+	shader->lut = glGetUniformLocation(prog, "lut");
+	shader->rotation = glGetUniformLocation(prog, "rotation");
 	shader->grad_box = glGetUniformLocation(prog, "grad_box");
 	shader->linear = glGetUniformLocation(prog, "linear");
 	shader->origin = glGetUniformLocation(prog, "origin");
-	shader->count = glGetUniformLocation(prog, "count");
-	shader->blend = glGetUniformLocation(prog, "blend");
-
-	shader->max_len = max_len;
 
 	return true;
 }
 
-bool link_quad_round_program(struct quad_round_shader *shader) {
-	GLchar quad_src[4096];
-	snprintf(quad_src, sizeof(quad_src), "%s\n%s", quad_round_frag_src,
+bool link_quad_round_program(struct fx_program_cache *cache,
+		struct quad_round_shader *shader, const struct shader_variant *variant) {
+	GLchar quad_src_part[2048];
+	GLchar quad_src[8192];
+	snprintf(quad_src_part, sizeof(quad_src_part), quad_round_frag_src, false,
+		variant->corners, variant->clip);
+	snprintf(quad_src, sizeof(quad_src), "%s\n%s", quad_src_part,
 		corner_alpha_frag_src);
 
 	GLuint prog;
-	shader->program = prog = link_program(quad_src);
+	shader->program = prog = link_program(cache, quad_src);
 	if (!shader->program) {
 		return false;
 	}
+	shader_uniform_cache_reset(&shader->uniforms);
 
 	shader->proj = glGetUniformLocation(prog, "proj");
 	shader->color = glGetUniformLocation(prog, "color");
@@ -202,19 +337,18 @@ bool link_quad_round_program(struct quad_round_shader *shader) {
 	return true;
 }
 
-bool link_quad_grad_round_program(struct quad_grad_round_shader *shader, int max_len) {
-	GLchar quad_src_part[2048];
+bool link_quad_grad_round_program(struct fx_program_cache *cache,
+		struct quad_grad_round_shader *shader) {
 	GLchar quad_src[8192];
-	snprintf(quad_src_part, sizeof(quad_src_part),
-		quad_grad_round_frag_src, max_len);
-	snprintf(quad_src, sizeof(quad_src),
-		"%s\n%s\n%s", quad_src_part, gradient_frag_src, corner_alpha_frag_src);
+	snprintf(quad_src, sizeof(quad_src), "%s\n%s\n%s",
+		quad_grad_round_frag_src, gradient_frag_src, corner_alpha_frag_src);
 
 	GLuint prog;
-	shader->program = prog = link_program(quad_src);
+	shader->program = prog = link_program(cache, quad_src);
 	if (!shader->program) {
 		return false;
 	}
+	shader_uniform_cache_reset(&shader->uniforms);
 
 	shader->proj = glGetUniformLocation(prog, "proj");
 	shader->color = glGetUniformLocation(prog, "color");
@@ -227,33 +361,33 @@ bool link_quad_grad_round_program(struct quad_grad_round_shader *shader, int max
 	shader->radius.bottom_right = glGetUniformLocation(prog, "radius_bottom_right");
 
 	shader->grad_size = glGetUniformLocation(prog, "grad_size");
-	shader->colors = glGetUniformLocation(prog, "colors");
-	shader->degree = glGetUniformLocation(prog, "degree");
+	shader->lut = glGetUniformLocation(prog, "lut");
+	shader->rotation = glGetUniformLocation(prog, "rotation");
 	shader->grad_box = glGetUniformLocation(prog, "grad_box");
 	shader->linear = glGetUniformLocation(prog, "linear");
 	shader->origin = glGetUniformLocation(prog, "origin");
-	shader->count = glGetUniformLocation(prog, "count");
-	shader->blend = glGetUniformLocation(prog, "blend");
-
-	shader->max_len = max_len;
 
 	return true;
 }
 
-bool link_tex_program(struct tex_shader *shader, enum fx_tex_shader_source source,
-		bool effects) {
+bool link_tex_program(struct fx_program_cache *cache,
+		struct tex_shader *shader, enum fx_tex_shader_source source,
+		const struct shader_variant *variant) {
+	bool effects = variant->corners != SHADER_CORNERS_NONE || variant->clip;
+
 	GLchar frag_src_part[4096];
 	GLchar frag_src[8192];
-	snprintf(frag_src_part, sizeof(frag_src_part),
-		tex_frag_src, source, effects);
+	snprintf(frag_src_part, sizeof(frag_src_part), tex_frag_src, source,
+		variant->corners, variant->clip, variant->discard_transparent);
 	snprintf(frag_src, sizeof(frag_src),
 		"%s\n%s\n", frag_src_part, effects ? corner_alpha_frag_src : "");
 
 	GLuint prog;
-	shader->program = prog = link_program(frag_src);
+	shader->program = prog = link_program(cache, frag_src);
 	if (!shader->program) {
 		return false;
 	}
+	shader_uniform_cache_reset(&shader->uniforms);
 
 	shader->proj = glGetUniformLocation(prog, "proj");
 	shader->tex = glGetUniformLocation(prog, "tex");
@@ -283,16 +417,21 @@ bool link_tex_program(struct tex_shader *shader, enum fx_tex_shader_source sourc
 	return true;
 }
 
-bool link_box_shadow_program(struct box_shadow_shader *shader) {
+bool link_box_shadow_program(struct fx_program_cache *cache,
+		struct box_shadow_shader *shader, const struct shader_variant *variant) {
+	GLchar shadow_src_part[4096];
 	GLchar shadow_src[8192];
-	snprintf(shadow_src, sizeof(shadow_src), "%s\n%s", box_shadow_frag_src,
+	snprintf(shadow_src_part, sizeof(shadow_src_part), box_shadow_frag_src, false,
+		variant->clip);
+	snprintf(shadow_src, sizeof(shadow_src), "%s\n%s", shadow_src_part,
 		corner_alpha_frag_src);
 
 	GLuint prog;
-	shader->program = prog = link_program(shadow_src);
+	shader->program = prog = link_program(cache, shadow_src);
 	if (!shader->program) {
 		return false;
 	}
+	shader_uniform_cache_reset(&shader->uniforms);
 	shader->proj = glGetUniformLocation(prog, "proj");
 	shader->color = glGetUniformLocation(prog, "color");
 	shader->pos_attrib = glGetAttribLocation(prog, "pos");
@@ -310,12 +449,60 @@ bool link_box_shadow_program(struct box_shadow_shader *shader) {
 	return true;
 }
 
-bool link_blur1_program(struct blur_shader *shader) {
+static bool link_instanced_program(struct fx_program_cache *cache,
+		struct instanced_shader *shader, const GLchar *frag_src) {
 	GLuint prog;
-	shader->program = prog = link_program(blur1_frag_src);
+	shader->program = prog = link_program_with_vert(cache, instanced_vert_src, frag_src);
 	if (!shader->program) {
 		return false;
 	}
+	shader_uniform_cache_reset(&shader->uniforms);
+
+	shader->proj = glGetUniformLocation(prog, "proj");
+	shader->pos_attrib = glGetAttribLocation(prog, "pos");
+	shader->draw_box_attrib = glGetAttribLocation(prog, "draw_box");
+	shader->color_attrib = glGetAttribLocation(prog, "color");
+	shader->box_attrib = glGetAttribLocation(prog, "box");
+	shader->radius_attrib = glGetAttribLocation(prog, "radius");
+	shader->clip_box_attrib = glGetAttribLocation(prog, "clip_box");
+	shader->clip_radius_attrib = glGetAttribLocation(prog, "clip_radius");
+
+	return true;
+}
+
+bool link_quad_round_instanced_program(struct fx_program_cache *cache,
+		struct instanced_shader *shader) {
+	// Instances don't share their parameters, so only the full variant is used
+	GLchar quad_src_part[2048];
+	GLchar quad_src[8192];
+	snprintf(quad_src_part, sizeof(quad_src_part), quad_round_frag_src, true,
+		SHADER_CORNERS_PER_CORNER, true);
+	snprintf(quad_src, sizeof(quad_src), "%s\n%s", quad_src_part,
+		corner_alpha_frag_src);
+
+	return link_instanced_program(cache, shader, quad_src);
+}
+
+bool link_box_shadow_instanced_program(struct fx_program_cache *cache,
+		struct instanced_shader *shader) {
+	GLchar shadow_src_part[4096];
+	GLchar shadow_src[8192];
+	snprintf(shadow_src_part, sizeof(shadow_src_part), box_shadow_frag_src, true,
+		true);
+	snprintf(shadow_src, sizeof(shadow_src), "%s\n%s", shadow_src_part,
+		corner_alpha_frag_src);
+
+	return link_instanced_program(cache, shader, shadow_src);
+}
+
+bool link_blur1_program(struct fx_program_cache *cache,
+		struct blur_shader *shader) {
+	GLuint prog;
+	shader->program = prog = link_program(cache, blur1_frag_src);
+	if (!shader->program) {
+		return false;
+	}
+	shader_uniform_cache_reset(&shader->uniforms);
 	shader->proj = glGetUniformLocation(prog, "proj");
 	shader->tex = glGetUniformLocation(prog, "tex");
 	shader->pos_attrib = glGetAttribLocation(prog, "pos");
@@ -326,32 +513,51 @@ bool link_blur1_program(struct blur_shader *shader) {
 	return true;
 }
 
-bool link_blur2_program(struct blur_shader *shader) {
+bool link_blur2_program(struct fx_program_cache *cache,
+		struct blur_shader *shader, bool effects) {
+	GLchar blur2_src_part[2048];
+	GLchar blur2_src[4096];
+	snprintf(blur2_src_part, sizeof(blur2_src_part), blur2_frag_src, effects);
+	snprintf(blur2_src, sizeof(blur2_src), "%s\n%s", blur2_src_part,
+		effects ? color_effects_frag_src : "");
+
 	GLuint prog;
-	shader->program = prog = link_program(blur2_frag_src);
+	shader->program = prog = link_program(cache, blur2_src);
 	if (!shader->program) {
 		return false;
 	}
+	shader_uniform_cache_reset(&shader->uniforms);
 	shader->proj = glGetUniformLocation(prog, "proj");
 	shader->tex = glGetUniformLocation(prog, "tex");
 	shader->pos_attrib = glGetAttribLocation(prog, "pos");
 	shader->tex_proj = glGetUniformLocation(prog, "tex_proj");
 	shader->radius = glGetUniformLocation(prog, "radius");
 	shader->halfpixel = glGetUniformLocation(prog, "halfpixel");
+	shader->noise = glGetUniformLocation(prog, "noise");
+	shader->brightness = glGetUniformLocation(prog, "brightness");
+	shader->contrast = glGetUniformLocation(prog, "contrast");
+	shader->saturation = glGetUniformLocation(prog, "saturation");
 
 	return true;
 }
 
-bool link_blur_effects_program(struct blur_effects_shader *shader) {
+bool link_blur_effects_program(struct fx_program_cache *cache,
+		struct blur_effects_shader *shader) {
+	GLchar effects_src[4096];
+	snprintf(effects_src, sizeof(effects_src), "%s\n%s", blur_effects_frag_src,
+		color_effects_frag_src);
+
 	GLuint prog;
-	shader->program = prog = link_program(blur_effects_frag_src);
+	shader->program = prog = link_program(cache, effects_src);
 	if (!shader->program) {
 		return false;
 	}
+	shader_uniform_cache_reset(&shader->uniforms);
 	shader->proj = glGetUniformLocation(prog, "proj");
 	shader->tex = glGetUniformLocation(prog, "tex");
 	shader->pos_attrib = glGetAttribLocation(prog, "pos");
 	shader->tex_proj = glGetUniformLocation(prog, "tex_proj");
+	shader->alpha = glGetUniformLocation(prog, "alpha");
 	shader->noise = glGetUniformLocation(prog, "noise");
 	shader->brightness = glGetUniformLocation(prog, "brightness");
 	shader->contrast = glGetUniformLocation(prog, "contrast");
@@ -7,7 +7,7 @@ uniform float radius;
 uniform vec2 halfpixel;
 
 void main() {
-    vec2 uv = v_texcoord * 2.0;
+    vec2 uv = v_texcoord;
 
     vec4 sum = texture2D(tex, uv) * 4.0;
     sum += texture2D(tex, uv - halfpixel.xy * radius);
@@ -1,4 +1,15 @@
+#define EFFECTS %d
+
+#if !defined(EFFECTS)
+#error "Missing shader preamble"
+#endif
+
+// The noise needs the precision, see color_effects.frag
+#if EFFECTS && defined(GL_FRAGMENT_PRECISION_HIGH)
+precision highp float;
+#else
 precision mediump float;
+#endif
 
 varying mediump vec2 v_texcoord;
 uniform sampler2D tex;
@@ -6,8 +17,12 @@ uniform sampler2D tex;
 uniform float radius;
 uniform vec2 halfpixel;
 
+#if EFFECTS
+vec4 color_effects(vec4 color, vec2 pos);
+#endif
+
 void main() {
-    vec2 uv = v_texcoord / 2.0;
+    vec2 uv = v_texcoord;
 
     vec4 sum = texture2D(tex, uv + vec2(-halfpixel.x * 2.0, 0.0) * radius);
 
@@ -20,4 +35,9 @@ void main() {
     sum += texture2D(tex, uv + vec2(-halfpixel.x, -halfpixel.y) * radius) * 2.0;
 
     gl_FragColor = sum / 12.0;
+
+#if EFFECTS
+    // The last upsample applies the blur effects, which saves a pass
+    gl_FragColor = color_effects(gl_FragColor, uv);
+#endif
 }
@@ -1,5 +1,12 @@
 // Writeup: https://madebyevan.com/shaders/fast-rounded-rectangle-shadows/
 
+#define INSTANCED %d
+#define CLIP %d
+
+#if !defined(INSTANCED) || !defined(CLIP)
+#error "Missing shader preamble"
+#endif
+
 #ifdef GL_FRAGMENT_PRECISION_HIGH
 precision highp float;
 #else
@@ -9,16 +16,23 @@ precision mediump float;
 varying vec4 v_color;
 varying vec2 v_texcoord;
 
-uniform vec2 position;
-uniform vec2 size;
-uniform float blur_sigma;
-uniform float corner_radius;
-uniform vec2 clip_position;
-uniform vec2 clip_size;
-uniform float clip_radius_top_left;
-uniform float clip_radius_top_right;
-uniform float clip_radius_bottom_left;
-uniform float clip_radius_bottom_right;
+// Per-instance parameters arrive through varyings, see instanced.vert
+#if INSTANCED
+#define PARAMETER varying
+#else
+#define PARAMETER uniform
+#endif
+
+PARAMETER vec2 position;
+PARAMETER vec2 size;
+PARAMETER float blur_sigma;
+PARAMETER float corner_radius;
+PARAMETER vec2 clip_position;
+PARAMETER vec2 clip_size;
+PARAMETER float clip_radius_top_left;
+PARAMETER float clip_radius_top_right;
+PARAMETER float clip_radius_bottom_left;
+PARAMETER float clip_radius_bottom_right;
 
 float gaussian(float x, float sigma) {
     const float pi = 3.141592653589793;
@@ -76,8 +90,11 @@ void main() {
             gl_FragCoord.xy, blur_sigma * 0.5,
             corner_radius);
 
+    gl_FragColor = vec4(v_color.rgb, shadow_alpha);
+
+#if CLIP
     // Clipping
-    float clip_corner_alpha = corner_alpha(
+    gl_FragColor *= corner_alpha(
         clip_size - 1.5,
         clip_position + 0.75,
         true,
@@ -86,6 +103,5 @@ void main() {
         clip_radius_bottom_left,
         clip_radius_bottom_right
     );
-
-    gl_FragColor = vec4(v_color.rgb, shadow_alpha) * clip_corner_alpha;
+#endif
 }
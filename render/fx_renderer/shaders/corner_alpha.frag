@@ -55,3 +55,35 @@ float corner_alpha(vec2 size, vec2 position, bool is_cutout,
 	float result = smoothstep(0.0, 1.0, dist);
 	return is_cutout ? result : 1.0 - result;
 }
+
+// Same as corner_alpha with all four radii equal, which skips picking the
+// corner. Only valid if the corners don't overlap, i.e. radius <= size / 2.
+float corner_alpha_uniform(vec2 size, vec2 position, bool is_cutout, float radius) {
+	if (radius <= 0.0) {
+		return 1.0;
+	}
+
+	vec2 relative_pos = (gl_FragCoord.xy - position);
+
+	if (relative_pos.x < 0.0 || relative_pos.y < 0.0
+			|| relative_pos.x > size.x || relative_pos.y > size.y) {
+		if (is_cutout) {
+			return 1.0;
+		}
+		discard;
+	}
+
+	// Distance to the closest vertical and horizontal edge
+	vec2 edge_dist = min(relative_pos, size - relative_pos);
+	if (edge_dist.x > radius || edge_dist.y > radius) {
+		if (is_cutout) {
+			discard;
+		}
+		return 1.0;
+	}
+
+	float dist = length(radius - edge_dist) - radius;
+
+	float result = smoothstep(0.0, 1.0, dist);
+	return is_cutout ? result : 1.0 - result;
+}
@@ -0,0 +1,57 @@
+uniform mat3 proj;
+
+// Corner of the unit quad
+attribute vec2 pos;
+
+// Per instance: the part of the primitive drawn by this instance as x1, y1,
+// x2, y2, followed by the parameters of the primitive
+attribute vec4 draw_box;
+attribute vec4 color;
+attribute vec4 box;
+attribute vec4 radius;
+attribute vec4 clip_box;
+attribute vec4 clip_radius;
+
+varying vec4 v_color;
+varying vec2 v_texcoord;
+
+// Read by quad_round.frag and box_shadow.frag in place of their uniforms
+varying vec2 position;
+varying vec2 size;
+varying float radius_top_left;
+varying float radius_top_right;
+varying float radius_bottom_left;
+varying float radius_bottom_right;
+varying float corner_radius;
+varying float blur_sigma;
+
+varying vec2 clip_position;
+varying vec2 clip_size;
+varying float clip_radius_top_left;
+varying float clip_radius_top_right;
+varying float clip_radius_bottom_left;
+varying float clip_radius_bottom_right;
+
+void main() {
+	vec2 vertex = mix(draw_box.xy, draw_box.zw, pos);
+	gl_Position = vec4(vec3(vertex, 1.0) * proj, 1.0);
+	v_color = color;
+	v_texcoord = pos;
+
+	position = box.xy;
+	size = box.zw;
+	radius_top_left = radius.x;
+	radius_top_right = radius.y;
+	radius_bottom_left = radius.z;
+	radius_bottom_right = radius.w;
+	// Box shadows only have a single radius and a sigma
+	corner_radius = radius.x;
+	blur_sigma = radius.y;
+
+	clip_position = clip_box.xy;
+	clip_size = clip_box.zw;
+	clip_radius_top_left = clip_radius.x;
+	clip_radius_top_right = clip_radius.y;
+	clip_radius_bottom_left = clip_radius.z;
+	clip_radius_bottom_right = clip_radius.w;
+}
@@ -0,0 +1,12 @@
+uniform mat3 proj;
+attribute vec2 pos;
+attribute vec4 color;
+varying vec4 v_color;
+varying vec2 v_texcoord;
+
+void main() {
+	vec3 pos3 = vec3(pos, 1.0);
+	gl_Position = vec4(pos3 * proj, 1.0);
+	v_color = color;
+	v_texcoord = vec2(0.0);
+}
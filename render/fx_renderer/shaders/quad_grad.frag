@@ -1,5 +1,3 @@
-#define LEN %d
-
 #ifdef GL_FRAGMENT_PRECISION_HIGH
 precision highp float;
 #else
@@ -9,17 +7,15 @@ precision mediump float;
 varying vec4 v_color;
 varying vec2 v_texcoord;
 
-uniform vec4 colors[LEN];
+uniform sampler2D lut;
 uniform vec2 size;
-uniform float degree;
 uniform vec2 grad_box;
 uniform vec2 origin;
+uniform vec2 rotation;
 uniform bool linear;
-uniform bool blend;
-uniform int count;
 
-vec4 gradient(vec4 colors[LEN], int count, vec2 size, vec2 grad_box, vec2 origin, float degree, bool linear, bool blend);
+vec4 gradient(sampler2D lut, vec2 size, vec2 grad_box, vec2 origin, vec2 rotation, bool linear);
 
 void main(){
-	gl_FragColor = gradient(colors, count, size, grad_box, origin, degree, linear, blend);
+	gl_FragColor = gradient(lut, size, grad_box, origin, rotation, linear);
 }
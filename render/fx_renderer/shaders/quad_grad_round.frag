@@ -1,5 +1,3 @@
-#define LEN %d
-
 #ifdef GL_FRAGMENT_PRECISION_HIGH
 precision highp float;
 #else
@@ -17,16 +15,14 @@ uniform float radius_top_right;
 uniform float radius_bottom_left;
 uniform float radius_bottom_right;
 
-uniform vec4 colors[LEN];
+uniform sampler2D lut;
 uniform vec2 grad_size;
-uniform float degree;
 uniform vec2 grad_box;
 uniform vec2 origin;
+uniform vec2 rotation;
 uniform bool linear;
-uniform bool blend;
-uniform int count;
 
-vec4 gradient(vec4 colors[LEN], int count, vec2 size, vec2 grad_box, vec2 origin, float degree, bool linear, bool blend);
+vec4 gradient(sampler2D lut, vec2 size, vec2 grad_box, vec2 origin, vec2 rotation, bool linear);
 
 float corner_alpha(vec2 size, vec2 position, bool is_cutout,
 		float radius_tl, float radius_tr, float radius_bl, float radius_br);
@@ -44,5 +40,5 @@ void main() {
 	);
 	float rect_alpha = v_color.a * quad_corner_alpha;
 
-	gl_FragColor = mix(vec4(0.0), gradient(colors, count, size, grad_box, origin, degree, linear, blend), rect_alpha);
+	gl_FragColor = mix(vec4(0.0), gradient(lut, size, grad_box, origin, rotation, linear), rect_alpha);
 }
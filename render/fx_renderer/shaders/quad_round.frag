@@ -1,3 +1,15 @@
+#define INSTANCED %d
+#define CORNERS %d
+#define CLIP %d
+
+#define CORNERS_NONE 0
+#define CORNERS_UNIFORM 1
+#define CORNERS_PER_CORNER 2
+
+#if !defined(INSTANCED) || !defined(CORNERS) || !defined(CLIP)
+#error "Missing shader preamble"
+#endif
+
 #ifdef GL_FRAGMENT_PRECISION_HIGH
 precision highp float;
 #else
@@ -7,25 +19,43 @@ precision mediump float;
 varying vec4 v_color;
 varying vec2 v_texcoord;
 
-uniform vec2 size;
-uniform vec2 position;
-uniform float radius_top_left;
-uniform float radius_top_right;
-uniform float radius_bottom_left;
-uniform float radius_bottom_right;
+// Per-instance parameters arrive through varyings, see instanced.vert
+#if INSTANCED
+#define PARAMETER varying
+#else
+#define PARAMETER uniform
+#endif
 
-uniform vec2 clip_size;
-uniform vec2 clip_position;
-uniform float clip_radius_top_left;
-uniform float clip_radius_top_right;
-uniform float clip_radius_bottom_left;
-uniform float clip_radius_bottom_right;
+PARAMETER vec2 size;
+PARAMETER vec2 position;
+PARAMETER float radius_top_left;
+PARAMETER float radius_top_right;
+PARAMETER float radius_bottom_left;
+PARAMETER float radius_bottom_right;
+
+PARAMETER vec2 clip_size;
+PARAMETER vec2 clip_position;
+PARAMETER float clip_radius_top_left;
+PARAMETER float clip_radius_top_right;
+PARAMETER float clip_radius_bottom_left;
+PARAMETER float clip_radius_bottom_right;
 
 float corner_alpha(vec2 size, vec2 position, bool is_cutout,
 		float radius_tl, float radius_tr, float radius_bl, float radius_br);
+float corner_alpha_uniform(vec2 size, vec2 position, bool is_cutout, float radius);
 
 void main() {
-	float quad_corner_alpha = corner_alpha(
+	gl_FragColor = v_color;
+
+#if CORNERS == CORNERS_UNIFORM
+	gl_FragColor *= corner_alpha_uniform(
+		size - 1.0,
+		position + 0.5,
+		false,
+		radius_top_left
+	);
+#elif CORNERS == CORNERS_PER_CORNER
+	gl_FragColor *= corner_alpha(
 		size - 1.0,
 		position + 0.5,
 		false,
@@ -34,9 +64,11 @@ void main() {
 		radius_bottom_left,
 		radius_bottom_right
 	);
+#endif
 
+#if CLIP
 	// Clipping
-	float clip_corner_alpha = corner_alpha(
+	gl_FragColor *= corner_alpha(
 		clip_size - 1.0,
 		clip_position + 0.5,
 		true,
@@ -45,6 +77,5 @@ void main() {
 		clip_radius_bottom_left,
 		clip_radius_bottom_right
 	);
-
-	gl_FragColor = v_color * quad_corner_alpha * clip_corner_alpha;
+#endif
 }
@@ -1,11 +1,17 @@
 #define SOURCE %d
-#define EFFECTS %d
+#define CORNERS %d
+#define CLIP %d
+#define DISCARD %d
 
 #define SOURCE_TEXTURE_RGBA 1
 #define SOURCE_TEXTURE_RGBX 2
 #define SOURCE_TEXTURE_EXTERNAL 3
 
-#if !defined(SOURCE) || !defined(EFFECTS)
+#define CORNERS_NONE 0
+#define CORNERS_UNIFORM 1
+#define CORNERS_PER_CORNER 2
+
+#if !defined(SOURCE) || !defined(CORNERS) || !defined(CLIP) || !defined(DISCARD)
 #error "Missing shader preamble"
 #endif
 
@@ -29,14 +35,16 @@ uniform sampler2D tex;
 
 uniform float alpha;
 
-#if EFFECTS
+#if CORNERS != CORNERS_NONE
 uniform vec2 size;
 uniform vec2 position;
 uniform float radius_top_left;
 uniform float radius_top_right;
 uniform float radius_bottom_left;
 uniform float radius_bottom_right;
+#endif
 
+#if CLIP
 uniform vec2 clip_size;
 uniform vec2 clip_position;
 uniform float clip_radius_top_left;
@@ -45,7 +53,9 @@ uniform float clip_radius_bottom_left;
 uniform float clip_radius_bottom_right;
 #endif
 
+#if DISCARD
 uniform bool discard_transparent;
+#endif
 
 vec4 sample_texture() {
 #if SOURCE == SOURCE_TEXTURE_RGBA || SOURCE == SOURCE_TEXTURE_EXTERNAL
@@ -55,14 +65,24 @@ vec4 sample_texture() {
 #endif
 }
 
-#if EFFECTS
+#if CORNERS != CORNERS_NONE || CLIP
 float corner_alpha(vec2 size, vec2 position, bool is_cutout,
 		float radius_tl, float radius_tr, float radius_bl, float radius_br);
+float corner_alpha_uniform(vec2 size, vec2 position, bool is_cutout, float radius);
 #endif
 
 void main() {
-#if EFFECTS
-	float quad_corner_alpha = corner_alpha(
+	gl_FragColor = sample_texture() * alpha;
+
+#if CORNERS == CORNERS_UNIFORM
+	gl_FragColor *= corner_alpha_uniform(
+		size - 0.5,
+		position + 0.25,
+		false,
+		radius_top_left
+	);
+#elif CORNERS == CORNERS_PER_CORNER
+	gl_FragColor *= corner_alpha(
 		size - 0.5,
 		position + 0.25,
 		false,
@@ -71,9 +91,11 @@ void main() {
 		radius_bottom_left,
 		radius_bottom_right
 	);
+#endif
 
+#if CLIP
 	// Clipping
-	float clip_corner_alpha = corner_alpha(
+	gl_FragColor *= corner_alpha(
 		clip_size - 1.0,
 		clip_position + 0.5,
 		true,
@@ -82,13 +104,11 @@ void main() {
 		clip_radius_bottom_left,
 		clip_radius_bottom_right
 	);
-
-	gl_FragColor = sample_texture() * alpha * quad_corner_alpha * clip_corner_alpha;
-#else
-	gl_FragColor = sample_texture() * alpha;
 #endif
 
+#if DISCARD
 	if (discard_transparent && gl_FragColor.a == 0.0) {
 		discard;
 	}
+#endif
 }
@@ -0,0 +1,220 @@
+#include <assert.h>
+#include <stdlib.h>
+#include <wlr/util/log.h>
+
+#include "types/scene/spatial_index.h"
+
+#define SPATIAL_INDEX_CELL_SIZE 256
+// Nodes covering more cells than this are stored in the large list
+#define SPATIAL_INDEX_MAX_CELLS 64
+
+struct spatial_index_entry {
+	int cx, cy;
+	struct wlr_scene_node *node;
+};
+
+struct cell_range {
+	int x1, y1, x2, y2; // inclusive
+};
+
+static int cell_coord(int v) {
+	// Round towards negative infinity
+	if (v >= 0) {
+		return v / SPATIAL_INDEX_CELL_SIZE;
+	}
+	return -((-v + SPATIAL_INDEX_CELL_SIZE - 1) / SPATIAL_INDEX_CELL_SIZE);
+}
+
+static struct cell_range box_cell_range(const struct wlr_box *box) {
+	return (struct cell_range){
+		.x1 = cell_coord(box->x),
+		.y1 = cell_coord(box->y),
+		.x2 = cell_coord(box->x + box->width - 1),
+		.y2 = cell_coord(box->y + box->height - 1),
+	};
+}
+
+static size_t cell_range_count(const struct cell_range *range) {
+	return (size_t)(range->x2 - range->x1 + 1) *
+		(size_t)(range->y2 - range->y1 + 1);
+}
+
+static bool cell_range_contains(const struct cell_range *range, int cx, int cy) {
+	return cx >= range->x1 && cx <= range->x2 &&
+		cy >= range->y1 && cy <= range->y2;
+}
+
+static struct wl_array *cell_bucket(struct scene_spatial_index *index,
+		int cx, int cy) {
+	uint32_t hash = ((uint32_t)cx * 73856093u) ^ ((uint32_t)cy * 19349663u);
+	return &index->buckets[hash % SPATIAL_INDEX_BUCKETS];
+}
+
+struct scene_spatial_index *spatial_index_create(void) {
+	struct scene_spatial_index *index = calloc(1, sizeof(*index));
+	if (index == NULL) {
+		wlr_log(WLR_ERROR, "Failed to allocate scene spatial index");
+		return NULL;
+	}
+
+	for (size_t i = 0; i < SPATIAL_INDEX_BUCKETS; i++) {
+		wl_array_init(&index->buckets[i]);
+	}
+	wl_array_init(&index->large);
+
+	return index;
+}
+
+void spatial_index_destroy(struct scene_spatial_index *index) {
+	if (index == NULL) {
+		return;
+	}
+
+	for (size_t i = 0; i < SPATIAL_INDEX_BUCKETS; i++) {
+		wl_array_release(&index->buckets[i]);
+	}
+	wl_array_release(&index->large);
+	free(index);
+}
+
+static void bucket_remove(struct wl_array *bucket,
+		struct wlr_scene_node *node, int cx, int cy) {
+	struct spatial_index_entry *entries = bucket->data;
+	size_t len = bucket->size / sizeof(*entries);
+	for (size_t i = 0; i < len; i++) {
+		if (entries[i].node == node && entries[i].cx == cx && entries[i].cy == cy) {
+			entries[i] = entries[len - 1];
+			bucket->size -= sizeof(*entries);
+			return;
+		}
+	}
+
+	assert(false && "indexed node missing from its cell");
+}
+
+void spatial_index_remove(struct scene_spatial_index *index,
+		struct wlr_scene_node *node) {
+	if (!node->indexed) {
+		return;
+	}
+	node->indexed = false;
+
+	struct cell_range range = box_cell_range(&node->index_box);
+	if (cell_range_count(&range) > SPATIAL_INDEX_MAX_CELLS) {
+		struct wlr_scene_node **nodes = index->large.data;
+		size_t len = index->large.size / sizeof(*nodes);
+		for (size_t i = 0; i < len; i++) {
+			if (nodes[i] == node) {
+				nodes[i] = nodes[len - 1];
+				index->large.size -= sizeof(*nodes);
+				return;
+			}
+		}
+
+		assert(false && "indexed node missing from the large list");
+		return;
+	}
+
+	for (int cy = range.y1; cy <= range.y2; cy++) {
+		for (int cx = range.x1; cx <= range.x2; cx++) {
+			bucket_remove(cell_bucket(index, cx, cy), node, cx, cy);
+		}
+	}
+}
+
+void spatial_index_update(struct scene_spatial_index *index,
+		struct wlr_scene_node *node, const struct wlr_box *box) {
+	if (node->indexed && wlr_box_equal(&node->index_box, box)) {
+		return;
+	}
+
+	spatial_index_remove(index, node);
+
+	if (wlr_box_empty(box)) {
+		return;
+	}
+
+	struct cell_range range = box_cell_range(box);
+	if (cell_range_count(&range) > SPATIAL_INDEX_MAX_CELLS) {
+		struct wlr_scene_node **entry = wl_array_add(&index->large, sizeof(*entry));
+		if (entry == NULL) {
+			wlr_log(WLR_ERROR, "Failed to grow scene spatial index");
+			return;
+		}
+		*entry = node;
+	} else {
+		for (int cy = range.y1; cy <= range.y2; cy++) {
+			for (int cx = range.x1; cx <= range.x2; cx++) {
+				struct wl_array *bucket = cell_bucket(index, cx, cy);
+				struct spatial_index_entry *entry = wl_array_add(bucket, sizeof(*entry));
+				if (entry == NULL) {
+					// Undo the partial insertion to keep the index consistent
+					for (int ry = range.y1; ry <= cy; ry++) {
+						for (int rx = range.x1; rx <= range.x2; rx++) {
+							if (ry == cy && rx == cx) {
+								break;
+							}
+							bucket_remove(cell_bucket(index, rx, ry), node, rx, ry);
+						}
+					}
+					wlr_log(WLR_ERROR, "Failed to grow scene spatial index");
+					return;
+				}
+				*entry = (struct spatial_index_entry){
+					.cx = cx,
+					.cy = cy,
+					.node = node,
+				};
+			}
+		}
+	}
+
+	node->indexed = true;
+	node->index_box = *box;
+}
+
+static void bucket_query(struct wl_array *bucket, const struct wlr_box *box,
+		const struct cell_range *range, spatial_index_iterator_func_t iterator,
+		void *data) {
+	struct wlr_box intersection;
+	struct spatial_index_entry *entry;
+	wl_array_for_each(entry, bucket) {
+		if (cell_range_contains(range, entry->cx, entry->cy) &&
+				wlr_box_intersection(&intersection, &entry->node->index_box, box)) {
+			iterator(entry->node, data);
+		}
+	}
+}
+
+void spatial_index_query(struct scene_spatial_index *index,
+		const struct wlr_box *box, spatial_index_iterator_func_t iterator,
+		void *data) {
+	if (wlr_box_empty(box)) {
+		return;
+	}
+
+	struct wlr_box intersection;
+	struct wlr_scene_node **large;
+	wl_array_for_each(large, &index->large) {
+		if (wlr_box_intersection(&intersection, &(*large)->index_box, box)) {
+			iterator(*large, data);
+		}
+	}
+
+	struct cell_range range = box_cell_range(box);
+	if (cell_range_count(&range) >= SPATIAL_INDEX_BUCKETS) {
+		// Cheaper to scan every bucket once than to revisit the same buckets
+		// for several cells
+		for (size_t i = 0; i < SPATIAL_INDEX_BUCKETS; i++) {
+			bucket_query(&index->buckets[i], box, &range, iterator, data);
+		}
+		return;
+	}
+
+	for (int cy = range.y1; cy <= range.y2; cy++) {
+		for (int cx = range.x1; cx <= range.x2; cx++) {
+			struct cell_range cell = { cx, cy, cx, cy };
+			bucket_query(cell_bucket(index, cx, cy), box, &cell, iterator, data);
+		}
+	}
+}
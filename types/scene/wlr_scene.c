@@ -1,5 +1,6 @@
 #include <assert.h>
 #include <pixman.h>
+#include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -25,6 +26,7 @@
 #include "scenefx/types/fx/clipped_region.h"
 #include "scenefx/types/wlr_scene.h"
 #include "types/fx/clipped_region.h"
+#include "types/scene/spatial_index.h"
 #include "types/wlr_output.h"
 #include "types/wlr_scene.h"
 #include "util/array.h"
@@ -39,6 +41,32 @@
 
 #define DMABUF_FEEDBACK_DEBOUNCE_FRAMES  30
 #define HIGHLIGHT_DAMAGE_FADEOUT_TIME   250
+// Past this many changed nodes, the render list is rebuilt instead of patched
+#define RENDER_LIST_MAX_DIRTY_NODES     32
+// Maximum number of destroyed nodes kept for reuse, per node type
+#define NODE_POOL_MAX_SIZE              64
+// Written over pooled nodes, so a use after destroy reads garbage
+#define NODE_POOL_POISON                0xa5
+
+// AddressSanitizer can only catch a use after destroy if nodes are freed
+#if defined(__SANITIZE_ADDRESS__)
+#define NODE_POOL_DEFAULT_MAX_SIZE      0
+#elif defined(__has_feature)
+#if __has_feature(address_sanitizer)
+#define NODE_POOL_DEFAULT_MAX_SIZE      0
+#endif
+#endif
+#ifndef NODE_POOL_DEFAULT_MAX_SIZE
+#define NODE_POOL_DEFAULT_MAX_SIZE      NODE_POOL_MAX_SIZE
+#endif
+
+// The node pools rely on the node being the first member of every node type
+static_assert(offsetof(struct wlr_scene_tree, node) == 0, "");
+static_assert(offsetof(struct wlr_scene_rect, node) == 0, "");
+static_assert(offsetof(struct wlr_scene_buffer, node) == 0, "");
+static_assert(offsetof(struct wlr_scene_shadow, node) == 0, "");
+static_assert(offsetof(struct wlr_scene_optimized_blur, node) == 0, "");
+static_assert(offsetof(struct wlr_scene_blur, node) == 0, "");
 
 struct wlr_scene_tree *wlr_scene_tree_from_node(struct wlr_scene_node *node) {
 	assert(node->type == WLR_SCENE_NODE_TREE);
@@ -80,18 +108,165 @@ struct wlr_scene_blur *wlr_scene_blur_from_node(struct wlr_scene_node *node) {
 }
 
 struct wlr_scene *scene_node_get_root(struct wlr_scene_node *node) {
-	struct wlr_scene_tree *tree;
+	return node->scene;
+}
+
+// Invalidates the cached layout coordinates of the node and all of its
+// descendants. Must be called whenever the position, the enabled state or the
+// parent of the node changes.
+static void scene_node_invalidate_coords(struct wlr_scene_node *node) {
+	// Descendants of a dirty node are always dirty as well
+	if (node->coords_dirty) {
+		return;
+	}
+	node->coords_dirty = true;
+
 	if (node->type == WLR_SCENE_NODE_TREE) {
-		tree = wlr_scene_tree_from_node(node);
+		struct wlr_scene_tree *scene_tree = wlr_scene_tree_from_node(node);
+		struct wlr_scene_node *child;
+		wl_list_for_each(child, &scene_tree->children, link) {
+			scene_node_invalidate_coords(child);
+		}
+	}
+}
+
+static void scene_node_update_coords(struct wlr_scene_node *node) {
+	if (!node->coords_dirty) {
+		return;
+	}
+
+	if (node->parent != NULL) {
+		struct wlr_scene_node *parent = &node->parent->node;
+		scene_node_update_coords(parent);
+		node->layout_x = parent->layout_x + node->x;
+		node->layout_y = parent->layout_y + node->y;
+		node->layout_enabled = parent->layout_enabled && node->enabled;
 	} else {
-		tree = node->parent;
+		node->layout_x = node->x;
+		node->layout_y = node->y;
+		node->layout_enabled = node->enabled;
+	}
+	node->coords_dirty = false;
+}
+
+// Invalidates the render lists of all outputs. Must be called whenever the
+// set of enabled nodes, their order or their position changes.
+static void scene_structure_changed(struct wlr_scene *scene) {
+	scene->structure_generation++;
+
+	struct wlr_scene_output *scene_output;
+	wl_list_for_each(scene_output, &scene->outputs, link) {
+		scene_output->render_list_dirty.size = 0;
 	}
+}
+
+// Queues the node for re-evaluation of its render list membership on all
+// outputs, for changes which don't affect the structure of the scene.
+static void scene_node_render_list_dirty(struct wl_list *outputs,
+		struct wlr_scene_node *node) {
+	struct wlr_scene_output *scene_output;
+	wl_list_for_each(scene_output, outputs, link) {
+		if (scene_output->render_list_generation !=
+				scene_output->scene->structure_generation) {
+			// Will be rebuilt anyway
+			continue;
+		}
 
-	while (tree->node.parent != NULL) {
-		tree = tree->node.parent;
+		struct wl_array *dirty = &scene_output->render_list_dirty;
+		struct wlr_scene_node **dirty_node;
+		bool found = false;
+		wl_array_for_each(dirty_node, dirty) {
+			if (*dirty_node == node) {
+				found = true;
+				break;
+			}
+		}
+		if (found) {
+			continue;
+		}
+
+		if (dirty->size >= RENDER_LIST_MAX_DIRTY_NODES * sizeof(*dirty_node) ||
+				(dirty_node = wl_array_add(dirty, sizeof(*dirty_node))) == NULL) {
+			scene_output->render_list_generation = 0;
+			dirty->size = 0;
+			continue;
+		}
+		*dirty_node = node;
 	}
-	struct wlr_scene *scene = wl_container_of(tree, scene, tree);
-	return scene;
+}
+
+static size_t scene_node_size(enum wlr_scene_node_type type) {
+	switch (type) {
+	case WLR_SCENE_NODE_TREE:
+		return sizeof(struct wlr_scene_tree);
+	case WLR_SCENE_NODE_RECT:
+		return sizeof(struct wlr_scene_rect);
+	case WLR_SCENE_NODE_SHADOW:
+		return sizeof(struct wlr_scene_shadow);
+	case WLR_SCENE_NODE_OPTIMIZED_BLUR:
+		return sizeof(struct wlr_scene_optimized_blur);
+	case WLR_SCENE_NODE_BLUR:
+		return sizeof(struct wlr_scene_blur);
+	case WLR_SCENE_NODE_BUFFER:
+		return sizeof(struct wlr_scene_buffer);
+	}
+	abort();
+}
+
+// Allocates a zeroed node of the given type, reusing a previously destroyed
+// node if possible.
+static void *scene_node_alloc(struct wlr_scene *scene,
+		enum wlr_scene_node_type type, size_t size) {
+	struct wl_list *pool = &scene->node_pools[type];
+	if (!wl_list_empty(pool)) {
+		struct wlr_scene_node *node = wl_container_of(pool->next, node, link);
+		wl_list_remove(&node->link);
+		scene->node_pool_sizes[type]--;
+		scene->allocation_stats.node_pooled--;
+		scene->allocation_stats.node_reuses++;
+
+		memset(node, 0, size);
+		return node;
+	}
+
+	void *node = calloc(1, size);
+	if (node != NULL) {
+		scene->allocation_stats.node_allocs++;
+	}
+	return node;
+}
+
+static void scene_node_free(struct wlr_scene *scene, struct wlr_scene_node *node) {
+	if (scene->node_pool_sizes[node->type] >= scene->node_pool_max_size) {
+		scene->allocation_stats.node_frees++;
+		free(node);
+		return;
+	}
+
+	enum wlr_scene_node_type type = node->type;
+	memset(node, NODE_POOL_POISON, scene_node_size(type));
+	node->type = type;
+	scene->node_pool_sizes[node->type]++;
+	scene->allocation_stats.node_pooled++;
+	wl_list_insert(&scene->node_pools[node->type], &node->link);
+}
+
+static void scene_release_node_pools(struct wlr_scene *scene) {
+	for (size_t i = 0; i < sizeof(scene->node_pools) / sizeof(scene->node_pools[0]); i++) {
+		struct wlr_scene_node *node, *tmp;
+		wl_list_for_each_safe(node, tmp, &scene->node_pools[i], link) {
+			wl_list_remove(&node->link);
+			scene->allocation_stats.node_frees++;
+			free(node);
+		}
+		scene->node_pool_sizes[i] = 0;
+	}
+	scene->allocation_stats.node_pooled = 0;
+}
+
+void wlr_scene_get_allocation_stats(struct wlr_scene *scene,
+		struct wlr_scene_allocation_stats *stats) {
+	*stats = scene->allocation_stats;
 }
 
 static void scene_node_init(struct wlr_scene_node *node,
@@ -100,15 +275,20 @@ static void scene_node_init(struct wlr_scene_node *node,
 		.type = type,
 		.parent = parent,
 		.enabled = true,
+		.scene = parent != NULL ? parent->node.scene : NULL,
+		.coords_dirty = true,
+		.opaque_dirty = true,
 	};
 
 	wl_list_init(&node->link);
 
 	wl_signal_init(&node->events.destroy);
 	pixman_region32_init(&node->visible);
+	pixman_region32_init(&node->opaque);
 
 	if (parent != NULL) {
 		wl_list_insert(parent->children.prev, &node->link);
+		scene_structure_changed(scene_node_get_root(&parent->node));
 	}
 
 	wlr_addon_set_init(&node->addons);
@@ -120,10 +300,36 @@ struct highlight_region {
 	struct wl_list link;
 };
 
+// The blurred backdrop of a blur node on an output, kept across frames
+struct scene_blur_cache {
+	struct wl_list link; // wlr_scene_output.blur_caches
+	struct wlr_scene_blur *blur;
+	struct fx_blur_cache cache;
+	// Where the cache holds the blur of the current backdrop, in buffer
+	// coordinates
+	pixman_region32_t valid;
+};
+
+// Output damage since the last render, see scene_output_add_blur_damage
+struct scene_blur_damage {
+	// The buffer node whose contents changed, NULL if the damage may come
+	// from anywhere in the scene
+	struct wlr_scene_node *node;
+	pixman_region32_t region;
+	// Index of the node in the render list, see scene_output_update_blur_caches
+	int list_index;
+};
+
+static void scene_node_drop_blur_state(struct wlr_scene *scene,
+	struct wlr_scene_node *node);
+
 static void scene_buffer_set_buffer(struct wlr_scene_buffer *scene_buffer,
 	struct wlr_buffer *buffer);
 static void scene_buffer_set_texture(struct wlr_scene_buffer *scene_buffer,
 	struct wlr_texture *texture);
+static bool scene_buffer_is_black_opaque(struct wlr_scene_buffer *scene_buffer);
+static void scene_transaction_forget_node(struct wlr_scene *scene,
+	struct wlr_scene_node *node);
 
 void wlr_scene_node_destroy(struct wlr_scene_node *node) {
 	if (node == NULL) {
@@ -153,6 +359,7 @@ void wlr_scene_node_destroy(struct wlr_scene_node *node) {
 			}
 		}
 
+		scene_node_drop_blur_state(scene, node);
 		scene_buffer_set_buffer(scene_buffer, NULL);
 		scene_buffer_set_texture(scene_buffer, NULL);
 		pixman_region32_fini(&scene_buffer->opaque_region);
@@ -177,6 +384,9 @@ void wlr_scene_node_destroy(struct wlr_scene_node *node) {
 			wl_list_remove(&scene->linux_dmabuf_v1_destroy.link);
 			wl_list_remove(&scene->gamma_control_manager_v1_destroy.link);
 			wl_list_remove(&scene->gamma_control_manager_v1_set_gamma.link);
+
+			// Discard anything still pending, there's nothing left to update
+			scene->transaction_depth = 0;
 		} else {
 			assert(node->parent);
 		}
@@ -186,16 +396,42 @@ void wlr_scene_node_destroy(struct wlr_scene_node *node) {
 				&scene_tree->children, link) {
 			wlr_scene_node_destroy(child);
 		}
+
+		if (scene_tree == &scene->tree) {
+			spatial_index_destroy(scene->spatial_index);
+			scene->spatial_index = NULL;
+			pixman_region32_fini(&scene->transaction_update_region);
+			pixman_region32_fini(&scene->transaction_damage);
+			wl_array_release(&scene->transaction_nodes);
+		}
 	} else if (node->type == WLR_SCENE_NODE_BLUR) {
 		struct wlr_scene_blur *blur = wlr_scene_blur_from_node(node);
+		scene_node_drop_blur_state(scene, node);
 		linked_node_destroy(&blur->transparency_mask_source);
 	}
 
+	if (node->type != WLR_SCENE_NODE_TREE && scene->spatial_index != NULL) {
+		spatial_index_remove(scene->spatial_index, node);
+	}
+	if (node->transaction_pending) {
+		scene_transaction_forget_node(scene, node);
+	}
+
+	// Drop any references to this node from the render lists
+	scene_structure_changed(scene);
+
 	assert(wl_list_empty(&node->events.destroy.listener_list));
 
 	wl_list_remove(&node->link);
 	pixman_region32_fini(&node->visible);
-	free(node);
+	pixman_region32_fini(&node->opaque);
+
+	if (node == &scene->tree.node) {
+		scene_release_node_pools(scene);
+		free(scene);
+	} else {
+		scene_node_free(scene, node);
+	}
 }
 
 static void scene_tree_init(struct wlr_scene_tree *tree,
@@ -212,6 +448,11 @@ struct wlr_scene *wlr_scene_create(void) {
 	}
 
 	scene_tree_init(&scene->tree, NULL);
+	scene->tree.node.scene = scene;
+
+	for (size_t i = 0; i < sizeof(scene->node_pools) / sizeof(scene->node_pools[0]); i++) {
+		wl_list_init(&scene->node_pools[i]);
+	}
 
 	wl_list_init(&scene->outputs);
 	wl_list_init(&scene->linux_dmabuf_v1_destroy.link);
@@ -219,6 +460,10 @@ struct wlr_scene *wlr_scene_create(void) {
 	wl_list_init(&scene->gamma_control_manager_v1_set_gamma.link);
 
 	scene->restack_xwayland_surfaces = true;
+	scene->structure_generation = 1;
+	pixman_region32_init(&scene->transaction_update_region);
+	pixman_region32_init(&scene->transaction_damage);
+	wl_array_init(&scene->transaction_nodes);
 
 	const char *debug_damage_options[] = {
 		"none",
@@ -231,6 +476,12 @@ struct wlr_scene *wlr_scene_create(void) {
 	scene->direct_scanout = !env_parse_bool("WLR_SCENE_DISABLE_DIRECT_SCANOUT");
 	scene->calculate_visibility = !env_parse_bool("WLR_SCENE_DISABLE_VISIBILITY");
 	scene->highlight_transparent_region = env_parse_bool("WLR_SCENE_HIGHLIGHT_TRANSPARENT_REGION");
+	scene->node_pool_max_size = env_parse_bool("WLR_SCENE_DISABLE_NODE_POOL") ?
+		0 : NODE_POOL_DEFAULT_MAX_SIZE;
+	if (!env_parse_bool("WLR_SCENE_DISABLE_SPATIAL_INDEX")) {
+		// Falls back to walking the whole tree if the allocation fails
+		scene->spatial_index = spatial_index_create();
+	}
 
 	scene->blur_data = blur_data_get_default();
 
@@ -240,7 +491,8 @@ struct wlr_scene *wlr_scene_create(void) {
 struct wlr_scene_tree *wlr_scene_tree_create(struct wlr_scene_tree *parent) {
 	assert(parent);
 
-	struct wlr_scene_tree *tree = calloc(1, sizeof(*tree));
+	struct wlr_scene_tree *tree = scene_node_alloc(parent->node.scene,
+		WLR_SCENE_NODE_TREE, sizeof(*tree));
 	if (tree == NULL) {
 		return NULL;
 	}
@@ -249,21 +501,109 @@ struct wlr_scene_tree *wlr_scene_tree_create(struct wlr_scene_tree *parent) {
 	return tree;
 }
 
+static void box_union(struct wlr_box *dest, const struct wlr_box *box) {
+	if (wlr_box_empty(box)) {
+		return;
+	}
+	if (wlr_box_empty(dest)) {
+		*dest = *box;
+		return;
+	}
+
+	int x1 = dest->x < box->x ? dest->x : box->x;
+	int y1 = dest->y < box->y ? dest->y : box->y;
+	int x2 = dest->x + dest->width > box->x + box->width ?
+		dest->x + dest->width : box->x + box->width;
+	int y2 = dest->y + dest->height > box->y + box->height ?
+		dest->y + dest->height : box->y + box->height;
+	*dest = (struct wlr_box){
+		.x = x1,
+		.y = y1,
+		.width = x2 - x1,
+		.height = y2 - y1,
+	};
+}
+
+// Returns the bounding box of all enabled descendants of the tree, relative
+// to the tree itself.
+static const struct wlr_box *scene_tree_get_bounds(struct wlr_scene_tree *tree) {
+	if (!tree->bounds_dirty) {
+		return &tree->bounds;
+	}
+
+	struct wlr_box bounds = {0};
+	struct wlr_scene_node *child;
+	wl_list_for_each(child, &tree->children, link) {
+		if (!child->enabled) {
+			continue;
+		}
+
+		struct wlr_box child_box;
+		if (child->type == WLR_SCENE_NODE_TREE) {
+			child_box = *scene_tree_get_bounds(wlr_scene_tree_from_node(child));
+		} else {
+			child_box = (struct wlr_box){0};
+			scene_node_get_size(child, &child_box.width, &child_box.height);
+		}
+		child_box.x += child->x;
+		child_box.y += child->y;
+		box_union(&bounds, &child_box);
+	}
+
+	tree->bounds = bounds;
+	tree->bounds_dirty = false;
+	return &tree->bounds;
+}
+
+// Invalidates the cached bounds of all ancestors of the node. Must be called
+// whenever the node is moved, resized, enabled, disabled or unlinked.
+static void scene_node_invalidate_bounds(struct wlr_scene_node *node) {
+	// A dirty tree always has dirty ancestors, so we can stop early
+	for (struct wlr_scene_tree *tree = node->parent;
+			tree != NULL && !tree->bounds_dirty; tree = tree->node.parent) {
+		tree->bounds_dirty = true;
+	}
+}
+
+// Checks whether the enabled descendants of a tree located at lx, ly
+// (in layout coordinates) may intersect the box.
+static bool scene_tree_intersects_box(struct wlr_scene_tree *tree,
+		int lx, int ly, const struct wlr_box *box) {
+	struct wlr_box bounds = *scene_tree_get_bounds(tree);
+	bounds.x += lx;
+	bounds.y += ly;
+
+	struct wlr_box intersection;
+	return wlr_box_intersection(&intersection, &bounds, box);
+}
+
 typedef bool (*scene_node_box_iterator_func_t)(struct wlr_scene_node *node,
 	int sx, int sy, void *data);
 
+// Walks the enabled nodes intersecting the box, top-most first. If mark is
+// non-zero, only nodes marked by a spatial index query are visited.
 static bool _scene_nodes_in_box(struct wlr_scene_node *node, struct wlr_box *box,
-		scene_node_box_iterator_func_t iterator, void *user_data, int lx, int ly) {
+		scene_node_box_iterator_func_t iterator, void *user_data, int lx, int ly,
+		uint32_t mark) {
 	if (!node->enabled) {
 		return false;
 	}
+	if (mark != 0 && node->index_mark != mark) {
+		return false;
+	}
 
 	switch (node->type) {
 	case WLR_SCENE_NODE_TREE:;
 		struct wlr_scene_tree *scene_tree = wlr_scene_tree_from_node(node);
+		// The index marks already prune subtrees outside of the box
+		if (mark == 0 && !scene_tree_intersects_box(scene_tree, lx, ly, box)) {
+			return false;
+		}
+
 		struct wlr_scene_node *child;
 		wl_list_for_each_reverse(child, &scene_tree->children, link) {
-			if (_scene_nodes_in_box(child, box, iterator, user_data, lx + child->x, ly + child->y)) {
+			if (_scene_nodes_in_box(child, box, iterator, user_data,
+					lx + child->x, ly + child->y, mark)) {
 				return true;
 			}
 		}
@@ -286,12 +626,45 @@ static bool _scene_nodes_in_box(struct wlr_scene_node *node, struct wlr_box *box
 	return false;
 }
 
+static void scene_node_index_mark_iterator(struct wlr_scene_node *node,
+		void *data) {
+	uint32_t mark = *(uint32_t *)data;
+
+	// Mark the node and its ancestors, so that the tree walk only descends
+	// into subtrees holding a query result. Stop at the first ancestor which
+	// was already marked by a previous result.
+	while (node->index_mark != mark) {
+		node->index_mark = mark;
+		if (node->parent == NULL) {
+			break;
+		}
+		node = &node->parent->node;
+	}
+}
+
 static bool scene_nodes_in_box(struct wlr_scene_node *node, struct wlr_box *box,
 		scene_node_box_iterator_func_t iterator, void *user_data) {
 	int x, y;
-	wlr_scene_node_coords(node, &x, &y);
+	bool enabled = wlr_scene_node_coords(node, &x, &y);
 
-	return _scene_nodes_in_box(node, box, iterator, user_data, x, y);
+	// The index only holds nodes which are enabled all the way up to the
+	// root. Nested queries (from signal handlers invoked by the iterator)
+	// walk the tree instead so they don't clobber the marks of the outer one.
+	struct scene_spatial_index *index = scene_node_get_root(node)->spatial_index;
+	if (!enabled || index == NULL || index->querying) {
+		return _scene_nodes_in_box(node, box, iterator, user_data, x, y, 0);
+	}
+
+	if (++index->query_mark == 0) {
+		index->query_mark = 1;
+	}
+	uint32_t mark = index->query_mark;
+	spatial_index_query(index, box, scene_node_index_mark_iterator, &mark);
+
+	index->querying = true;
+	bool ret = _scene_nodes_in_box(node, box, iterator, user_data, x, y, mark);
+	index->querying = false;
+	return ret;
 }
 
 static pixman_region32_t create_corner_location_region(struct fx_corner_radii corners, int x, int y, int width, int height) {
@@ -320,7 +693,7 @@ static pixman_region32_t create_corner_location_region(struct fx_corner_radii co
 	return corner_region;
 }
 
-static void scene_node_opaque_region(struct wlr_scene_node *node, int x, int y,
+static void scene_node_build_opaque_region(struct wlr_scene_node *node,
 		pixman_region32_t *opaque) {
 	int width, height;
 	scene_node_get_size(node, &width, &height);
@@ -332,11 +705,11 @@ static void scene_node_opaque_region(struct wlr_scene_node *node, int x, int y,
 		}
 
 		pixman_region32_fini(opaque);
-		pixman_region32_init_rect(opaque, x, y, width, height);
+		pixman_region32_init_rect(opaque, 0, 0, width, height);
 
 		// subtract corners from opaque region
 		if (!fx_corner_radii_is_empty(&scene_rect->corners)) {
-			pixman_region32_t corners = create_corner_location_region(scene_rect->corners, x, y, width, height);
+			pixman_region32_t corners = create_corner_location_region(scene_rect->corners, 0, 0, width, height);
 			pixman_region32_subtract(opaque, opaque, &corners);
 			pixman_region32_fini(&corners);
 		}
@@ -345,7 +718,7 @@ static void scene_node_opaque_region(struct wlr_scene_node *node, int x, int y,
 		if (!wlr_box_empty(&scene_rect->clipped_region.area)) {
 			struct wlr_box *clipped = &scene_rect->clipped_region.area;
 			pixman_region32_t clipped_region;
-			pixman_region32_init_rect(&clipped_region, clipped->x + x, clipped->y + y,
+			pixman_region32_init_rect(&clipped_region, clipped->x, clipped->y,
 					clipped->width, clipped->height);
 			pixman_region32_subtract(opaque, opaque, &clipped_region);
 			pixman_region32_fini(&clipped_region);
@@ -365,15 +738,14 @@ static void scene_node_opaque_region(struct wlr_scene_node *node, int x, int y,
 		if (!scene_buffer->buffer_is_opaque) {
 			pixman_region32_copy(opaque, &scene_buffer->opaque_region);
 			pixman_region32_intersect_rect(opaque, opaque, 0, 0, width, height);
-			pixman_region32_translate(opaque, x, y);
 		} else {
 			pixman_region32_fini(opaque);
-			pixman_region32_init_rect(opaque, x, y, width, height);
+			pixman_region32_init_rect(opaque, 0, 0, width, height);
 		}
 
 		// subtract the corners from the opaque region
 		if (!fx_corner_radii_is_empty(&scene_buffer->corners)) {
-			pixman_region32_t corners = create_corner_location_region(scene_buffer->corners, x, y, width, height);
+			pixman_region32_t corners = create_corner_location_region(scene_buffer->corners, 0, 0, width, height);
 			pixman_region32_subtract(opaque, opaque, &corners);
 			pixman_region32_fini(&corners);
 		}
@@ -388,16 +760,37 @@ static void scene_node_opaque_region(struct wlr_scene_node *node, int x, int y,
 	}
 
 	pixman_region32_fini(opaque);
-	pixman_region32_init_rect(opaque, x, y, width, height);
+	pixman_region32_init_rect(opaque, 0, 0, width, height);
+}
+
+// Invalidates the cached opaque region of a node. Must be called whenever
+// anything scene_node_build_opaque_region() depends on changes.
+static void scene_node_invalidate_opaque(struct wlr_scene_node *node) {
+	node->opaque_dirty = true;
+}
+
+static void scene_node_opaque_region(struct wlr_scene_node *node, int x, int y,
+		pixman_region32_t *opaque) {
+	if (node->opaque_dirty) {
+		pixman_region32_clear(&node->opaque);
+		scene_node_build_opaque_region(node, &node->opaque);
+		node->opaque_dirty = false;
+	}
+
+	pixman_region32_copy(opaque, &node->opaque);
+	pixman_region32_translate(opaque, x, y);
 }
 
 struct scene_update_data {
 	pixman_region32_t *visible;
 	const pixman_region32_t *update_region;
+	// Scratch regions reused for every node of the update
+	pixman_region32_t *old_visible, *new_visible, *opaque;
 	struct wlr_box update_box;
 	struct wl_list *outputs;
 	bool calculate_visibility;
 	bool restack_xwayland_surfaces;
+	struct wlr_scene_visibility_stats *stats;
 
 #if WLR_HAS_XWAYLAND
 	struct wlr_xwayland_surface *restack_above;
@@ -433,7 +826,11 @@ struct render_data {
 	struct wlr_scene_output *output;
 
 	struct wlr_render_pass *render_pass;
-	pixman_region32_t damage;
+	pixman_region32_t *damage;
+
+	// Backdrop blurred once for the current run of blur nodes, see
+	// scene_blur_run_prepare
+	struct fx_framebuffer *shared_blur;
 };
 
 static void logical_to_buffer_coords(pixman_region32_t *region, const struct render_data *data,
@@ -468,8 +865,75 @@ static void transform_output_box(struct wlr_box *box, const struct render_data *
 	wlr_box_transform(box, box, transform, data->trans_width, data->trans_height);
 }
 
-static void scene_output_damage(struct wlr_scene_output *scene_output,
-		const pixman_region32_t *damage) {
+static void scene_blur_cache_destroy(struct scene_blur_cache *cache) {
+	wl_list_remove(&cache->link);
+	fx_blur_cache_finish(&cache->cache);
+	pixman_region32_fini(&cache->valid);
+	free(cache);
+}
+
+static void scene_output_finish_blur_damage(struct wlr_scene_output *scene_output) {
+	struct scene_blur_damage *blur_damage;
+	wl_array_for_each(blur_damage, &scene_output->blur_damage) {
+		pixman_region32_fini(&blur_damage->region);
+	}
+	scene_output->blur_damage.size = 0;
+}
+
+// Records damage for the blur caches of the output. Damage from the contents
+// of a buffer node only changes what's drawn from that node on up, which
+// leaves the caches of blur nodes below it valid. Any other damage may change
+// the backdrop of every blur node.
+static void scene_output_add_blur_damage(struct wlr_scene_output *scene_output,
+		const pixman_region32_t *damage, struct wlr_scene_node *node) {
+	struct scene_blur_damage *blur_damage;
+	wl_array_for_each(blur_damage, &scene_output->blur_damage) {
+		if (blur_damage->node == node) {
+			pixman_region32_union(&blur_damage->region, &blur_damage->region, damage);
+			return;
+		}
+	}
+
+	blur_damage = wl_array_add(&scene_output->blur_damage, sizeof(*blur_damage));
+	if (blur_damage == NULL) {
+		wlr_log(WLR_ERROR, "Failed to record blur damage");
+		struct scene_blur_cache *cache;
+		wl_list_for_each(cache, &scene_output->blur_caches, link) {
+			pixman_region32_clear(&cache->valid);
+		}
+		return;
+	}
+	blur_damage->node = node;
+	pixman_region32_init(&blur_damage->region);
+	pixman_region32_copy(&blur_damage->region, damage);
+}
+
+// Drops the blur caches of a node being destroyed and forgets where its
+// damage came from, so that it isn't mistaken for a later node
+static void scene_node_drop_blur_state(struct wlr_scene *scene,
+		struct wlr_scene_node *node) {
+	struct wlr_scene_output *scene_output;
+	wl_list_for_each(scene_output, &scene->outputs, link) {
+		struct scene_blur_damage *blur_damage;
+		wl_array_for_each(blur_damage, &scene_output->blur_damage) {
+			if (blur_damage->node == node) {
+				blur_damage->node = NULL;
+			}
+		}
+
+		struct scene_blur_cache *cache, *tmp_cache;
+		wl_list_for_each_safe(cache, tmp_cache, &scene_output->blur_caches, link) {
+			if (&cache->blur->node == node) {
+				scene_blur_cache_destroy(cache);
+			}
+		}
+	}
+}
+
+// Damages the output. node is the buffer node whose contents changed, or NULL
+// if the damage isn't limited to the contents of a single node.
+static void scene_output_damage_node(struct wlr_scene_output *scene_output,
+		const pixman_region32_t *damage, struct wlr_scene_node *node) {
 	struct wlr_output *output = scene_output->output;
 
 	pixman_region32_t clipped;
@@ -482,11 +946,18 @@ static void scene_output_damage(struct wlr_scene_output *scene_output,
 
 		pixman_region32_union(&scene_output->pending_commit_damage,
 			&scene_output->pending_commit_damage, &clipped);
+
+		scene_output_add_blur_damage(scene_output, &clipped, node);
 	}
 
 	pixman_region32_fini(&clipped);
 }
 
+static void scene_output_damage(struct wlr_scene_output *scene_output,
+		const pixman_region32_t *damage) {
+	scene_output_damage_node(scene_output, damage, NULL);
+}
+
 static void scene_output_damage_whole(struct wlr_scene_output *scene_output) {
 	struct wlr_output *output = scene_output->output;
 
@@ -691,20 +1162,50 @@ static bool scene_node_update_iterator(struct wlr_scene_node *node,
 	struct wlr_box box = { .x = lx, .y = ly };
 	scene_node_get_size(node, &box.width, &box.height);
 
-	pixman_region32_subtract(&node->visible, &node->visible, data->update_region);
-	pixman_region32_union(&node->visible, &node->visible, data->visible);
-	pixman_region32_intersect_rect(&node->visible, &node->visible,
-		lx, ly, box.width, box.height);
+	data->stats->last_nodes_visited++;
+
+	// Only the part of the visible region inside the update region can
+	// change, so that part is compared before and after the update.
+	//
+	// Once the update region is fully covered by opaque nodes above, nothing
+	// below can become visible in it anymore and only the visible region
+	// outside of it remains. The walk still goes on: nodes below may have
+	// been visible in the update region before, and a dirty optimized blur
+	// resets the visible region. Nodes which weren't visible in the update
+	// region are left alone without any region operation though.
+	bool covered = pixman_region32_empty(data->visible);
+	pixman_box32_t update_extents = *pixman_region32_extents(data->update_region);
+	if (!covered || pixman_region32_contains_rectangle(&node->visible,
+			&update_extents) != PIXMAN_REGION_OUT) {
+		pixman_region32_intersect(data->old_visible, &node->visible,
+			data->update_region);
+
+		if (covered) {
+			pixman_region32_clear(data->new_visible);
+		} else {
+			pixman_region32_intersect_rect(data->new_visible, data->visible,
+				lx, ly, box.width, box.height);
 
-	if (data->calculate_visibility) {
-		pixman_region32_t opaque;
-		pixman_region32_init(&opaque);
-		scene_node_opaque_region(node, lx, ly, &opaque);
-		pixman_region32_subtract(data->visible, data->visible, &opaque);
-		pixman_region32_fini(&opaque);
+			if (data->calculate_visibility) {
+				scene_node_opaque_region(node, lx, ly, data->opaque);
+				pixman_region32_subtract(data->visible, data->visible, data->opaque);
+			}
+		}
+
+		// The outputs only depend on the visible region, so nodes whose
+		// coverage didn't change can be skipped
+		if (!pixman_region32_equal(data->old_visible, data->new_visible)) {
+			pixman_region32_subtract(&node->visible, &node->visible,
+				data->update_region);
+			pixman_region32_union(&node->visible, &node->visible,
+				data->new_visible);
+
+			data->stats->last_nodes_changed++;
+			update_node_update_outputs(node, data->outputs, NULL, NULL);
+			scene_node_render_list_dirty(data->outputs, node);
+		}
 	}
 
-	update_node_update_outputs(node, data->outputs, NULL, NULL);
 #if WLR_HAS_XWAYLAND
 	if (data->restack_xwayland_surfaces) {
 		restack_xwayland_surface(node, &box, data);
@@ -740,6 +1241,10 @@ static void scene_node_bounds(struct wlr_scene_node *node,
 
 	if (node->type == WLR_SCENE_NODE_TREE) {
 		struct wlr_scene_tree *scene_tree = wlr_scene_tree_from_node(node);
+		if (wlr_box_empty(scene_tree_get_bounds(scene_tree))) {
+			return;
+		}
+
 		struct wlr_scene_node *child;
 		wl_list_for_each(child, &scene_tree->children, link) {
 			scene_node_bounds(child, x + child->x, y + child->y, visible);
@@ -754,14 +1259,20 @@ static void scene_node_bounds(struct wlr_scene_node *node,
 
 static void scene_update_region(struct wlr_scene *scene,
 		const pixman_region32_t *update_region) {
-	pixman_region32_t visible;
+	pixman_region32_t visible, old_visible, new_visible, opaque;
 	pixman_region32_init(&visible);
+	pixman_region32_init(&old_visible);
+	pixman_region32_init(&new_visible);
+	pixman_region32_init(&opaque);
 	pixman_region32_copy(&visible, update_region);
 
 	struct pixman_box32 *region_box = pixman_region32_extents(update_region);
 	struct scene_update_data data = {
 		.visible = &visible,
 		.update_region = update_region,
+		.old_visible = &old_visible,
+		.new_visible = &new_visible,
+		.opaque = &opaque,
 		.update_box = {
 			.x = region_box->x1,
 			.y = region_box->y1,
@@ -771,12 +1282,151 @@ static void scene_update_region(struct wlr_scene *scene,
 		.outputs = &scene->outputs,
 		.calculate_visibility = scene->calculate_visibility,
 		.restack_xwayland_surfaces = scene->restack_xwayland_surfaces,
+		.stats = &scene->visibility_stats,
 	};
 
+	data.stats->last_nodes_visited = 0;
+	data.stats->last_nodes_changed = 0;
+
 	// update node visibility and output enter/leave events
 	scene_nodes_in_box(&scene->tree.node, &data.update_box, scene_node_update_iterator, &data);
 
+	data.stats->updates++;
+	data.stats->nodes_visited += data.stats->last_nodes_visited;
+	data.stats->nodes_changed += data.stats->last_nodes_changed;
+
 	pixman_region32_fini(&visible);
+	pixman_region32_fini(&old_visible);
+	pixman_region32_fini(&new_visible);
+	pixman_region32_fini(&opaque);
+}
+
+struct scene_transaction_commit {
+	struct wl_array nodes; // struct wlr_scene_node *
+	struct scene_transaction_commit *prev;
+};
+
+// Adds an update to the pending transaction. The damage is the visible region
+// of the updated node before the update, the node itself (if any) is damaged
+// with its visible region once the transaction is committed.
+static void scene_transaction_add(struct wlr_scene *scene,
+		const pixman_region32_t *update_region, const pixman_region32_t *damage,
+		struct wlr_scene_node *node) {
+	assert(scene->transaction_depth > 0);
+	pixman_region32_union(&scene->transaction_update_region,
+		&scene->transaction_update_region, update_region);
+	if (damage != NULL) {
+		pixman_region32_union(&scene->transaction_damage,
+			&scene->transaction_damage, damage);
+	}
+
+	if (node == NULL || node->transaction_pending) {
+		return;
+	}
+
+	struct wlr_scene_node **entry =
+		wl_array_add(&scene->transaction_nodes, sizeof(*entry));
+	if (entry == NULL) {
+		// Damage everything the node may cover instead
+		pixman_region32_union(&scene->transaction_damage,
+			&scene->transaction_damage, update_region);
+		return;
+	}
+	*entry = node;
+	node->transaction_pending = true;
+}
+
+static void transaction_nodes_forget(struct wl_array *nodes,
+		struct wlr_scene_node *node) {
+	struct wlr_scene_node **entry;
+	wl_array_for_each(entry, nodes) {
+		if (*entry == node) {
+			*entry = NULL;
+		}
+	}
+}
+
+static void scene_transaction_forget_node(struct wlr_scene *scene,
+		struct wlr_scene_node *node) {
+	transaction_nodes_forget(&scene->transaction_nodes, node);
+	for (struct scene_transaction_commit *commit = scene->transaction_commit;
+			commit != NULL; commit = commit->prev) {
+		transaction_nodes_forget(&commit->nodes, node);
+	}
+	node->transaction_pending = false;
+}
+
+void wlr_scene_transaction_begin(struct wlr_scene *scene) {
+	scene->transaction_depth++;
+}
+
+void wlr_scene_transaction_commit(struct wlr_scene *scene) {
+	assert(scene->transaction_depth > 0);
+	if (--scene->transaction_depth > 0) {
+		return;
+	}
+
+	// Take the pending state out of the scene, in case the update triggers
+	// a new transaction. The updated nodes stay reachable through the
+	// commit, so destroying one of them during the update forgets it.
+	struct scene_transaction_commit commit = {
+		.nodes = scene->transaction_nodes,
+		.prev = scene->transaction_commit,
+	};
+	wl_array_init(&scene->transaction_nodes);
+	scene->transaction_commit = &commit;
+
+	pixman_region32_t update_region, damage;
+	pixman_region32_init(&update_region);
+	pixman_region32_init(&damage);
+	pixman_region32_copy(&update_region, &scene->transaction_update_region);
+	pixman_region32_copy(&damage, &scene->transaction_damage);
+	pixman_region32_clear(&scene->transaction_update_region);
+	pixman_region32_clear(&scene->transaction_damage);
+
+	if (!pixman_region32_empty(&update_region)) {
+		scene_update_region(scene, &update_region);
+	}
+
+	// The damage already holds where the updated nodes were visible, add
+	// where they are visible now
+	struct wlr_scene_node **entry;
+	wl_array_for_each(entry, &commit.nodes) {
+		if (*entry != NULL) {
+			scene_node_visibility(*entry, &damage);
+			(*entry)->transaction_pending = false;
+		}
+	}
+	scene_damage_outputs(scene, &damage);
+
+	scene->transaction_commit = commit.prev;
+	wl_array_release(&commit.nodes);
+	pixman_region32_fini(&update_region);
+	pixman_region32_fini(&damage);
+}
+
+static void scene_node_index_update(struct scene_spatial_index *index,
+		struct wlr_scene_node *node, int lx, int ly, bool enabled) {
+	enabled = enabled && node->enabled;
+
+	if (node->type == WLR_SCENE_NODE_TREE) {
+		struct wlr_scene_tree *scene_tree = wlr_scene_tree_from_node(node);
+		struct wlr_scene_node *child;
+		wl_list_for_each(child, &scene_tree->children, link) {
+			scene_node_index_update(index, child,
+				lx + child->x, ly + child->y, enabled);
+		}
+		return;
+	}
+
+	if (!enabled) {
+		spatial_index_remove(index, node);
+		return;
+	}
+
+	struct wlr_box box = { .x = lx, .y = ly };
+	scene_node_get_size(node, &box.width, &box.height);
+	spatial_index_update(index, node, &box);
 }
 
 static void scene_node_cleanup_when_disabled(struct wlr_scene_node *node,
@@ -828,15 +1478,31 @@ static void scene_node_update(struct wlr_scene_node *node,
 		pixman_region32_t *damage) {
 	struct wlr_scene *scene = scene_node_get_root(node);
 
+	scene_node_invalidate_bounds(node);
+
 	int x, y;
-	if (!wlr_scene_node_coords(node, &x, &y)) {
+	bool enabled = wlr_scene_node_coords(node, &x, &y);
+	if (scene->spatial_index != NULL) {
+		scene_node_index_update(scene->spatial_index, node, x, y, enabled);
+	}
+	if (node->type != WLR_SCENE_NODE_TREE) {
+		// The node might not be visited by the visibility update if it
+		// became empty
+		scene_node_render_list_dirty(&scene->outputs, node);
+	}
+
+	if (!enabled) {
 		// We assume explicit damage on a disabled tree means the node was just
 		// disabled.
 		if (damage) {
 			scene_node_cleanup_when_disabled(node, scene->restack_xwayland_surfaces, &scene->outputs);
 
-			scene_update_region(scene, damage);
-			scene_damage_outputs(scene, damage);
+			if (scene->transaction_depth > 0) {
+				scene_transaction_add(scene, damage, damage, NULL);
+			} else {
+				scene_update_region(scene, damage);
+				scene_damage_outputs(scene, damage);
+			}
 			pixman_region32_fini(damage);
 		}
 
@@ -855,6 +1521,15 @@ static void scene_node_update(struct wlr_scene_node *node,
 	pixman_region32_copy(&update_region, damage);
 	scene_node_bounds(node, x, y, &update_region);
 
+	if (scene->transaction_depth > 0) {
+		// The new visible region isn't known until the transaction is
+		// committed, which damages it then
+		scene_transaction_add(scene, &update_region, damage, node);
+		pixman_region32_fini(&update_region);
+		pixman_region32_fini(damage);
+		return;
+	}
+
 	scene_update_region(scene, &update_region);
 	pixman_region32_fini(&update_region);
 
@@ -868,7 +1543,8 @@ struct wlr_scene_rect *wlr_scene_rect_create(struct wlr_scene_tree *parent,
 	assert(parent);
 	assert(width >= 0 && height >= 0);
 
-	struct wlr_scene_rect *scene_rect = calloc(1, sizeof(*scene_rect));
+	struct wlr_scene_rect *scene_rect = scene_node_alloc(parent->node.scene,
+		WLR_SCENE_NODE_RECT, sizeof(*scene_rect));
 	if (scene_rect == NULL) {
 		return NULL;
 	}
@@ -895,6 +1571,7 @@ void wlr_scene_rect_set_size(struct wlr_scene_rect *rect, int width, int height)
 
 	rect->width = width;
 	rect->height = height;
+	scene_node_invalidate_opaque(&rect->node);
 	scene_node_update(&rect->node, NULL);
 }
 
@@ -904,6 +1581,7 @@ void wlr_scene_rect_set_color(struct wlr_scene_rect *rect, const float color[sta
 	}
 
 	memcpy(rect->color, color, sizeof(rect->color));
+	scene_node_invalidate_opaque(&rect->node);
 	scene_node_update(&rect->node, NULL);
 }
 
@@ -915,6 +1593,11 @@ static void scene_buffer_handle_buffer_release(struct wl_listener *listener,
 	scene_buffer->buffer = NULL;
 	wl_list_remove(&scene_buffer->buffer_release.link);
 	wl_list_init(&scene_buffer->buffer_release.link);
+	scene_node_invalidate_opaque(&scene_buffer->node);
+
+	// The node may have become invisible
+	struct wlr_scene *scene = scene_node_get_root(&scene_buffer->node);
+	scene_node_render_list_dirty(&scene->outputs, &scene_buffer->node);
 }
 
 static void scene_buffer_set_buffer(struct wlr_scene_buffer *scene_buffer,
@@ -928,6 +1611,7 @@ static void scene_buffer_set_buffer(struct wlr_scene_buffer *scene_buffer,
 	scene_buffer->own_buffer = false;
 	scene_buffer->buffer_width = scene_buffer->buffer_height = 0;
 	scene_buffer->buffer_is_opaque = false;
+	scene_node_invalidate_opaque(&scene_buffer->node);
 
 	if (!buffer) {
 		return;
@@ -985,6 +1669,7 @@ void wlr_scene_rect_set_corner_radii(struct wlr_scene_rect *rect, struct fx_corn
 	}
 
 	rect->corners = corners;
+	scene_node_invalidate_opaque(&rect->node);
 	scene_node_update(&rect->node, NULL);
 }
 
@@ -996,17 +1681,19 @@ void wlr_scene_rect_set_clipped_region(struct wlr_scene_rect *rect,
 	}
 
 	rect->clipped_region = clipped_region;
+	scene_node_invalidate_opaque(&rect->node);
 	scene_node_update(&rect->node, NULL);
 }
 
 struct wlr_scene_shadow *wlr_scene_shadow_create(struct wlr_scene_tree *parent,
 		int width, int height, int corner_radius, float blur_sigma,
 		const float color [static 4]) {
-	struct wlr_scene_shadow *scene_shadow = calloc(1, sizeof(*scene_shadow));
+	assert(parent);
+	struct wlr_scene_shadow *scene_shadow = scene_node_alloc(parent->node.scene,
+		WLR_SCENE_NODE_SHADOW, sizeof(*scene_shadow));
 	if (scene_shadow == NULL) {
 		return NULL;
 	}
-	assert(parent);
 	scene_node_init(&scene_shadow->node, WLR_SCENE_NODE_SHADOW, parent);
 
 	scene_shadow->width = width;
@@ -1084,11 +1771,12 @@ static void mark_all_optimized_blur_nodes_dirty(struct wlr_scene_node *node) {
 
 struct wlr_scene_blur *wlr_scene_blur_create(struct wlr_scene_tree *parent,
 	   int width, int height) {
-	struct wlr_scene_blur *blur = calloc(1, sizeof(*blur));
+	assert(parent);
+	struct wlr_scene_blur *blur = scene_node_alloc(parent->node.scene,
+		WLR_SCENE_NODE_BLUR, sizeof(*blur));
 	if (blur == NULL) {
 		return NULL;
 	}
-	assert(parent);
 	scene_node_init(&blur->node, WLR_SCENE_NODE_BLUR, parent);
 
 	blur->alpha = 1.0f;
@@ -1284,11 +1972,12 @@ void wlr_scene_set_blur_saturation(struct wlr_scene *scene, float saturation) {
 
 struct wlr_scene_optimized_blur *wlr_scene_optimized_blur_create(
 		struct wlr_scene_tree *parent, int width, int height) {
-	struct wlr_scene_optimized_blur *scene_blur = calloc(1, sizeof(*scene_blur));
+	assert(parent);
+	struct wlr_scene_optimized_blur *scene_blur = scene_node_alloc(parent->node.scene,
+		WLR_SCENE_NODE_OPTIMIZED_BLUR, sizeof(*scene_blur));
 	if (scene_blur == NULL) {
 		return NULL;
 	}
-	assert(parent);
 	scene_node_init(&scene_blur->node, WLR_SCENE_NODE_OPTIMIZED_BLUR, parent);
 
 	scene_blur->width = width;
@@ -1326,11 +2015,12 @@ void wlr_scene_optimized_blur_mark_dirty(struct wlr_scene_optimized_blur *blur_n
 
 struct wlr_scene_buffer *wlr_scene_buffer_create(struct wlr_scene_tree *parent,
 		struct wlr_buffer *buffer) {
-	struct wlr_scene_buffer *scene_buffer = calloc(1, sizeof(*scene_buffer));
+	assert(parent);
+	struct wlr_scene_buffer *scene_buffer = scene_node_alloc(parent->node.scene,
+		WLR_SCENE_NODE_BUFFER, sizeof(*scene_buffer));
 	if (scene_buffer == NULL) {
 		return NULL;
 	}
-	assert(parent);
 	scene_node_init(&scene_buffer->node, WLR_SCENE_NODE_BUFFER, parent);
 
 	wl_signal_init(&scene_buffer->events.outputs_update);
@@ -1383,6 +2073,8 @@ void wlr_scene_buffer_set_buffer_with_options(struct wlr_scene_buffer *scene_buf
 			scene_buffer->buffer_height != buffer->height;
 	}
 
+	bool was_black_opaque = scene_buffer_is_black_opaque(scene_buffer);
+
 	// If this is a buffer change, check if it's a single pixel buffer.
 	// Cache that so we can still apply rendering optimisations even when
 	// the original buffer has been freed after texture upload.
@@ -1422,6 +2114,18 @@ void wlr_scene_buffer_set_buffer_with_options(struct wlr_scene_buffer *scene_buf
 		return;
 	}
 
+	// The size can still change if only one of the destination dimensions
+	// is set
+	scene_node_invalidate_bounds(&scene_buffer->node);
+	struct wlr_scene *scene = scene_node_get_root(&scene_buffer->node);
+	if (scene->spatial_index != NULL) {
+		scene_node_index_update(scene->spatial_index, &scene_buffer->node,
+			lx, ly, true);
+	}
+	if (was_black_opaque != scene_buffer_is_black_opaque(scene_buffer)) {
+		scene_node_render_list_dirty(&scene->outputs, &scene_buffer->node);
+	}
+
 	pixman_region32_t fallback_damage;
 	pixman_region32_init_rect(&fallback_damage, 0, 0, buffer->width, buffer->height);
 	const pixman_region32_t *damage = options->damage;
@@ -1457,7 +2161,6 @@ void wlr_scene_buffer_set_buffer_with_options(struct wlr_scene_buffer *scene_buf
 		box.x, box.y, box.width, box.height);
 	pixman_region32_translate(&trans_damage, -box.x, -box.y);
 
-	struct wlr_scene *scene = scene_node_get_root(&scene_buffer->node);
 	struct wlr_scene_output *scene_output;
 	wl_list_for_each(scene_output, &scene->outputs, link) {
 		float output_scale = scene_output->output->scale;
@@ -1499,7 +2202,7 @@ void wlr_scene_buffer_set_buffer_with_options(struct wlr_scene_buffer *scene_buf
 			(int)round((lx - scene_output->x) * output_scale),
 			(int)round((ly - scene_output->y) * output_scale));
 		output_to_buffer_coords(&output_damage, scene_output->output);
-		scene_output_damage(scene_output, &output_damage);
+		scene_output_damage_node(scene_output, &output_damage, &scene_buffer->node);
 		pixman_region32_fini(&output_damage);
 	}
 
@@ -1527,16 +2230,22 @@ void wlr_scene_buffer_set_opaque_region(struct wlr_scene_buffer *scene_buffer,
 	}
 
 	pixman_region32_copy(&scene_buffer->opaque_region, region);
+	scene_node_invalidate_opaque(&scene_buffer->node);
 
 	int x, y;
 	if (!wlr_scene_node_coords(&scene_buffer->node, &x, &y)) {
 		return;
 	}
 
+	struct wlr_scene *scene = scene_node_get_root(&scene_buffer->node);
 	pixman_region32_t update_region;
 	pixman_region32_init(&update_region);
 	scene_node_bounds(&scene_buffer->node, x, y, &update_region);
-	scene_update_region(scene_node_get_root(&scene_buffer->node), &update_region);
+	if (scene->transaction_depth > 0) {
+		scene_transaction_add(scene, &update_region, NULL, NULL);
+	} else {
+		scene_update_region(scene, &update_region);
+	}
 	pixman_region32_fini(&update_region);
 }
 
@@ -1553,6 +2262,7 @@ void wlr_scene_buffer_set_source_box(struct wlr_scene_buffer *scene_buffer,
 		scene_buffer->src_box = (struct wlr_fbox){0};
 	}
 
+	scene_node_invalidate_opaque(&scene_buffer->node);
 	scene_node_update(&scene_buffer->node, NULL);
 }
 
@@ -1565,6 +2275,7 @@ void wlr_scene_buffer_set_dest_size(struct wlr_scene_buffer *scene_buffer,
 	assert(width >= 0 && height >= 0);
 	scene_buffer->dst_width = width;
 	scene_buffer->dst_height = height;
+	scene_node_invalidate_opaque(&scene_buffer->node);
 	scene_node_update(&scene_buffer->node, NULL);
 }
 
@@ -1575,6 +2286,7 @@ void wlr_scene_buffer_set_transform(struct wlr_scene_buffer *scene_buffer,
 	}
 
 	scene_buffer->transform = transform;
+	scene_node_invalidate_opaque(&scene_buffer->node);
 	scene_node_update(&scene_buffer->node, NULL);
 }
 
@@ -1593,6 +2305,7 @@ void wlr_scene_buffer_set_opacity(struct wlr_scene_buffer *scene_buffer,
 
 	assert(opacity >= 0 && opacity <= 1);
 	scene_buffer->opacity = opacity;
+	scene_node_invalidate_opaque(&scene_buffer->node);
 	scene_node_update(&scene_buffer->node, NULL);
 }
 
@@ -1658,6 +2371,7 @@ void wlr_scene_buffer_set_corner_radii(struct wlr_scene_buffer *scene_buffer,
 	}
 
 	scene_buffer->corners = corner_radii;
+	scene_node_invalidate_opaque(&scene_buffer->node);
 	scene_node_update(&scene_buffer->node, NULL);
 }
 
@@ -1725,21 +2439,251 @@ void scene_node_get_size(struct wlr_scene_node *node, int *width, int *height) {
 	}
 }
 
-void wlr_scene_node_set_enabled(struct wlr_scene_node *node, bool enabled) {
-	if (node->enabled == enabled) {
-		return;
+void wlr_scene_node_set_enabled(struct wlr_scene_node *node, bool enabled) {
+	if (node->enabled == enabled) {
+		return;
+	}
+
+	int x, y;
+	pixman_region32_t visible;
+	pixman_region32_init(&visible);
+	if (wlr_scene_node_coords(node, &x, &y)) {
+		scene_node_visibility(node, &visible);
+	}
+
+	node->enabled = enabled;
+	scene_node_invalidate_coords(node);
+
+	scene_structure_changed(scene_node_get_root(node));
+	scene_node_update(node, &visible);
+}
+
+static bool scene_node_is_descendant(struct wlr_scene_node *node,
+		struct wlr_scene_node *ancestor) {
+	for (; node != NULL; node = node->parent ? &node->parent->node : NULL) {
+		if (node == ancestor) {
+			return true;
+		}
+	}
+	return false;
+}
+
+struct scene_translate_data {
+	struct wlr_scene_node *node;
+	int dx, dy;
+	bool eligible;
+	bool calculate_visibility;
+	bool restack_xwayland_surfaces;
+	struct wl_list *outputs;
+
+	// Union of the visible and opaque regions of the subtree before the move
+	pixman_region32_t visible;
+	pixman_region32_t opaque;
+};
+
+static bool scene_node_topmost_iterator(struct wlr_scene_node *node,
+		int lx, int ly, void *_data) {
+	struct scene_translate_data *data = _data;
+	// The first node found is the top-most one in the box
+	data->eligible = scene_node_is_descendant(node, data->node);
+	return true;
+}
+
+static void scene_node_translate_gather(struct wlr_scene_node *node,
+		int lx, int ly, struct scene_translate_data *data) {
+	if (!node->enabled || !data->eligible) {
+		return;
+	}
+
+	if (node->type == WLR_SCENE_NODE_TREE) {
+		struct wlr_scene_tree *scene_tree = wlr_scene_tree_from_node(node);
+		struct wlr_scene_node *child;
+		wl_list_for_each(child, &scene_tree->children, link) {
+			scene_node_translate_gather(child, lx + child->x, ly + child->y, data);
+		}
+		return;
+	}
+
+	// Dirty optimized blur nodes reset the visibility of everything below
+	// them, which only the full update handles
+	if (node->type == WLR_SCENE_NODE_OPTIMIZED_BLUR) {
+		data->eligible = false;
+		return;
+	}
+
+#if WLR_HAS_XWAYLAND
+	// Xwayland surfaces need to be restacked by the full update
+	if (data->restack_xwayland_surfaces &&
+			scene_node_try_get_managed_xwayland_surface(node)) {
+		data->eligible = false;
+		return;
+	}
+#endif
+
+	pixman_region32_union(&data->visible, &data->visible, &node->visible);
+	if (data->calculate_visibility) {
+		pixman_region32_t opaque;
+		pixman_region32_init(&opaque);
+		scene_node_opaque_region(node, lx, ly, &opaque);
+		pixman_region32_union(&data->opaque, &data->opaque, &opaque);
+		pixman_region32_fini(&opaque);
+	}
+}
+
+// Checks whether moving the visible region with the given extents may change
+// the outputs a node is displayed on. That's not the case if it stays fully
+// inside or fully outside of each output.
+static bool scene_node_outputs_may_change(struct wl_list *outputs,
+		const pixman_box32_t *extents, int dx, int dy) {
+	if (extents->x1 >= extents->x2 || extents->y1 >= extents->y2) {
+		return false;
+	}
+
+	struct wlr_box old_box = {
+		.x = extents->x1,
+		.y = extents->y1,
+		.width = extents->x2 - extents->x1,
+		.height = extents->y2 - extents->y1,
+	};
+	struct wlr_box new_box = old_box;
+	new_box.x += dx;
+	new_box.y += dy;
+
+	struct wlr_scene_output *scene_output;
+	wl_list_for_each(scene_output, outputs, link) {
+		struct wlr_box output_box = { .x = scene_output->x, .y = scene_output->y };
+		wlr_output_effective_resolution(scene_output->output,
+			&output_box.width, &output_box.height);
+
+		struct wlr_box intersection;
+		bool old_inside = wlr_box_contains_box(&output_box, &old_box);
+		bool new_inside = wlr_box_contains_box(&output_box, &new_box);
+		bool old_outside = !wlr_box_intersection(&intersection, &output_box, &old_box);
+		bool new_outside = !wlr_box_intersection(&intersection, &output_box, &new_box);
+		if (!(old_inside && new_inside) && !(old_outside && new_outside)) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+static void scene_node_translate_apply(struct wlr_scene_node *node,
+		struct scene_translate_data *data) {
+	if (!node->enabled) {
+		return;
+	}
+
+	if (node->type == WLR_SCENE_NODE_TREE) {
+		struct wlr_scene_tree *scene_tree = wlr_scene_tree_from_node(node);
+		struct wlr_scene_node *child;
+		wl_list_for_each(child, &scene_tree->children, link) {
+			scene_node_translate_apply(child, data);
+		}
+		return;
+	}
+
+	pixman_box32_t extents = *pixman_region32_extents(&node->visible);
+	pixman_region32_translate(&node->visible, data->dx, data->dy);
+
+	if (scene_node_outputs_may_change(data->outputs, &extents, data->dx, data->dy)) {
+		update_node_update_outputs(node, data->outputs, NULL, NULL);
+	}
+}
+
+// Fast path for moving a node which is not covered by anything else, neither
+// at its old nor at its new position. The visible regions of the subtree are
+// simply translated, and only the parts of the scene below where the opaque
+// coverage changed get their visibility recomputed.
+//
+// Returns false if the node doesn't qualify, in which case nothing was done.
+// Nodes never qualify within a transaction: the visible regions the fast path
+// relies on are stale until the commit, so the move goes through the deferred
+// update like any other change.
+static bool scene_node_translate(struct wlr_scene_node *node, int dx, int dy) {
+	struct wlr_scene *scene = scene_node_get_root(node);
+	if (scene->transaction_depth > 0) {
+		return false;
 	}
 
 	int x, y;
-	pixman_region32_t visible;
-	pixman_region32_init(&visible);
-	if (wlr_scene_node_coords(node, &x, &y)) {
-		scene_node_visibility(node, &visible);
+	if (!wlr_scene_node_coords(node, &x, &y)) {
+		return false;
 	}
 
-	node->enabled = enabled;
+	struct wlr_box new_box;
+	if (node->type == WLR_SCENE_NODE_TREE) {
+		new_box = *scene_tree_get_bounds(wlr_scene_tree_from_node(node));
+	} else {
+		new_box = (struct wlr_box){0};
+		scene_node_get_size(node, &new_box.width, &new_box.height);
+	}
+	new_box.x += x;
+	new_box.y += y;
 
-	scene_node_update(node, &visible);
+	struct wlr_box box = new_box;
+	box.x -= dx;
+	box.y -= dy;
+	box_union(&box, &new_box);
+
+	struct scene_translate_data data = {
+		.node = node,
+		.dx = dx,
+		.dy = dy,
+		.eligible = true,
+		.calculate_visibility = scene->calculate_visibility,
+		.restack_xwayland_surfaces = scene->restack_xwayland_surfaces,
+		.outputs = &scene->outputs,
+	};
+
+	scene_nodes_in_box(&scene->tree.node, &box, scene_node_topmost_iterator, &data);
+	if (!data.eligible) {
+		return false;
+	}
+
+	pixman_region32_init(&data.visible);
+	pixman_region32_init(&data.opaque);
+	scene_node_translate_gather(node, x - dx, y - dy, &data);
+	if (!data.eligible) {
+		pixman_region32_fini(&data.visible);
+		pixman_region32_fini(&data.opaque);
+		return false;
+	}
+
+	scene_node_invalidate_bounds(node);
+	if (scene->spatial_index != NULL) {
+		scene_node_index_update(scene->spatial_index, node, x, y, true);
+	}
+
+	scene_node_translate_apply(node, &data);
+
+	// Nodes below only see a difference where the opaque coverage moved
+	pixman_region32_t moved_opaque, update_region;
+	pixman_region32_init(&moved_opaque);
+	pixman_region32_init(&update_region);
+	pixman_region32_copy(&moved_opaque, &data.opaque);
+	pixman_region32_translate(&moved_opaque, dx, dy);
+	pixman_region32_subtract(&update_region, &data.opaque, &moved_opaque);
+	pixman_region32_subtract(&moved_opaque, &moved_opaque, &data.opaque);
+	pixman_region32_union(&update_region, &update_region, &moved_opaque);
+	if (!pixman_region32_empty(&update_region)) {
+		scene_update_region(scene, &update_region);
+	}
+	pixman_region32_fini(&update_region);
+	pixman_region32_fini(&moved_opaque);
+
+	// Damage where the node was and where it is now
+	pixman_region32_t damage;
+	pixman_region32_init(&damage);
+	pixman_region32_copy(&damage, &data.visible);
+	pixman_region32_translate(&damage, dx, dy);
+	pixman_region32_union(&damage, &damage, &data.visible);
+	scene_damage_outputs(scene, &damage);
+	pixman_region32_fini(&damage);
+
+	pixman_region32_fini(&data.visible);
+	pixman_region32_fini(&data.opaque);
+	return true;
 }
 
 void wlr_scene_node_set_position(struct wlr_scene_node *node, int x, int y) {
@@ -1747,9 +2691,16 @@ void wlr_scene_node_set_position(struct wlr_scene_node *node, int x, int y) {
 		return;
 	}
 
+	int dx = x - node->x;
+	int dy = y - node->y;
 	node->x = x;
 	node->y = y;
-	scene_node_update(node, NULL);
+	scene_node_invalidate_coords(node);
+	scene_structure_changed(scene_node_get_root(node));
+
+	if (!scene_node_translate(node, dx, dy)) {
+		scene_node_update(node, NULL);
+	}
 }
 
 void wlr_scene_node_place_above(struct wlr_scene_node *node,
@@ -1763,6 +2714,7 @@ void wlr_scene_node_place_above(struct wlr_scene_node *node,
 
 	wl_list_remove(&node->link);
 	wl_list_insert(&sibling->link, &node->link);
+	scene_structure_changed(scene_node_get_root(node));
 	scene_node_update(node, NULL);
 }
 
@@ -1777,6 +2729,7 @@ void wlr_scene_node_place_below(struct wlr_scene_node *node,
 
 	wl_list_remove(&node->link);
 	wl_list_insert(sibling->link.prev, &node->link);
+	scene_structure_changed(scene_node_get_root(node));
 	scene_node_update(node, NULL);
 }
 
@@ -1798,6 +2751,19 @@ void wlr_scene_node_lower_to_bottom(struct wlr_scene_node *node) {
 	wlr_scene_node_place_below(node, current_bottom);
 }
 
+static void scene_node_set_scene(struct wlr_scene_node *node,
+		struct wlr_scene *scene) {
+	node->scene = scene;
+
+	if (node->type == WLR_SCENE_NODE_TREE) {
+		struct wlr_scene_tree *scene_tree = wlr_scene_tree_from_node(node);
+		struct wlr_scene_node *child;
+		wl_list_for_each(child, &scene_tree->children, link) {
+			scene_node_set_scene(child, scene);
+		}
+	}
+}
+
 void wlr_scene_node_reparent(struct wlr_scene_node *node,
 		struct wlr_scene_tree *new_parent) {
 	assert(new_parent != NULL);
@@ -1819,9 +2785,23 @@ void wlr_scene_node_reparent(struct wlr_scene_node *node,
 		scene_node_visibility(node, &visible);
 	}
 
+	scene_node_invalidate_bounds(node);
 	wl_list_remove(&node->link);
 	node->parent = new_parent;
 	wl_list_insert(new_parent->children.prev, &node->link);
+	scene_node_invalidate_coords(node);
+
+	struct wlr_scene *old_scene = node->scene;
+	if (new_parent->node.scene != old_scene) {
+		// Moving a node into another scene, drop it from the old one
+		if (old_scene->spatial_index != NULL) {
+			scene_node_index_update(old_scene->spatial_index, node, 0, 0, false);
+		}
+		scene_structure_changed(old_scene);
+		scene_node_set_scene(node, new_parent->node.scene);
+	}
+
+	scene_structure_changed(scene_node_get_root(node));
 	scene_node_update(node, &visible);
 }
 
@@ -1829,22 +2809,10 @@ bool wlr_scene_node_coords(struct wlr_scene_node *node,
 		int *lx_ptr, int *ly_ptr) {
 	assert(node);
 
-	int lx = 0, ly = 0;
-	bool enabled = true;
-	while (true) {
-		lx += node->x;
-		ly += node->y;
-		enabled = enabled && node->enabled;
-		if (node->parent == NULL) {
-			break;
-		}
-
-		node = &node->parent->node;
-	}
-
-	*lx_ptr = lx;
-	*ly_ptr = ly;
-	return enabled;
+	scene_node_update_coords(node);
+	*lx_ptr = node->layout_x;
+	*ly_ptr = node->layout_y;
+	return node->layout_enabled;
 }
 
 static void scene_node_for_each_scene_buffer(struct wlr_scene_node *node,
@@ -1954,18 +2922,240 @@ static float get_luminance_multiplier(const struct wlr_color_luminances *src_lum
 	return (dst_lum->reference / src_lum->reference) * (src_lum->max / dst_lum->max);
 }
 
+// Checks whether the visible region of a node may intersect the given region
+// in buffer coordinates. Only the extents of the visible region are
+// considered, so this may report false positives but never false negatives.
+// Unlike intersecting the regions, this doesn't allocate.
+static bool scene_node_visible_may_intersect(struct wlr_scene_node *node,
+		const struct render_data *data, const pixman_region32_t *region) {
+	if (pixman_region32_empty(&node->visible)) {
+		return false;
+	}
+
+	const pixman_box32_t *extents = pixman_region32_extents(&node->visible);
+	struct wlr_box box = {
+		.x = extents->x1 - data->logical.x,
+		.y = extents->y1 - data->logical.y,
+		.width = extents->x2 - extents->x1,
+		.height = extents->y2 - extents->y1,
+	};
+	transform_output_box(&box, data);
+
+	// Account for the rounding done by logical_to_buffer_coords()
+	pixman_box32_t buffer_box = {
+		.x1 = box.x - 1,
+		.y1 = box.y - 1,
+		.x2 = box.x + box.width + 1,
+		.y2 = box.y + box.height + 1,
+	};
+	return pixman_region32_contains_rectangle(region, &buffer_box) != PIXMAN_REGION_OUT;
+}
+
+// Whether the backdrop blur of the node is a plain blur of the output buffer,
+// which may be shared with other nodes (see scene_blur_run_prepare) and kept
+// across frames (see scene_blur_cache)
+static bool scene_blur_can_share(struct wlr_scene_blur *blur,
+		const struct render_data *data) {
+	// The optimized blur draws a cached blur instead
+	if (blur->should_only_blur_bottom_layer) {
+		return false;
+	}
+
+	// The blur passes sample the backdrop with the mask transform
+	struct wlr_scene_buffer *mask = wlr_scene_blur_get_transparency_mask_source(blur);
+	if (mask != NULL) {
+		enum wl_output_transform transform = wlr_output_transform_invert(mask->transform);
+		transform = wlr_output_transform_compose(transform, data->transform);
+		return transform == WL_OUTPUT_TRANSFORM_NORMAL;
+	}
+	return true;
+}
+
+static struct scene_blur_cache *scene_blur_cache_find(
+		struct wlr_scene_output *scene_output, struct wlr_scene_blur *blur) {
+	struct scene_blur_cache *cache;
+	wl_list_for_each(cache, &scene_output->blur_caches, link) {
+		if (cache->blur == blur) {
+			return cache;
+		}
+	}
+	return NULL;
+}
+
+// The part of the output buffer a blur cache of the entry covers
+static bool scene_entry_blur_cache_box(struct render_list_entry *entry,
+		const struct render_data *data, struct wlr_box *box) {
+	struct wlr_box node_box = {
+		.x = entry->x - data->logical.x,
+		.y = entry->y - data->logical.y,
+	};
+	scene_node_get_size(entry->node, &node_box.width, &node_box.height);
+	transform_output_box(&node_box, data);
+
+	struct wlr_box output_box = {
+		.width = data->output->output->width,
+		.height = data->output->output->height,
+	};
+	return wlr_box_intersection(box, &node_box, &output_box);
+}
+
+// Whether the cache holds the blur of the whole region
+static bool scene_blur_cache_covers(const struct scene_blur_cache *cache,
+		const struct wlr_box *box, const pixman_region32_t *region) {
+	if (cache == NULL || !wlr_box_equal(&cache->cache.box, box)) {
+		return false;
+	}
+
+	pixman_region32_t missing;
+	pixman_region32_init(&missing);
+	pixman_region32_subtract(&missing, region, &cache->valid);
+	bool covers = pixman_region32_empty(&missing);
+	pixman_region32_fini(&missing);
+	return covers;
+}
+
+static int render_list_find(struct render_list_entry *list, int list_len,
+		struct wlr_scene_node *node) {
+	for (int i = 0; i < list_len; i++) {
+		if (list[i].node == node) {
+			return i;
+		}
+	}
+	return -1;
+}
+
+// Drops the parts of the blur caches whose backdrop changed since the last
+// render, and the caches of blur nodes which aren't drawn from one anymore.
+static void scene_output_update_blur_caches(struct wlr_scene_output *scene_output,
+		struct render_list_entry *list, int list_len, const struct render_data *data) {
+	struct scene_blur_damage *blur_damage;
+	wl_array_for_each(blur_damage, &scene_output->blur_damage) {
+		blur_damage->list_index = blur_damage->node != NULL ?
+			render_list_find(list, list_len, blur_damage->node) : -1;
+	}
+
+	struct scene_blur_cache *cache, *tmp_cache;
+	wl_list_for_each_safe(cache, tmp_cache, &scene_output->blur_caches, link) {
+		int index = render_list_find(list, list_len, &cache->blur->node);
+		if (index < 0 || !scene_blur_can_share(cache->blur, data)) {
+			scene_blur_cache_destroy(cache);
+			continue;
+		}
+
+		struct blur_data blur_data = blur_data_apply_strength(
+			&scene_output->scene->blur_data, cache->blur->strength);
+		int blur_size = blur_data_calc_size(&blur_data);
+
+		wl_array_for_each(blur_damage, &scene_output->blur_damage) {
+			// Nodes drawn after the blur node aren't part of its backdrop.
+			// Damage of nodes missing from the render list can't be placed.
+			if (blur_damage->list_index >= 0 && blur_damage->list_index < index) {
+				continue;
+			}
+
+			// The blur of every pixel this far away from the damage changed
+			pixman_region32_t sampled;
+			pixman_region32_init(&sampled);
+			wlr_region_expand(&sampled, &blur_damage->region, blur_size);
+			pixman_region32_subtract(&cache->valid, &cache->valid, &sampled);
+			pixman_region32_fini(&sampled);
+		}
+	}
+
+	scene_output_finish_blur_damage(scene_output);
+}
+
+// Draws the blur node from its cache where the backdrop didn't change, and
+// otherwise blurs the backdrop and saves the result in the cache. Returns
+// false if the node has to be blurred without a cache.
+static bool scene_blur_render_cached(struct render_list_entry *entry,
+		const struct render_data *data, struct fx_render_blur_pass_options *blur_options) {
+	struct wlr_scene_blur *blur = wlr_scene_blur_from_node(entry->node);
+	struct fx_gles_render_pass *fx_pass = fx_get_render_pass(data->render_pass);
+	struct wlr_scene_output *scene_output = data->output;
+	if (fx_pass->fx_offscreen_buffers == NULL ||
+			!is_scene_blur_enabled(&scene_output->scene->blur_data) ||
+			!scene_blur_can_share(blur, data)) {
+		return false;
+	}
+
+	struct wlr_box box;
+	if (!scene_entry_blur_cache_box(entry, data, &box)) {
+		return false;
+	}
+
+	const pixman_region32_t *render_region = blur_options->tex_options.base.clip;
+	struct scene_blur_cache *cache = scene_blur_cache_find(scene_output, blur);
+	if (scene_blur_cache_covers(cache, &box, render_region)) {
+		blur_options->blur_cache = &cache->cache;
+		fx_render_pass_add_blur(fx_pass, blur_options);
+		return true;
+	}
+
+	if (cache == NULL) {
+		cache = calloc(1, sizeof(*cache));
+		if (cache == NULL) {
+			wlr_log_errno(WLR_ERROR, "Allocation failed");
+			return false;
+		}
+		cache->blur = blur;
+		pixman_region32_init(&cache->valid);
+		wl_list_insert(&scene_output->blur_caches, &cache->link);
+	} else if (!wlr_box_equal(&cache->cache.box, &box)) {
+		pixman_region32_clear(&cache->valid);
+	}
+
+	struct fx_framebuffer *blurred = data->shared_blur;
+	if (blurred == NULL) {
+		blurred = fx_render_pass_blur_backdrop(fx_pass, blur_options);
+	}
+	if (blurred == NULL) {
+		return false;
+	}
+
+	// The blur of the padding around the damage samples stale pixels, it
+	// gets covered by the saved pixels later on
+	pixman_region32_t saved;
+	pixman_region32_init(&saved);
+	pixman_region32_subtract(&saved, render_region, &fx_pass->blur_padding_region);
+	pixman_region32_intersect_rect(&saved, &saved, box.x, box.y, box.width, box.height);
+	if (fx_render_pass_save_blur(fx_pass, scene_output->output->allocator,
+			&cache->cache, &box, blurred, &saved)) {
+		pixman_region32_union(&cache->valid, &cache->valid, &saved);
+	} else {
+		pixman_region32_clear(&cache->valid);
+	}
+	pixman_region32_fini(&saved);
+
+	blur_options->blurred_buffer = blurred;
+	fx_render_pass_add_blur(fx_pass, blur_options);
+	return true;
+}
+
+// The damaged part of the visible region of a node, in buffer coordinates
+static void scene_entry_render_region(struct render_list_entry *entry,
+		const struct render_data *data, pixman_region32_t *region) {
+	// Intersecting into another region than the operands reuses its storage
+	pixman_region32_t *visible = &data->output->scratch.visible;
+	pixman_region32_copy(visible, &entry->node->visible);
+	pixman_region32_translate(visible, -data->logical.x, -data->logical.y);
+	logical_to_buffer_coords(visible, data, true);
+	pixman_region32_intersect(region, visible, data->damage);
+}
+
 static void scene_entry_render(struct render_list_entry *entry, const struct render_data *data) {
 	struct wlr_scene_node *node = entry->node;
 	struct fx_gles_render_pass *fx_pass = fx_get_render_pass(data->render_pass);
 
-	pixman_region32_t render_region;
-	pixman_region32_init(&render_region);
-	pixman_region32_copy(&render_region, &node->visible);
-	pixman_region32_translate(&render_region, -data->logical.x, -data->logical.y);
-	logical_to_buffer_coords(&render_region, data, true);
-	pixman_region32_intersect(&render_region, &render_region, &data->damage);
-	if (pixman_region32_empty(&render_region)) {
-		pixman_region32_fini(&render_region);
+	// Most entries are untouched by the damage of a frame, skip them before
+	// building any regions
+	if (!scene_node_visible_may_intersect(node, data, data->damage)) {
+		return;
+	}
+
+	pixman_region32_t *render_region = &data->output->scratch.render_region;
+	scene_entry_render_region(entry, data, render_region);
+	if (pixman_region32_empty(render_region)) {
 		return;
 	}
 
@@ -1979,11 +3169,8 @@ static void scene_entry_render(struct render_list_entry *entry, const struct ren
 	scene_node_get_size(node, &dst_box.width, &dst_box.height);
 	transform_output_box(&dst_box, data);
 
-	pixman_region32_t opaque;
-	pixman_region32_init(&opaque);
-	scene_node_opaque_region(node, x, y, &opaque);
-	logical_to_buffer_coords(&opaque, data, false);
-	pixman_region32_subtract(&opaque, &render_region, &opaque);
+	// Only computed for buffers, the other node types don't need it
+	pixman_region32_t *opaque = &data->output->scratch.opaque;
 
 	enum wl_output_transform node_transform =
 		wlr_output_transform_compose(WL_OUTPUT_TRANSFORM_NORMAL, data->transform);
@@ -2018,7 +3205,7 @@ static void scene_entry_render(struct render_list_entry *entry, const struct ren
 					.b = scene_rect->color[2],
 					.a = scene_rect->color[3],
 				},
-				.clip = &render_region,
+				.clip = render_region,
 			},
 			.clipped_region = {
 				.area = rect_clipped_region_box,
@@ -2055,7 +3242,7 @@ static void scene_entry_render(struct render_list_entry *entry, const struct ren
 					.a = (float)scene_buffer->single_pixel_buffer_color[3] /
 						(float)UINT32_MAX * scene_buffer->opacity,
 				},
-				.clip = &render_region,
+				.clip = render_region,
 			});
 			break;
 		}
@@ -2063,10 +3250,18 @@ static void scene_entry_render(struct render_list_entry *entry, const struct ren
 		struct wlr_texture *texture = scene_buffer_get_texture(scene_buffer,
 			data->output->output->renderer);
 		if (texture == NULL) {
-			scene_output_damage(data->output, &render_region);
+			scene_output_damage(data->output, render_region);
 			break;
 		}
 
+		if (data->output->scene->calculate_visibility ||
+				entry->highlight_transparent_region) {
+			pixman_region32_t *node_opaque = &data->output->scratch.node_opaque;
+			scene_node_opaque_region(node, x, y, node_opaque);
+			logical_to_buffer_coords(node_opaque, data, false);
+			pixman_region32_subtract(opaque, render_region, node_opaque);
+		}
+
 		enum wl_output_transform transform =
 			wlr_output_transform_invert(scene_buffer->transform);
 		transform = wlr_output_transform_compose(transform, data->transform);
@@ -2090,11 +3285,11 @@ static void scene_entry_render(struct render_list_entry *entry, const struct ren
 				.src_box = scene_buffer->src_box,
 				.dst_box = dst_box,
 				.transform = transform,
-				.clip = &render_region, // Render with the smaller region, clipping CSD
+				.clip = render_region, // Render with the smaller region, clipping CSD
 				.alpha = &scene_buffer->opacity,
 				.filter_mode = scene_buffer->filter_mode,
 				.blend_mode = !data->output->scene->calculate_visibility ||
-					!pixman_region32_empty(&opaque) ?
+					!pixman_region32_empty(opaque) ?
 					WLR_RENDER_BLEND_MODE_PREMULTIPLIED : WLR_RENDER_BLEND_MODE_NONE,
 				.transfer_function = scene_buffer->transfer_function,
 				.primaries = scene_buffer->primaries != 0 ? &primaries : NULL,
@@ -2124,7 +3319,7 @@ static void scene_entry_render(struct render_list_entry *entry, const struct ren
 			wlr_render_pass_add_rect(data->render_pass, &(struct wlr_render_rect_options){
 					.box = dst_box,
 					.color = { .r = 0, .g = 0.3, .b = 0, .a = 0.3 },
-					.clip = &opaque,
+					.clip = opaque,
 			});
 		}
 		break;
@@ -2155,7 +3350,7 @@ static void scene_entry_render(struct render_list_entry *entry, const struct ren
 				.b = scene_shadow->color[2],
 				.a = scene_shadow->color[3],
 			},
-			.clip = &render_region,
+			.clip = render_region,
 		};
 		fx_render_pass_add_box_shadow(fx_pass, &shadow_options);
 		break;
@@ -2216,7 +3411,7 @@ static void scene_entry_render(struct render_list_entry *entry, const struct ren
 					.src_box = mask_src_box,
 					.dst_box = dst_box,
 					.transform = mask_transform,
-					.clip = &render_region,
+					.clip = render_region,
 					.alpha = &blur->alpha,
 					.filter_mode = WLR_SCALE_FILTER_BILINEAR,
 					.blend_mode = WLR_RENDER_BLEND_MODE_PREMULTIPLIED,
@@ -2225,17 +3420,121 @@ static void scene_entry_render(struct render_list_entry *entry, const struct ren
 				.corners = fx_corner_radii_scale(blur_corners, data->scale),
 				.discard_transparent = false,
 			},
+			.blurred_buffer = data->shared_blur,
 			.use_optimized_blur = blur->should_only_blur_bottom_layer,
 			.blur_data = &scene->blur_data,
 			.ignore_transparent = mask != NULL,
 			.blur_strength = blur->strength,
 		};
-		fx_render_pass_add_blur(fx_pass, &blur_options);
+		if (!scene_blur_render_cached(entry, data, &blur_options)) {
+			fx_render_pass_add_blur(fx_pass, &blur_options);
+		}
 		break;
 	}
+}
 
-	pixman_region32_fini(&opaque);
-	pixman_region32_fini(&render_region);
+// Blur nodes following each other in the render list blur the same backdrop,
+// as long as none of them samples what an earlier entry of the run drew.
+// Other entries may sit between them when they don't reach that far. Blurs the
+// union of such a run starting at list[start] once into data->shared_blur,
+// which the blur nodes of the run are then drawn from where their caches
+// don't cover them. Returns the index of the last blur node of the run.
+static int scene_blur_run_prepare(struct render_list_entry *list, int start,
+		struct render_data *data) {
+	struct fx_gles_render_pass *fx_pass = fx_get_render_pass(data->render_pass);
+	struct wlr_scene *scene = data->output->scene;
+	data->shared_blur = NULL;
+
+	struct wlr_scene_blur *first = wlr_scene_blur_from_node(list[start].node);
+	if (fx_pass->fx_offscreen_buffers == NULL ||
+			!is_scene_blur_enabled(&scene->blur_data) ||
+			!scene_blur_can_share(first, data)) {
+		return start;
+	}
+
+	struct blur_data blur_data =
+		blur_data_apply_strength(&scene->blur_data, first->strength);
+	int blur_size = blur_data_calc_size(&blur_data);
+
+	// What the run draws, and the part of it which isn't drawn from a cache
+	pixman_region32_t drawn, blurred, region;
+	pixman_region32_init(&drawn);
+	pixman_region32_init(&blurred);
+	pixman_region32_init(&region);
+
+	int last = start;
+	for (int i = start; i >= 0; i--) {
+		struct wlr_scene_node *node = list[i].node;
+		if (node->type == WLR_SCENE_NODE_OPTIMIZED_BLUR) {
+			// Re-renders through the buffers the shared blur lives in
+			break;
+		}
+		if (node->type != WLR_SCENE_NODE_BLUR) {
+			// Drawn over the backdrop, which only matters to the blur nodes
+			// after it if they sample it
+			scene_entry_render_region(&list[i], data, &region);
+			pixman_region32_union(&drawn, &drawn, &region);
+			continue;
+		}
+		struct wlr_scene_blur *blur = wlr_scene_blur_from_node(node);
+		if (blur->strength != first->strength || !scene_blur_can_share(blur, data)) {
+			break;
+		}
+
+		scene_entry_render_region(&list[i], data, &region);
+		if (i != start) {
+			// The blur samples this far around the node, which must not
+			// reach anything drawn by the nodes before it
+			pixman_region32_t sampled;
+			pixman_region32_init(&sampled);
+			wlr_region_expand(&sampled, &region, blur_size);
+			pixman_region32_intersect(&sampled, &sampled, &drawn);
+			bool overlaps = pixman_region32_not_empty(&sampled);
+			pixman_region32_fini(&sampled);
+			if (overlaps) {
+				break;
+			}
+		}
+
+		pixman_region32_union(&drawn, &drawn, &region);
+		struct wlr_box box;
+		if (!scene_entry_blur_cache_box(&list[i], data, &box) ||
+				!scene_blur_cache_covers(scene_blur_cache_find(data->output, blur),
+					&box, &region)) {
+			pixman_region32_union(&blurred, &blurred, &region);
+		}
+		last = i;
+	}
+
+	if (last != start && pixman_region32_not_empty(&blurred)) {
+		struct wlr_box output_box = {
+			.width = data->trans_width,
+			.height = data->trans_height,
+		};
+		const float opacity = 1.0f;
+		struct fx_render_blur_pass_options blur_options = {
+			.tex_options = {
+				.base = {
+					.dst_box = output_box,
+					.transform = WL_OUTPUT_TRANSFORM_NORMAL,
+					.clip = &blurred,
+					.alpha = &opacity,
+					.filter_mode = WLR_SCALE_FILTER_BILINEAR,
+					.blend_mode = WLR_RENDER_BLEND_MODE_NONE,
+				},
+				.clip_box = &output_box,
+			},
+			.blur_data = &scene->blur_data,
+			.blur_strength = first->strength,
+		};
+		data->shared_blur = fx_render_pass_blur_backdrop(fx_pass, &blur_options);
+	}
+
+	pixman_region32_fini(&region);
+	pixman_region32_fini(&blurred);
+	pixman_region32_fini(&drawn);
+
+	return data->shared_blur != NULL ? last : start;
 }
 
 static void scene_handle_linux_dmabuf_v1_destroy(struct wl_listener *listener,
@@ -2320,6 +3619,11 @@ void wlr_scene_set_color_manager_v1(struct wlr_scene *scene, struct wlr_color_ma
 	wl_signal_add(&manager->events.destroy, &scene->color_manager_v1_destroy);
 }
 
+void wlr_scene_get_visibility_stats(struct wlr_scene *scene,
+		struct wlr_scene_visibility_stats *stats) {
+	*stats = scene->visibility_stats;
+}
+
 static void scene_output_handle_destroy(struct wlr_addon *addon) {
 	struct wlr_scene_output *scene_output =
 		wl_container_of(addon, scene_output, addon);
@@ -2425,6 +3729,30 @@ static void scene_output_handle_needs_frame(struct wl_listener *listener, void *
 	wlr_output_schedule_frame(scene_output->output);
 }
 
+static void scene_output_scratch_init(struct wlr_scene_output *scene_output) {
+	pixman_region32_init(&scene_output->scratch.damage);
+	pixman_region32_init(&scene_output->scratch.original_damage);
+	pixman_region32_init(&scene_output->scratch.blur_padding);
+	pixman_region32_init(&scene_output->scratch.background[0]);
+	pixman_region32_init(&scene_output->scratch.background[1]);
+	pixman_region32_init(&scene_output->scratch.visible);
+	pixman_region32_init(&scene_output->scratch.render_region);
+	pixman_region32_init(&scene_output->scratch.node_opaque);
+	pixman_region32_init(&scene_output->scratch.opaque);
+}
+
+static void scene_output_scratch_finish(struct wlr_scene_output *scene_output) {
+	pixman_region32_fini(&scene_output->scratch.damage);
+	pixman_region32_fini(&scene_output->scratch.original_damage);
+	pixman_region32_fini(&scene_output->scratch.blur_padding);
+	pixman_region32_fini(&scene_output->scratch.background[0]);
+	pixman_region32_fini(&scene_output->scratch.background[1]);
+	pixman_region32_fini(&scene_output->scratch.visible);
+	pixman_region32_fini(&scene_output->scratch.render_region);
+	pixman_region32_fini(&scene_output->scratch.node_opaque);
+	pixman_region32_fini(&scene_output->scratch.opaque);
+}
+
 struct wlr_scene_output *wlr_scene_output_create(struct wlr_scene *scene,
 		struct wlr_output *output) {
 	struct wlr_scene_output *scene_output = calloc(1, sizeof(*scene_output));
@@ -2439,6 +3767,8 @@ struct wlr_scene_output *wlr_scene_output_create(struct wlr_scene *scene,
 	wlr_damage_ring_init(&scene_output->damage_ring);
 	pixman_region32_init(&scene_output->pending_commit_damage);
 	wl_list_init(&scene_output->damage_highlight_regions);
+	wl_list_init(&scene_output->blur_caches);
+	scene_output_scratch_init(scene_output);
 
 	int prev_output_index = -1;
 	struct wl_list *prev_output_link = &scene->outputs;
@@ -2508,9 +3838,17 @@ void wlr_scene_output_destroy(struct wlr_scene_output *scene_output) {
 		highlight_region_destroy(damage);
 	}
 
+	struct scene_blur_cache *cache, *tmp_cache;
+	wl_list_for_each_safe(cache, tmp_cache, &scene_output->blur_caches, link) {
+		scene_blur_cache_destroy(cache);
+	}
+	scene_output_finish_blur_damage(scene_output);
+	wl_array_release(&scene_output->blur_damage);
+
 	wlr_addon_finish(&scene_output->addon);
 	wlr_damage_ring_finish(&scene_output->damage_ring);
 	pixman_region32_fini(&scene_output->pending_commit_damage);
+	scene_output_scratch_finish(scene_output);
 	wl_list_remove(&scene_output->link);
 	wl_list_remove(&scene_output->output_commit.link);
 	wl_list_remove(&scene_output->output_damage.link);
@@ -2528,6 +3866,7 @@ void wlr_scene_output_destroy(struct wlr_scene_output *scene_output) {
 	wlr_color_transform_unref(scene_output->prev_supplied_color_transform);
 	wlr_color_transform_unref(scene_output->combined_color_transform);
 	wl_array_release(&scene_output->render_list);
+	wl_array_release(&scene_output->render_list_dirty);
 	free(scene_output);
 }
 
@@ -2603,10 +3942,10 @@ static bool scene_rect_is_black_opaque(struct wlr_scene_rect *scene_rect) {
 		wlr_box_empty(&scene_rect->clipped_region.area);
 }
 
-static bool construct_render_list_iterator(struct wlr_scene_node *node,
-		int lx, int ly, void *_data) {
-	struct render_list_constructor_data *data = _data;
-
+// Checks whether a node intersecting the output should be part of its render
+// list. topmost is set if there are no entries above this node.
+static bool render_list_should_include(struct wlr_scene_node *node,
+		const struct render_list_constructor_data *data, bool topmost) {
 	if (scene_node_invisible(node)) {
 		return false;
 	}
@@ -2616,7 +3955,7 @@ static bool construct_render_list_iterator(struct wlr_scene_node *node,
 	// unless fractional scale is used even the rect itself (to avoid running
 	// into issues regarding damage region expansion).
 	if (node->type == WLR_SCENE_NODE_RECT && data->calculate_visibility &&
-			(!data->fractional_scale || data->render_list->size == 0)) {
+			(!data->fractional_scale || topmost)) {
 		struct wlr_scene_rect *rect = wlr_scene_rect_from_node(node);
 
 		if (scene_rect_is_black_opaque(rect)) {
@@ -2626,7 +3965,7 @@ static bool construct_render_list_iterator(struct wlr_scene_node *node,
 
 	// Apply the same special-case to black opaque single-pixel buffers
 	if (node->type == WLR_SCENE_NODE_BUFFER && data->calculate_visibility &&
-			(!data->fractional_scale || data->render_list->size == 0)) {
+			(!data->fractional_scale || topmost)) {
 		struct wlr_scene_buffer *scene_buffer = wlr_scene_buffer_from_node(node);
 
 		if (scene_buffer_is_black_opaque(scene_buffer)) {
@@ -2634,18 +3973,23 @@ static bool construct_render_list_iterator(struct wlr_scene_node *node,
 		}
 	}
 
-	pixman_region32_t intersection;
-	pixman_region32_init(&intersection);
-	pixman_region32_intersect_rect(&intersection, &node->visible,
-			data->box.x, data->box.y,
-			data->box.width, data->box.height);
-	if (pixman_region32_empty(&intersection)) {
-		pixman_region32_fini(&intersection);
+	pixman_box32_t box = {
+		.x1 = data->box.x,
+		.y1 = data->box.y,
+		.x2 = data->box.x + data->box.width,
+		.y2 = data->box.y + data->box.height,
+	};
+	return pixman_region32_contains_rectangle(&node->visible, &box) != PIXMAN_REGION_OUT;
+}
+
+static bool construct_render_list_iterator(struct wlr_scene_node *node,
+		int lx, int ly, void *_data) {
+	struct render_list_constructor_data *data = _data;
+
+	if (!render_list_should_include(node, data, data->render_list->size == 0)) {
 		return false;
 	}
 
-	pixman_region32_fini(&intersection);
-
 	struct render_list_entry *entry = wl_array_add(data->render_list, sizeof(*entry));
 	if (!entry) {
 		return false;
@@ -2661,6 +4005,74 @@ static bool construct_render_list_iterator(struct wlr_scene_node *node,
 	return false;
 }
 
+// Re-evaluates the render list entries of the nodes which changed since the
+// last frame, without walking the scene. Returns false if the render list
+// needs to be rebuilt instead, i.e. if a node would need to be inserted.
+static bool scene_output_patch_render_list(struct wlr_scene_output *scene_output,
+		const struct render_list_constructor_data *data) {
+	struct wlr_scene_node **dirty_node;
+	wl_array_for_each(dirty_node, &scene_output->render_list_dirty) {
+		struct wlr_scene_node *node = *dirty_node;
+
+		struct render_list_entry *list_data = data->render_list->data;
+		size_t list_len = data->render_list->size / sizeof(*list_data);
+		size_t i = 0;
+		while (i < list_len && list_data[i].node != node) {
+			i++;
+		}
+
+		if (i == list_len) {
+			int lx, ly;
+			if (!wlr_scene_node_coords(node, &lx, &ly)) {
+				continue;
+			}
+
+			struct wlr_box node_box = { .x = lx, .y = ly };
+			scene_node_get_size(node, &node_box.width, &node_box.height);
+			if (wlr_box_intersection(&node_box, &node_box, &data->box) &&
+					render_list_should_include(node, data, false)) {
+				return false;
+			}
+			continue;
+		}
+
+		struct wlr_box node_box = { .x = list_data[i].x, .y = list_data[i].y };
+		scene_node_get_size(node, &node_box.width, &node_box.height);
+		if (!wlr_box_intersection(&node_box, &node_box, &data->box) ||
+				!render_list_should_include(node, data, i == 0)) {
+			array_remove_at(data->render_list, i * sizeof(*list_data),
+				sizeof(*list_data));
+		}
+	}
+
+	scene_output->render_list_dirty.size = 0;
+	return true;
+}
+
+// Brings the render list of the output up to date. The list is only rebuilt
+// from scratch if the structure of the scene or the output geometry changed,
+// otherwise it is reused as is or patched for the nodes which changed.
+static void scene_output_update_render_list(struct wlr_scene_output *scene_output,
+		struct render_list_constructor_data *data) {
+	struct wlr_scene *scene = scene_output->scene;
+	if (scene_output->render_list_generation == scene->structure_generation &&
+			wlr_box_equal(&scene_output->render_list_box, &data->box) &&
+			scene_output->render_list_fractional_scale == data->fractional_scale &&
+			scene_output_patch_render_list(scene_output, data)) {
+		return;
+	}
+
+	data->render_list->size = 0;
+	scene_nodes_in_box(&scene->tree.node, &data->box,
+		construct_render_list_iterator, data);
+	array_realloc(data->render_list, data->render_list->size);
+
+	scene_output->render_list_generation = scene->structure_generation;
+	scene_output->render_list_box = data->box;
+	scene_output->render_list_fractional_scale = data->fractional_scale;
+	scene_output->render_list_dirty.size = 0;
+}
+
 static void scene_buffer_send_dmabuf_feedback(const struct wlr_scene *scene,
 		struct wlr_scene_buffer *scene_buffer,
 		const struct wlr_linux_dmabuf_feedback_v1_init_options *options) {
@@ -2915,7 +4327,7 @@ static bool apply_blur_region(struct wlr_scene_node *node, struct blur_data *blu
 		should_compensate_blur = true;
 
 		// Expand the render damage to re-render surrounding blur nodes
-		pixman_region32_union(&render_data->damage, &render_data->damage, &intersection);
+		pixman_region32_union(render_data->damage, render_data->damage, &intersection);
 		// Also make sure that the backend also knows about the new
 		// damage. Very important
 		output_state->committed |= WLR_OUTPUT_STATE_DAMAGE;
@@ -3061,6 +4473,9 @@ cleanup_transforms:
 
 bool wlr_scene_output_build_state(struct wlr_scene_output *scene_output,
 		struct wlr_output_state *state, const struct wlr_scene_output_state_options *options) {
+	// The visibility and damage of a pending transaction aren't applied yet
+	assert(scene_output->scene->transaction_depth == 0);
+
 	struct wlr_scene_output_state_options default_options = {0};
 	if (!options) {
 		options = &default_options;
@@ -3135,10 +4550,7 @@ bool wlr_scene_output_build_state(struct wlr_scene_output *scene_output,
 		.fractional_scale = floor(render_data.scale) != render_data.scale,
 	};
 
-	list_con.render_list->size = 0;
-	scene_nodes_in_box(&scene_output->scene->tree.node, &list_con.box,
-		construct_render_list_iterator, &list_con);
-	array_realloc(list_con.render_list, list_con.render_list->size);
+	scene_output_update_render_list(scene_output, &list_con);
 
 	struct render_list_entry *list_data = list_con.render_list->data;
 	int list_len = list_con.render_list->size / sizeof(*list_data);
@@ -3286,30 +4698,29 @@ bool wlr_scene_output_build_state(struct wlr_scene_output *scene_output,
 
 	render_data.render_pass = render_pass;
 
-	pixman_region32_init(&render_data.damage);
+	render_data.damage = &scene_output->scratch.damage;
 	wlr_damage_ring_rotate_buffer(&scene_output->damage_ring, buffer,
-		&render_data.damage);
+		render_data.damage);
 
 	struct fx_gles_render_pass *fx_pass = fx_get_render_pass(render_pass);
 	bool should_compensate_blur = false;
 	if (fx_render_pass_init_offscreen_buffers(render_pass, output)
-			&& pixman_region32_not_empty(&render_data.damage)) {
+			&& pixman_region32_not_empty(render_data.damage)) {
 		// Blur artifact prevention
 		// Note: Supports individual blur node blur_data
-		pixman_region32_t original_damage;
-		pixman_region32_init(&original_damage);
-		pixman_region32_copy(&original_damage, &render_data.damage);
+		pixman_region32_t *original_damage = &scene_output->scratch.original_damage;
+		pixman_region32_copy(original_damage, render_data.damage);
 
 		// Only compensate for blur artifacts when the damage doesn't span
 		// the whole output
 		const bool full_damage =
-			original_damage.extents.x2 - original_damage.extents.x1 >= output->width
-			&& original_damage.extents.y2 - original_damage.extents.y1 >= output->height;
+			original_damage->extents.x2 - original_damage->extents.x1 >= output->width
+			&& original_damage->extents.y2 - original_damage->extents.y1 >= output->height;
 
 		// The extra region we copy and paste onto the framebuffer after render
 		// for artifact removal
-		pixman_region32_t blur_padding_region;
-		pixman_region32_init(&blur_padding_region);
+		pixman_region32_t *blur_padding_region = &scene_output->scratch.blur_padding;
+		pixman_region32_clear(blur_padding_region);
 
 		// Check if the original damage expanded by the to-be-rendered blur
 		// nodes sampling size intersects with said nodes visible region. The
@@ -3337,7 +4748,7 @@ bool wlr_scene_output_build_state(struct wlr_scene_output *scene_output,
 			}
 
 			if (apply_blur_region(node, &blur_data, &render_data, state,
-						&original_damage, &blur_padding_region)) {
+						original_damage, blur_padding_region)) {
 				should_compensate_blur = true;
 				fx_pass->has_blur = true;
 			}
@@ -3347,15 +4758,15 @@ bool wlr_scene_output_build_state(struct wlr_scene_output *scene_output,
 		if (should_compensate_blur) {
 			// Capture the padding pixels around the blur where artifacts will be drawn
 			pixman_region32_subtract(&fx_pass->blur_padding_region,
-					&blur_padding_region, &render_data.damage);
+					blur_padding_region, render_data.damage);
 			// Make sure that the padding and damage doesn't exceed the output bounds
 			pixman_region32_intersect_rect(&fx_pass->blur_padding_region, &fx_pass->blur_padding_region,
 					0, 0, output->width, output->height);
 
 			// Combine with the render damage (we need to redraw the padding area as well)
-			pixman_region32_union(&render_data.damage,
-					&render_data.damage, &fx_pass->blur_padding_region);
-			pixman_region32_intersect_rect(&render_data.damage, &render_data.damage,
+			pixman_region32_union(render_data.damage,
+					render_data.damage, &fx_pass->blur_padding_region);
+			pixman_region32_intersect_rect(render_data.damage, render_data.damage,
 					0, 0, output->width, output->height);
 
 			// Copy the surrounding content where the blur would display artifacts
@@ -3366,14 +4777,13 @@ bool wlr_scene_output_build_state(struct wlr_scene_output *scene_output,
 			fx_render_pass_read_to_buffer(fx_pass, &fx_pass->blur_padding_region,
 					fx_pass->fx_offscreen_buffers->blur_saved_pixels_buffer, fx_pass->buffer);
 		}
-
-		pixman_region32_fini(&blur_padding_region);
-		pixman_region32_fini(&original_damage);
 	}
 
-	pixman_region32_t background;
-	pixman_region32_init(&background);
-	pixman_region32_copy(&background, &render_data.damage);
+	// Culling subtracts from one background region into the other, in place
+	// subtraction would give up the storage of the region
+	pixman_region32_t *background = &scene_output->scratch.background[0];
+	pixman_region32_t *background_next = &scene_output->scratch.background[1];
+	pixman_region32_copy(background, render_data.damage);
 
 	// Cull areas of the background that are occluded by opaque regions of
 	// scene nodes above. Those scene nodes will just render atop having us
@@ -3382,40 +4792,62 @@ bool wlr_scene_output_build_state(struct wlr_scene_output *scene_output,
 		for (int i = list_len - 1; i >= 0; i--) {
 			struct render_list_entry *entry = &list_data[i];
 
+			if (pixman_region32_empty(background)) {
+				break;
+			}
+			// Nodes away from the damage can't cull anything, skip them
+			// before building their opaque region
+			if (!scene_node_visible_may_intersect(entry->node, &render_data, background)) {
+				continue;
+			}
+
 			// We must only cull opaque regions that are visible by the node.
 			// The node's visibility will have the knowledge of a black rect
 			// that may have been omitted from the render list via the black
 			// rect optimization. In order to ensure we don't cull background
 			// rendering in that black rect region, consider the node's visibility.
-			pixman_region32_t opaque;
-			pixman_region32_init(&opaque);
-			scene_node_opaque_region(entry->node, entry->x, entry->y, &opaque);
-			pixman_region32_intersect(&opaque, &opaque, &entry->node->visible);
-
-			pixman_region32_translate(&opaque, -scene_output->x, -scene_output->y);
-			logical_to_buffer_coords(&opaque, &render_data, false);
-			pixman_region32_subtract(&background, &background, &opaque);
-			pixman_region32_fini(&opaque);
+			pixman_region32_t *node_opaque = &scene_output->scratch.node_opaque;
+			pixman_region32_t *opaque = &scene_output->scratch.opaque;
+			scene_node_opaque_region(entry->node, entry->x, entry->y, node_opaque);
+			pixman_region32_intersect(opaque, node_opaque, &entry->node->visible);
+
+			pixman_region32_translate(opaque, -scene_output->x, -scene_output->y);
+			logical_to_buffer_coords(opaque, &render_data, false);
+			pixman_region32_subtract(background_next, background, opaque);
+
+			pixman_region32_t *culled = background_next;
+			background_next = background;
+			background = culled;
 		}
 
 		if (floor(render_data.scale) != render_data.scale) {
-			wlr_region_expand(&background, &background, 1);
+			wlr_region_expand(background, background, 1);
 
 			// reintersect with the damage because we never want to render
 			// outside of the damage region
-			pixman_region32_intersect(&background, &background, &render_data.damage);
+			pixman_region32_intersect(background, background, render_data.damage);
 		}
 	}
 
 	wlr_render_pass_add_rect(render_pass, &(struct wlr_render_rect_options){
 		.box = { .width = buffer->width, .height = buffer->height },
 		.color = { .r = 0, .g = 0, .b = 0, .a = 1 },
-		.clip = &background,
+		.clip = background,
 	});
-	pixman_region32_fini(&background);
 
+	scene_output_update_blur_caches(scene_output, list_data, list_len, &render_data);
+
+	// Entries down to this index are drawn from render_data.shared_blur
+	int shared_blur_last = 0;
 	for (int i = list_len - 1; i >= 0; i--) {
 		struct render_list_entry *entry = &list_data[i];
+		if (render_data.shared_blur != NULL && i < shared_blur_last) {
+			render_data.shared_blur = NULL;
+		}
+		if (render_data.shared_blur == NULL &&
+				entry->node->type == WLR_SCENE_NODE_BLUR) {
+			shared_blur_last = scene_blur_run_prepare(list_data, i, &render_data);
+		}
 		scene_entry_render(entry, &render_data);
 
 		if (entry->node->type == WLR_SCENE_NODE_BUFFER) {
@@ -3452,7 +4884,7 @@ bool wlr_scene_output_build_state(struct wlr_scene_output *scene_output,
 		}
 	}
 
-	wlr_output_add_software_cursors_to_render_pass(output, render_pass, &render_data.damage);
+	wlr_output_add_software_cursors_to_render_pass(output, render_pass, render_data.damage);
 
 	if (should_compensate_blur) {
 		// Render the saved pixels over the blur artifacts
@@ -3460,8 +4892,6 @@ bool wlr_scene_output_build_state(struct wlr_scene_output *scene_output,
 				fx_pass->buffer, fx_pass->fx_offscreen_buffers->blur_saved_pixels_buffer);
 	}
 
-	pixman_region32_fini(&render_data.damage);
-
 	if (!wlr_render_pass_submit(render_pass)) {
 		wlr_buffer_unlock(buffer);
 
@@ -3508,11 +4938,15 @@ void wlr_scene_timer_finish(struct wlr_scene_timer *timer) {
 }
 
 static void scene_node_send_frame_done(struct wlr_scene_node *node,
+		const struct wlr_box *output_box, int lx, int ly,
 		struct wlr_scene_output *scene_output, struct timespec *now) {
 	if (!node->enabled) {
 		return;
 	}
 
+	lx += node->x;
+	ly += node->y;
+
 	if (node->type == WLR_SCENE_NODE_BUFFER) {
 		struct wlr_scene_buffer *scene_buffer =
 			wlr_scene_buffer_from_node(node);
@@ -3523,16 +4957,26 @@ static void scene_node_send_frame_done(struct wlr_scene_node *node,
 		wlr_scene_buffer_send_frame_done(scene_buffer, &event);
 	} else if (node->type == WLR_SCENE_NODE_TREE) {
 		struct wlr_scene_tree *scene_tree = wlr_scene_tree_from_node(node);
+		// Skip subtrees which aren't displayed on this output at all, like
+		// the contents of inactive workspaces
+		if (!scene_tree_intersects_box(scene_tree, lx, ly, output_box)) {
+			return;
+		}
+
 		struct wlr_scene_node *child;
 		wl_list_for_each(child, &scene_tree->children, link) {
-			scene_node_send_frame_done(child, scene_output, now);
+			scene_node_send_frame_done(child, output_box, lx, ly,
+				scene_output, now);
 		}
 	}
 }
 
 void wlr_scene_output_send_frame_done(struct wlr_scene_output *scene_output,
 		struct timespec *now) {
-	scene_node_send_frame_done(&scene_output->scene->tree.node,
+	struct wlr_box box = { .x = scene_output->x, .y = scene_output->y };
+	wlr_output_effective_resolution(scene_output->output,
+		&box.width, &box.height);
+	scene_node_send_frame_done(&scene_output->scene->tree.node, &box, 0, 0,
 		scene_output, now);
 }
 
@@ -3558,6 +5002,10 @@ static void scene_output_for_each_scene_buffer(const struct wlr_box *output_box,
 		}
 	} else if (node->type == WLR_SCENE_NODE_TREE) {
 		struct wlr_scene_tree *scene_tree = wlr_scene_tree_from_node(node);
+		if (!scene_tree_intersects_box(scene_tree, lx, ly, output_box)) {
+			return;
+		}
+
 		struct wlr_scene_node *child;
 		wl_list_for_each(child, &scene_tree->children, link) {
 			scene_output_for_each_scene_buffer(output_box, child, lx, ly,